@@ -9,11 +9,14 @@
 #include <algorithm>
 #include <deque>
 #include <filesystem>
+#include <functional>
 #include <iostream>
 #include <optional>
 #include <queue>
 #include <shared_mutex>
+#include <span>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include "types.h"
@@ -35,6 +38,9 @@ class Context {
   auto IsRootPage(page_id_t page_id) -> bool { return page_id == root_page_id_; }
 };
 
+// direction of BPlusTree::ScanRange
+enum class ScanOrder { ASCENDING, DESCENDING };
+
 #define BPLUSTREE_TYPE BPlusTree<KeyType, ValueType, KeyComparator>
 
 INDEX_TEMPLATE_ARGUMENTS
@@ -47,6 +53,12 @@ class BPlusTree {
                      const KeyComparator &comparator, int leaf_max_size = LEAF_PAGE_SLOT_CNT,
                      int internal_max_size = INTERNAL_PAGE_SLOT_CNT);
 
+  // Attaches to the tree whose header page already exists (in the buffer pool or on disk)
+  // without resetting it; node sizes come from the header. Throws std::runtime_error if
+  // header_page_id does not hold a tree header.
+  static auto Open(std::string name, page_id_t header_page_id, BufferPoolManager *buffer_pool_manager,
+                   const KeyComparator &comparator) -> BPlusTree;
+
   // Returns true if this B+ tree has no keys and values.
   auto IsEmpty() const -> bool;
 
@@ -63,6 +75,30 @@ class BPlusTree {
   // Return the value associated with a given key
   auto GetValue(const KeyType &key, std::vector<ValueType> *result) -> bool;
 
+  // Looks up a batch of keys: (*results)[i] becomes the value of keys[i], nullopt if it is
+  // absent; returns how many were found. The keys are probed in sorted order along one
+  // read-latched root-to-leaf path: a probe only climbs as far as the lowest node still
+  // covering it, every probe landing in the current leaf is answered while it is pinned, and
+  // the children that later probes will visit are prefetched on the way down. The path is
+  // given up every PATH_HOLD_LEAVES leaves, since writers that need the root wait for it.
+  auto GetValues(std::span<const KeyType> keys, std::vector<std::optional<ValueType>> *results) -> size_t;
+
+  // Builds the tree bottom-up from entries in strictly ascending key order: leaves are packed
+  // to fill_factor of leaf_max_size (but not below the minimum size), allocated one after the
+  // other from the leaf group and linked, then each inner level is built from the first keys
+  // of the level below. The root id is published last, so the tree stays empty until the load
+  // is complete. Throws std::runtime_error if the tree is not empty or the input is not
+  // sorted, std::invalid_argument if fill_factor is not in (0, 1].
+  void BulkLoad(std::span<const std::pair<KeyType, ValueType>> entries, double fill_factor = 1.0);
+
+  // BulkLoad for input in any order. The entries are sorted on num_threads threads (0: one
+  // per core), with a parallel LSD radix sort for IntegerKey and a parallel sort and merge
+  // otherwise; each thread then writes one run of the leaf level from its own allocation
+  // group, the runs are linked and the inner levels built on top. Duplicate keys throw
+  // std::runtime_error.
+  void BulkLoadUnsorted(std::vector<std::pair<KeyType, ValueType>> entries, size_t num_threads = 0,
+                        double fill_factor = 1.0);
+
   // Return the page id of the root node
   auto GetRootPageId() -> page_id_t;
 
@@ -72,6 +108,20 @@ class BPlusTree {
   // Print the B+ tree structure to the provided output stream
   void Print(std::ostream &os) const;
 
+  // Visits the entries with lo <= key <= hi in key order, one leaf at a time: visit gets
+  // the leaf's matching keys and values as two parallel spans that point into the pinned
+  // page and are only valid during the call; returning false stops the scan. The next leaf
+  // is prefetched while visit runs. Returns the number of entries handed out.
+  // DESCENDING starts at hi and walks the leaves right to left; the spans still point into
+  // the page, so each batch is ascending within itself and batches come in descending order.
+  auto ScanRange(const KeyType &lo, const KeyType &hi,
+                 const std::function<bool(std::span<const KeyType>, std::span<const ValueType>)> &visit,
+                 ScanOrder order = ScanOrder::ASCENDING) -> size_t;
+  // Appends the entries with lo <= key <= hi to out in the given order; returns how many were
+  // appended.
+  auto ScanRange(const KeyType &lo, const KeyType &hi, std::vector<std::pair<KeyType, ValueType>> *out,
+                 ScanOrder order = ScanOrder::ASCENDING) -> size_t;
+
   // Index iterator
   auto Begin() -> INDEXITERATOR_TYPE;
 
@@ -79,15 +129,72 @@ class BPlusTree {
 
   auto Begin(const KeyType &key) -> INDEXITERATOR_TYPE;
 
+  // Reverse iteration with operator--: RBegin() is at the largest key, RBegin(key) at the
+  // largest key <= key; stepping back from the smallest key reaches REnd().
+  auto RBegin() -> INDEXITERATOR_TYPE;
+
+  auto RBegin(const KeyType &key) -> INDEXITERATOR_TYPE;
+
+  auto REnd() -> INDEXITERATOR_TYPE;
+
  private:
+  struct OpenTag {};
+  // initializes the members only, the header page is left as it is
+  BPlusTree(OpenTag tag, std::string name, page_id_t header_page_id, BufferPoolManager *buffer_pool_manager,
+            const KeyComparator &comparator, int leaf_max_size, int internal_max_size);
+
   // DONT USE!!!!!
   // SO FXXXING USELESS AND TROUBLESOME!!!!
   auto Redistribute(InternalPage *parent_page, InternalPage *child_page, int parent_index) -> bool;
   // Ok, used only once. ;w;
   auto Merge(InternalPage *parent_page, InternalPage *l_page, InternalPage *r_page, int parent_index) -> void;
 
+  // leaves GetValues answers before it lets go of its path and starts again from the header
+  static constexpr int PATH_HOLD_LEAVES = 64;
+  // children of an inner node GetValues keeps prefetched ahead of its probes
+  static constexpr int PREFETCH_CHILDREN = 8;
+
+  // what a write descent is for; decides when a node is safe
+  enum class Operation { INSERT, REMOVE };
+
+  // Read descent: shared latches only, crabbing from the header, so lookups never block each
+  // other. Leaves the leaf in ctx->read_set_; the set stays empty if the tree is empty.
   void FindLeafPage(const KeyType &key, Context *ctx) const;
-  void FindAndLock(const KeyType &key, Context *ctx) const;
+  // Pessimistic descent with write latches. Latch crabbing: as soon as a node is safe for op
+  // (cannot split or merge), the latches above it, the header's included, are released, so
+  // ctx keeps only the part of the path the operation may change.
+  void FindAndLock(const KeyType &key, Context *ctx, Operation op) const;
+  // Optimistic descent: read latches on the header and the inner nodes, crabbing, and a
+  // write latch on the leaf only. nullopt if the tree is empty.
+  auto FindLeafOptimistic(const KeyType &key) const -> std::optional<WritePageGuard>;
+  // Whether page stays within its bounds after op; the remove path also rewrites separator
+  // keys above an underflowing leaf, so only leaves count as safe for REMOVE.
+  static auto IsSafe(const BPlusTreePage *page, Operation op) -> bool;
+  // Moves from the read-latched leaf_guard to the last entry below bound in the leaves to its
+  // left. Writers latch leaves left to right, so leaf_guard is released before its left
+  // neighbour is latched; both are then latched in that order and, if a split or merge
+  // changed the link in between, the leaf is found again from the root. Returns the leaf and
+  // the entry's index, or nullopt if no entry is below bound.
+  auto StepLeft(ReadPageGuard leaf_guard, const KeyType &bound) const -> std::optional<std::pair<ReadPageGuard, int>>;
+  // iterator at index of the leaf guard holds, able to step left
+  auto MakeIterator(ReadPageGuard guard, int index) const -> INDEXITERATOR_TYPE;
+  auto ScanDescending(const KeyType &lo, const KeyType &hi,
+                      const std::function<bool(std::span<const KeyType>, std::span<const ValueType>)> &visit) -> size_t;
+  // child of an inner node that covers key
+  auto ChildIndex(const InternalPage *page, const KeyType &key) const -> int;
+  static void InsertIntoLeaf(LeafPage *leaf_page, int index, const KeyType &key, const ValueType &value);
+  static void RemoveFromLeaf(LeafPage *leaf_page, int index);
+  void SortEntries(std::vector<std::pair<KeyType, ValueType>> *entries, size_t num_threads) const;
+  // writes leaves [first_page, last_page) of entries spread evenly over pages leaves, linked
+  // among themselves; returns each leaf's first key and page id
+  auto WriteLeafRun(std::span<const std::pair<KeyType, ValueType>> entries, size_t pages, size_t first_page,
+                    size_t last_page, AllocationGroup group) -> std::vector<std::pair<KeyType, page_id_t>>;
+  // builds inner levels over (first key, page id) of a level until one page is left, its root
+  auto BuildInnerLevels(std::vector<std::pair<KeyType, page_id_t>> level, double fill_factor) -> page_id_t;
+  static auto FillTarget(int max_size, int min_size, double fill_factor) -> int;
+  // number of pages BulkLoad spreads count entries over so that each holds about target and
+  // none holds fewer than min_size (unless there is only one) or more than max_size
+  static auto PackedPageCount(size_t count, int target, int min_size, int max_size) -> size_t;
   
   // auto SplitLeaf(LeafPage *leaf_page) -> page_id_t;
   // auto InsertIntoParent(std::optional<WritePageGuard> parent, Context &ctx, page_id_t l_child, page_id_t r_child, const KeyType &up_key)
@@ -99,6 +206,10 @@ class BPlusTree {
   int leaf_max_size_;
   int internal_max_size_;
   page_id_t header_page_id_;
+  // the tree's own extents, leaves apart from internal pages so a leaf scan reads runs of
+  // leaves; split pages are placed next to the page they split from
+  AllocationGroup leaf_group_;
+  AllocationGroup internal_group_;
 };
 
 }  // namespace bicycletub
@@ -1,15 +1,26 @@
 #pragma once
 
+#include <cstdint>
+
 #include "types.h"
 
 namespace bicycletub {
 
+// First page of a B+ tree. Besides the root it records the node sizes the tree was created
+// with, so BPlusTree::Open can attach to an existing tree.
 class BPlusTreeHeaderPage {
  public:
+  // "BTR2"; a page without it was never initialized as a tree header, or belongs to a tree
+  // written before leaves had a previous-leaf link ("BTRE")
+  static constexpr uint32_t MAGIC = 0x42545232;
+
   BPlusTreeHeaderPage() = delete;
   BPlusTreeHeaderPage(const BPlusTreeHeaderPage &other) = delete;
 
   page_id_t root_page_id_;
+  uint32_t magic_;
+  int32_t leaf_max_size_;
+  int32_t internal_max_size_;
 };
 
 }  // namespace bicycletub
@@ -1,3 +1,6 @@
+#include <cstdint>
+#include <type_traits>
+
 #include "types.h"
 
 namespace bicycletub {
@@ -37,6 +40,9 @@ class IntegerKey {
   int value_;
 };
 
+// pages search IntegerKey arrays as plain int32_t (see key_search.h)
+static_assert(sizeof(IntegerKey) == sizeof(int32_t) && std::is_standard_layout_v<IntegerKey>);
+
 class IntegerKeyComparator {
  public:
   auto operator()(const IntegerKey &a, const IntegerKey &b) const -> int {
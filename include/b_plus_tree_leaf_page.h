@@ -9,7 +9,7 @@
 namespace bicycletub {
 
 #define B_PLUS_TREE_LEAF_PAGE_TYPE BPlusTreeLeafPage<KeyType, ValueType, KeyComparator>
-#define LEAF_PAGE_HEADER_SIZE 16
+#define LEAF_PAGE_HEADER_SIZE 20
 #define LEAF_PAGE_SLOT_CNT ((PAGE_SIZE - LEAF_PAGE_HEADER_SIZE) / (sizeof(KeyType) + sizeof(ValueType)))
 
 /**
@@ -19,13 +19,13 @@ namespace bicycletub {
  *  ---------------------------------
  * | RID(1) | RID(2) | ... | RID(n) |
  *  ---------------------------------
- *  Header format (size in byte, 16 bytes in total, 4 bytes more than internal page):
+ *  Header format (size in byte, 20 bytes in total, 8 bytes more than internal page):
  *  -----------------------------------------------
  * | PageType (4) | CurrentSize (4) | MaxSize (4) |
  *  -----------------------------------------------
- *  -----------------
- * | NextPageId (4) |
- *  -----------------
+ *  ----------------------------------
+ * | NextPageId (4) | PrevPageId (4) |
+ *  ----------------------------------
  */
 INDEX_TEMPLATE_ARGUMENTS
 class BPlusTreeLeafPage : public BPlusTreePage {
@@ -38,11 +38,14 @@ class BPlusTreeLeafPage : public BPlusTreePage {
 
   auto GetNextPageId() const -> page_id_t;
   void SetNextPageId(page_id_t next_page_id);
+  auto GetPrevPageId() const -> page_id_t;
+  void SetPrevPageId(page_id_t prev_page_id);
   auto KeyAt(int index) const -> KeyType;
 
   auto KeyIndex(const KeyType &key, const KeyComparator &comparator) const -> int;
 
   page_id_t next_page_id_;
+  page_id_t prev_page_id_;
   KeyType key_array_[LEAF_PAGE_SLOT_CNT];
   ValueType rid_array_[LEAF_PAGE_SLOT_CNT];
 };
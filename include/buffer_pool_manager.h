@@ -6,50 +6,109 @@
 #include <unordered_map>
 #include <vector>
 
+#include "page_allocator.h"
 #include "page_guard.h"
 
 namespace bicycletub {
 
 class BufferPoolManager {
  public:
-  using DiskManager = bicycletub::DiskManagerMemory;
-  BufferPoolManager(size_t num_frames, DiskManager *disk_manager);
+  using DiskManager = bicycletub::DiskManager;
+  // With a log manager every change made through a WritePageGuard is logged as a page
+  // image, and no page is written before its image is durable in the log.
+  BufferPoolManager(size_t num_frames, DiskManager *disk_manager, LogManager *log_manager = nullptr);
   ~BufferPoolManager() = default;
 
   auto Size() const -> size_t { return num_frames_; }
-  auto NewPage() -> page_id_t { return next_page_id_.fetch_add(1); }
+  auto NewPage() -> page_id_t { return page_allocator_.Allocate(); }
+  // a page placed near hint (in its extent if it has room), e.g. the sibling of a splitting leaf
+  auto NewPage(page_id_t hint) -> page_id_t { return page_allocator_.AllocateNear(hint); }
+  // a page in group's extents; each index or table (or loading thread) can use its own group
+  auto NewPage(AllocationGroup group) -> page_id_t { return page_allocator_.Allocate(group); }
+  auto NewAllocationGroup() -> AllocationGroup { return page_allocator_.NewGroup(); }
+  // makes pages [0, end_page_id) of a disk manager that already holds data accessible,
+  // e.g. after DiskManagerMemory::LoadImage
+  void AdoptPages(page_id_t end_page_id) { page_allocator_.Adopt(end_page_id); }
   auto DeletePage(page_id_t page_id) -> bool;
+  // Both throw std::runtime_error if the page cannot be brought in, and
+  // PageCorruptionError if it was read back but failed verification.
   auto WritePage(page_id_t page_id) -> WritePageGuard;
   auto ReadPage(page_id_t page_id) -> ReadPageGuard;
+  // Starts reading page into a free (or evicted) frame in the background and returns
+  // without waiting; the first ReadPage/WritePage of the page waits for the read. A no-op if
+  // the page is resident, or too many prefetches are already in flight.
+  void Prefetch(page_id_t page_id);
   auto FlushPage(page_id_t page_id) -> bool;
   void FlushAllPages();
+  // Groups the page changes made on this thread until the scope ends into one atomic log
+  // record, see AtomicWriteScope.
+  auto BeginAtomic() -> AtomicWriteScope { return AtomicWriteScope(log_manager_, bpm_latch_.get()); }
+  // Takes a fuzzy checkpoint and makes it the starting point of recovery; returns the LSN
+  // of its BEGIN record. Requires a log manager.
+  auto Checkpoint() -> lsn_t;
+  // forwards an access pattern hint for pages [first_page_id, first_page_id + count) to the disk manager
+  void Advise(page_id_t first_page_id, size_t count, AccessHint hint) {
+    disk_manager_->Advise(first_page_id, count, hint);
+  }
   auto GetPinCount(page_id_t page_id) -> std::optional<size_t>;
+  auto GetLogManager() const -> LogManager * { return log_manager_; }
 
   // Metrics getters
   uint64_t GetDiskReads() const { return disk_reads_.load(); }
   uint64_t GetDiskWrites() const { return disk_writes_.load(); }
   uint64_t GetCacheHits() const { return cache_hits_.load(); }
   uint64_t GetCacheMisses() const { return cache_misses_.load(); }
+  // misses served by pointing a frame at the disk manager's mapping
+  uint64_t GetZeroCopyReads() const { return zero_copy_reads_.load(); }
+  // reads started by Prefetch (read-ahead advice for pages served zero-copy)
+  uint64_t GetPrefetchReads() const { return prefetch_reads_.load(); }
 
  private:
   auto CheckedWritePage(page_id_t page_id) -> std::optional<WritePageGuard>;
   auto CheckedReadPage(page_id_t page_id) -> std::optional<ReadPageGuard>;
-  auto PageSwitch(bool is_write, page_id_t page_id, frame_id_t frame_id) -> bool;
+  // A frame for a page about to be loaded: a free one, or an evicted one written back first.
+  // bpm_latch_ must be held.
+  auto TakeFrame() -> std::optional<frame_id_t>;
+  // frame holding page_id, after waiting for a prefetch still in flight; nullopt if the page
+  // is not resident (or its prefetch failed). bpm_latch_ must be held.
+  auto Resident(page_id_t page_id) -> std::optional<frame_id_t>;
+  // waits for a prefetch read and settles it; a failed one gives its frame back
+  auto FinishPrefetch(page_id_t page_id, frame_id_t frame_id) -> bool;
+  // settles the prefetches that are done so their frames can be evicted
+  void ReapPrefetches();
+  auto PageSwitch(bool is_write, page_id_t page_id, frame_id_t frame_id,
+                  DiskRequestPriority priority = DiskRequestPriority::FOREGROUND) -> bool;
+  // read miss: reference the disk manager's copy if it offers one, otherwise read into the frame
+  auto LoadForRead(page_id_t page_id, frame_id_t frame_id) -> bool;
+  // undoes a miss whose read failed so the page is not served from a half-loaded frame;
+  // throws PageCorruptionError if the read failed verification. bpm_latch_ must be held.
+  void AbandonLoad(page_id_t page_id, frame_id_t frame_id);
+  // writes dirty pages back in slices; with dirtied_before only those whose recovery LSN is older
+  void WriteBack(std::optional<lsn_t> dirtied_before);
+  static auto NeedsWriteBack(const FrameHeader &frame, std::optional<lsn_t> dirtied_before) -> bool;
 
   const size_t num_frames_;
-  std::atomic<page_id_t> next_page_id_;
+  PageAllocator page_allocator_;
   std::shared_ptr<std::mutex> bpm_latch_;
   std::vector<std::shared_ptr<FrameHeader>> frames_;
   std::unordered_map<page_id_t, frame_id_t> page_table_;
   std::list<frame_id_t> free_frames_;
   std::shared_ptr<ArcReplacer> replacer_;
+  DiskManager *disk_manager_;
   std::shared_ptr<DiskScheduler> disk_scheduler_;
+  LogManager *log_manager_;
+  std::mutex checkpoint_latch_;
+  lsn_t last_checkpoint_lsn_{INVALID_LSN};
+  // prefetched pages not accessed yet, their frames are not in the replacer
+  std::vector<std::pair<page_id_t, frame_id_t>> prefetches_;
 
   // Simple metrics
   std::atomic<uint64_t> disk_reads_{0};
   std::atomic<uint64_t> disk_writes_{0};
   std::atomic<uint64_t> cache_hits_{0};
   std::atomic<uint64_t> cache_misses_{0};
+  std::atomic<uint64_t> zero_copy_reads_{0};
+  std::atomic<uint64_t> prefetch_reads_{0};
 };
 
 } // namespace bicycletub
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <shared_mutex>
+#include <string>
+#include <vector>
+
+#include "types.h"
+#include "disk_manager.h"
+
+namespace bicycletub {
+
+// Decorator that keeps a CRC32C per page next to any DiskManager: computed on every write,
+// verified on every read. A mismatch throws PageCorruptionError instead of handing the
+// damaged bytes to the buffer pool. Pages without a recorded checksum (never written
+// through this manager) are passed through unchecked.
+//
+// Pages are full PAGE_SIZE images, so the checksums live out of band: in memory, and with a
+// checksum_path also in that sidecar file, saved by Sync() and on destruction and loaded on
+// construction. The first write after a save marks the sidecar as not cleanly saved before
+// the page reaches the inner manager; a sidecar loaded in that state (the process died
+// between saves) may be behind the pages, so its checksums are dropped and each page is
+// unchecked until it is written again. The inner manager is not owned and must outlive the
+// decorator.
+// Zero-copy reads (MappedPage) are not offered, since they could not be verified.
+class ChecksumDiskManager : public DiskManager {
+ public:
+  explicit ChecksumDiskManager(DiskManager *inner, std::string checksum_path = "");
+  ~ChecksumDiskManager() override;
+
+  void ReadPage(page_id_t page_id, char *out_buf) override;
+  void WritePage(page_id_t page_id, const char *buf) override;
+  void ReadPages(page_id_t first_page_id, char *const *out_bufs, size_t count) override;
+  void WritePages(page_id_t first_page_id, const char *const *bufs, size_t count) override;
+  void DeallocatePage(page_id_t page_id) override;
+  void Sync() override;
+  auto NumPages() const -> size_t override { return inner_->NumPages(); }
+  void Advise(page_id_t first_page_id, size_t count, AccessHint hint) override {
+    inner_->Advise(first_page_id, count, hint);
+  }
+
+  auto GetInner() const -> DiskManager * { return inner_; }
+  auto GetVerifiedReads() const -> uint64_t { return verified_reads_.load(); }
+  auto GetCorruptReads() const -> uint64_t { return corrupt_reads_.load(); }
+  // whether construction found a sidecar that was not cleanly saved
+  auto LoadedDirtySidecar() const -> bool { return loaded_dirty_; }
+
+ private:
+  // checksums per directory block; an entry is (crc | PRESENT) or 0 when nothing is recorded
+  static constexpr size_t BLOCK_ENTRIES = 4096;
+  static constexpr uint64_t PRESENT = uint64_t{1} << 32;
+
+  auto Entry(page_id_t page_id, bool create) -> std::atomic<uint64_t> *;
+  // returns the entry it replaced
+  auto Record(page_id_t page_id, const char *buf) -> uint64_t;
+  void Verify(page_id_t page_id, const char *buf);
+  // shared hold on sidecar_latch_ for a write, marking the sidecar first if it is clean
+  auto LatchForWrite() -> std::shared_lock<std::shared_mutex>;
+  void MarkSidecarDirty();
+  void Load();
+  // needs sidecar_latch_ held exclusively
+  void Save();
+
+  DiskManager *inner_;
+  std::string checksum_path_;
+  // blocks never move once created; the latch only guards growing the directory
+  std::vector<std::unique_ptr<std::atomic<uint64_t>[]>> blocks_;
+  mutable std::shared_mutex blocks_latch_;
+  // Writes hold this shared from recording a checksum until the page is written; Save holds
+  // it exclusively, so the table it saves matches the pages the inner manager has.
+  std::shared_mutex sidecar_latch_;
+  // the sidecar on disk is marked as not cleanly saved; guarded by sidecar_latch_
+  bool sidecar_dirty_{false};
+  bool loaded_dirty_{false};
+  std::atomic<uint64_t> verified_reads_{0};
+  std::atomic<uint64_t> corrupt_reads_{0};
+};
+
+}  // namespace bicycletub
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace bicycletub {
+
+// CRC32C (Castagnoli). Uses the SSE4.2 crc32 instruction when the CPU has it and a
+// slicing-by-8 table otherwise; both give identical results.
+// crc continues a previous checksum, 0 starts a new one.
+auto Crc32c(const void *data, size_t len, uint32_t crc = 0) -> uint32_t;
+
+// The table implementation, exposed for tests and benchmarks.
+auto Crc32cPortable(const void *data, size_t len, uint32_t crc = 0) -> uint32_t;
+
+// Whether Crc32c runs on the hardware instruction.
+auto Crc32cIsHardware() -> bool;
+
+}  // namespace bicycletub
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+
+#include "types.h"
+
+namespace bicycletub {
+
+// Thrown by a disk manager when a page read back does not match what was written,
+// e.g. a checksum mismatch. Distinct from I/O errors so callers can tell the two apart.
+class PageCorruptionError : public std::runtime_error {
+ public:
+  explicit PageCorruptionError(page_id_t page_id)
+      : std::runtime_error("page " + std::to_string(page_id) + " is corrupted"), page_id_(page_id) {}
+
+  auto GetPageId() const -> page_id_t { return page_id_; }
+
+ private:
+  page_id_t page_id_;
+};
+
+// How a range of pages is about to be accessed, see DiskManager::Advise.
+enum class AccessHint : uint8_t { NORMAL = 0, SEQUENTIAL, RANDOM };
+
+// Storage backend used by DiskScheduler and BufferPoolManager.
+// Pages that were never written read back as all zeros.
+class DiskManager {
+ public:
+  DiskManager() = default;
+  DiskManager(const DiskManager &) = delete;
+  auto operator=(const DiskManager &) -> DiskManager & = delete;
+  virtual ~DiskManager() = default;
+
+  virtual void ReadPage(page_id_t page_id, char *out_buf) = 0;
+  virtual void WritePage(page_id_t page_id, const char *buf) = 0;
+
+  // Vectored access to pages [first_page_id, first_page_id + count).
+  // The default implementation loops over single pages.
+  virtual void ReadPages(page_id_t first_page_id, char *const *out_bufs, size_t count);
+  virtual void WritePages(page_id_t first_page_id, const char *const *bufs, size_t count);
+
+  virtual void DeallocatePage(page_id_t page_id) = 0;
+
+  // Makes every completed write durable; volatile backends have nothing to do.
+  virtual void Sync() {}
+
+  virtual auto NumPages() const -> size_t = 0;
+
+  // Zero-copy reads: a read-only pointer to the page's stored bytes that stays valid for
+  // the lifetime of the disk manager, or nullptr if the backend cannot provide one.
+  virtual auto MappedPage(page_id_t /*page_id*/) -> const char * { return nullptr; }
+
+  // Read-ahead hint for pages [first_page_id, first_page_id + count); ignored by default.
+  virtual void Advise(page_id_t /*first_page_id*/, size_t /*count*/, AccessHint /*hint*/) {}
+};
+
+}  // namespace bicycletub
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <atomic>
+#include <mutex>
+#include <string>
+
+#include "types.h"
+#include "disk_manager.h"
+
+namespace bicycletub {
+
+// Disk manager backed by a single data file: page i lives at offset i * PAGE_SIZE.
+// Reads past the end of the file return zero pages.
+class DiskManagerFile : public DiskManager {
+ public:
+  // direct_io: open with O_DIRECT; unaligned buffers are bounced through an aligned one,
+  //            and filesystems that refuse O_DIRECT fall back to buffered I/O.
+  // sync_batch: fdatasync after this many page writes, 0 only syncs on Sync() and destruction.
+  // preallocate_pages: reserve file space with fallocate in steps of this many pages, 0 disables it.
+  explicit DiskManagerFile(const std::string &path, bool direct_io = false, size_t sync_batch = 0,
+                           size_t preallocate_pages = 1024);
+  ~DiskManagerFile() override;
+
+  void ReadPage(page_id_t page_id, char *out_buf) override;
+  void WritePage(page_id_t page_id, const char *buf) override;
+
+  // preadv/pwritev over the whole run
+  void ReadPages(page_id_t first_page_id, char *const *out_bufs, size_t count) override;
+  void WritePages(page_id_t first_page_id, const char *const *bufs, size_t count) override;
+
+  // punches a hole where the filesystem supports it
+  void DeallocatePage(page_id_t page_id) override;
+
+  // Concurrent callers share one fdatasync covering every write completed before it started.
+  void Sync() override;
+
+  auto NumPages() const -> size_t override;
+
+  auto GetPath() const -> const std::string & { return path_; }
+  auto GetFileDescriptor() const -> int { return fd_; }
+  auto IsDirectIO() const -> bool { return direct_io_; }
+  auto GetNumSyncs() const -> uint64_t { return num_syncs_.load(); }
+
+  // Bookkeeping for engines that write through GetFileDescriptor() directly:
+  // Preallocate before writing pages below end_page_id, NoteWrites once count of them completed.
+  void Preallocate(page_id_t end_page_id);
+  void NoteWrites(page_id_t end_page_id, size_t count);
+
+ private:
+  void ReadAt(char *buf, size_t len, int64_t offset);
+  void WriteAt(const char *buf, size_t len, int64_t offset);
+
+  std::string path_;
+  int fd_{-1};
+  bool direct_io_;
+  size_t sync_batch_;
+  std::atomic<size_t> preallocate_pages_;
+  // one past the highest page written so far
+  std::atomic<page_id_t> num_pages_{0};
+  std::atomic<page_id_t> allocated_pages_{0};
+  std::mutex alloc_latch_;
+  std::atomic<uint64_t> writes_issued_{0};
+  std::atomic<uint64_t> writes_synced_{0};
+  std::atomic<uint64_t> num_syncs_{0};
+  std::mutex sync_latch_;
+};
+
+}  // namespace bicycletub
@@ -1,32 +1,129 @@
 #pragma once
 
-#include <unordered_map>
-#include <vector>
 #include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
 #include <shared_mutex>
+#include <string>
 
 #include "types.h"
+#include "disk_manager.h"
+#include "size_class_allocator.h"
 
 namespace bicycletub {
 
-// Very simple in-memory disk manager: all pages live in a map.
-// We can optimize it with parallelism if needed.
-// Now we use a latch for everything to keep it simple.
-class DiskManagerMemory {
+// In-memory disk manager. Page ids handed out by NewPage() are dense, so instead of a hash
+// map the pages live in a two-level directory of fixed-size chunks:
+//   page_id -> directory segment -> chunk -> slot
+// Locating a page is index arithmetic, nothing is ever rehashed or moved, and every chunk
+// has its own latch, so scheduler workers touching different chunks never contend.
+// Segments and chunks are created on first write and published with an atomic pointer.
+// Pages that were never written read as zeros without latching exclusively or allocating.
+//
+// With compress set, pages are stored encoded by PageCodec in blobs from a
+// SizeClassAllocator instead of in the chunk slabs: writes encode before taking the chunk
+// latch, reads decode under the shared latch.
+//
+// SaveImage/LoadImage stream the whole store to and from one file, a chunk (1 MiB) per
+// write, so a process can restart without rebuilding its indexes.
+class DiskManagerMemory : public DiskManager {
  public:
-  DiskManagerMemory() = default;
+  // pages per chunk, the unit of allocation and latching (1 MiB of page data)
+  static constexpr size_t CHUNK_PAGES = 256;
+  // chunks per directory segment
+  static constexpr size_t SEGMENT_CHUNKS = 2048;
+  // segments in the root, enough for every non-negative page_id_t
+  static constexpr size_t ROOT_SEGMENTS = 4096;
 
+  explicit DiskManagerMemory(bool compress = false);
+  ~DiskManagerMemory() override;
+
+  // throws std::runtime_error if the page is already allocated
   auto AllocatePage(page_id_t page_id) -> page_id_t;
-  void DeallocatePage(page_id_t page_id);
+  void DeallocatePage(page_id_t page_id) override;
+
+  void ReadPage(page_id_t page_id, char *out_buf) override;
+  void WritePage(page_id_t page_id, const char *buf) override;
+
+  // Vectored access, each chunk of the run is latched once.
+  void ReadPages(page_id_t first_page_id, char *const *out_bufs, size_t count) override;
+  void WritePages(page_id_t first_page_id, const char *const *bufs, size_t count) override;
 
-  void ReadPage(page_id_t page_id, char *out_buf);
-  void WritePage(page_id_t page_id, const char *buf);
+  // pages written (or explicitly allocated) and not deallocated since
+  auto NumPages() const -> size_t override;
+  // chunks whose page slab has been allocated
+  auto NumChunks() const -> size_t { return num_chunks_.load(); }
+  // one past the highest allocated page, 0 if there is none
+  auto GetPageIdLimit() const -> page_id_t;
 
-  auto NumPages() const -> size_t ;
+  // Writes every allocated page to path (replaced atomically). Chunks without pages are
+  // left as holes. Pages written concurrently may or may not make it into the image, so
+  // callers flush and quiesce the buffer pool first.
+  void SaveImage(const std::string &path) const;
+  // Fills an empty manager from an image written by SaveImage; throws std::runtime_error if
+  // the manager is not empty or the file is not a compatible image.
+  // use_mmap maps the image copy-on-write instead of reading it: loading is then independent
+  // of the image size and pages come in from the page cache on first access. Ignored in
+  // compressed mode, which has to encode every page anyway.
+  void LoadImage(const std::string &path, bool use_mmap = false);
+
+  auto IsCompressed() const -> bool { return compress_; }
+  // memory holding page contents: slabs, or compressed blobs rounded to their size class
+  auto GetStoredBytes() const -> size_t;
+  // logical bytes of the stored pages divided by GetStoredBytes()
+  auto GetCompressionRatio() const -> double;
 
  private:
-  std::unordered_map<page_id_t, std::array<char, PAGE_SIZE>> pages_;
-  mutable std::shared_mutex latch_;
+  struct SlabDeleter {
+    // slabs pointing into a mapped image are released with the mapping
+    SlabDeleter() : borrowed_(false) {}
+    explicit SlabDeleter(bool borrowed) : borrowed_(borrowed) {}
+    void operator()(char *slab) const;
+    bool borrowed_;
+  };
+  struct Chunk {
+    std::shared_mutex latch_;
+    // which slots hold an allocated page
+    std::array<bool, CHUNK_PAGES> present_{};
+    // CHUNK_PAGES pages, allocated by the first write into the chunk
+    std::unique_ptr<char, SlabDeleter> slab_;
+    auto Page(size_t slot) -> char * { return slab_.get() + slot * PAGE_SIZE; }
+    // compressed mode instead: one blob per slot, size 0 is a zero page
+    std::array<char *, CHUNK_PAGES> blobs_{};
+    std::array<uint16_t, CHUNK_PAGES> blob_sizes_{};
+  };
+  struct Blob {
+    char *data_;
+    size_t size_;
+  };
+  struct Segment {
+    std::array<std::atomic<Chunk *>, SEGMENT_CHUNKS> chunks_{};
+  };
+
+  // the chunk holding page_id, created if it does not exist yet
+  auto GetChunk(page_id_t page_id) -> Chunk &;
+  // nullptr if the chunk was never created
+  auto FindChunk(page_id_t page_id) const -> Chunk *;
+  // marks the slot allocated, returns false if it already was; chunk latch held exclusively
+  auto Materialize(Chunk &chunk, size_t slot) -> bool;
+  // copies a page out, zeros if it was never written; chunk latch held shared
+  void CopyOut(Chunk &chunk, size_t slot, char *out_buf) const;
+  // stores a page; in compressed mode blob holds it already encoded and the replaced
+  // blob is returned for freeing after the latch is released; chunk latch held exclusively
+  auto Store(Chunk &chunk, size_t slot, const char *buf, Blob blob) -> Blob;
+  // encodes a page into a fresh blob (compressed mode only)
+  auto Encode(const char *buf) -> Blob;
+  void Release(Blob blob);
+
+  bool compress_;
+  SizeClassAllocator blob_allocator_;
+  std::unique_ptr<std::atomic<Segment *>[]> root_;
+  std::atomic<size_t> num_pages_{0};
+  std::atomic<size_t> num_chunks_{0};
+  // image mapped by LoadImage(path, true)
+  void *image_{nullptr};
+  size_t image_size_{0};
 };
 
 }  // namespace bicycletub
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <atomic>
+#include <mutex>
+#include <string>
+
+#include "types.h"
+#include "disk_manager.h"
+
+namespace bicycletub {
+
+// Disk manager that maps its data file (page i at offset i * PAGE_SIZE) and serves reads
+// and writes by copying from and to the mapping, so misses on cold data are absorbed by the
+// OS page cache and opening a large file costs nothing up front.
+//
+// The whole reservation is mapped once, so page addresses never move while the file grows.
+// With zero_copy (experimental) MappedPage() hands out those addresses and the buffer pool
+// lets read-only frames reference them instead of copying into pool memory; a frame copies
+// the page into its own buffer the first time it is written.
+class DiskManagerMmap : public DiskManager {
+ public:
+  // 4 GiB of address space
+  static constexpr size_t DEFAULT_RESERVE_PAGES = 1 << 20;
+  // the file is extended in steps of this many pages
+  static constexpr size_t GROW_PAGES = 1024;
+
+  explicit DiskManagerMmap(const std::string &path, bool zero_copy = false,
+                           size_t reserve_pages = DEFAULT_RESERVE_PAGES);
+  ~DiskManagerMmap() override;
+
+  void ReadPage(page_id_t page_id, char *out_buf) override;
+  // throws std::runtime_error beyond the reservation
+  void WritePage(page_id_t page_id, const char *buf) override;
+  // punches a hole where the filesystem supports it
+  void DeallocatePage(page_id_t page_id) override;
+  // msync over every written page
+  void Sync() override;
+  auto NumPages() const -> size_t override;
+
+  // only in zero-copy mode, and only for pages inside the file
+  auto MappedPage(page_id_t page_id) -> const char * override;
+  // madvise: SEQUENTIAL also starts read-ahead of the range
+  void Advise(page_id_t first_page_id, size_t count, AccessHint hint) override;
+
+  auto GetPath() const -> const std::string & { return path_; }
+  auto IsZeroCopy() const -> bool { return zero_copy_; }
+
+ private:
+  // makes sure the file covers pages below end_page_id
+  void Grow(page_id_t end_page_id);
+  auto PageAddress(page_id_t page_id) const -> char * { return base_ + static_cast<size_t>(page_id) * PAGE_SIZE; }
+
+  std::string path_;
+  int fd_{-1};
+  bool zero_copy_;
+  size_t reserve_pages_;
+  char *base_{nullptr};
+  // pages covered by the file, and one past the highest page written
+  std::atomic<page_id_t> file_pages_{0};
+  std::atomic<page_id_t> num_pages_{0};
+  std::mutex grow_latch_;
+};
+
+}  // namespace bicycletub
@@ -1,80 +1,145 @@
 #pragma once
 
-#include <future>  // NOLINT
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <deque>
+#include <memory>
 #include <optional>
+#include <span>
 #include <thread>  // NOLINT
 #include <vector>
-#include <queue>
 #include <mutex>
 #include <condition_variable>
 
 #include "types.h"
-#include "disk_manager_memory.h"
+#include "disk_manager.h"
 
 namespace bicycletub
 {
-struct DiskRequest {
-  bool is_write_;
-  char *data_;
-  page_id_t page_id_;
-  std::promise<bool> callback_;
-};
+class IoUringEngine;
 
-template <class T>
-class Channel {
+// Completion flag of a DiskRequest. The issuer waits on it and the worker thread
+// sets it, so it can live in the frame (or on the issuer's stack) instead of
+// allocating a promise/future pair for every request.
+// It must stay alive until Wait() has returned.
+class DiskCompletion {
  public:
-  Channel() = default;
-  ~Channel() = default;
-
-  void Put(T element) {
-    std::unique_lock<std::mutex> lk(m_);
-    q_.push(std::move(element));
-    lk.unlock();
-    cv_.notify_all();
+  DiskCompletion() = default;
+  DiskCompletion(const DiskCompletion &) = delete;
+  auto operator=(const DiskCompletion &) -> DiskCompletion & = delete;
+
+  void Reset() { state_.store(PENDING, std::memory_order_relaxed); }
+
+  void Complete(bool ok) { Finish(ok ? SUCCEEDED : FAILED); }
+  // failed because the page read back did not verify (PageCorruptionError)
+  void CompleteCorrupted() { Finish(CORRUPTED); }
+
+  auto IsDone() const -> bool { return state_.load(std::memory_order_acquire) != PENDING; }
+  // only meaningful once done
+  auto IsCorrupted() const -> bool { return state_.load(std::memory_order_acquire) == CORRUPTED; }
+
+  // Blocks until the request is completed, returns whether it succeeded.
+  auto Wait() const -> bool {
+    uint32_t state = state_.load(std::memory_order_acquire);
+    while (state == PENDING) {
+      state_.wait(PENDING, std::memory_order_acquire);
+      state = state_.load(std::memory_order_acquire);
+    }
+    return state == SUCCEEDED;
   }
 
-  auto Get() -> T {
-    std::unique_lock<std::mutex> lk(m_);
-    cv_.wait(lk, [&]() { return !q_.empty(); });
-    T element = std::move(q_.front());
-    q_.pop();
-    return element;
+ private:
+  static constexpr uint32_t PENDING = 0;
+  static constexpr uint32_t SUCCEEDED = 1;
+  static constexpr uint32_t FAILED = 2;
+  static constexpr uint32_t CORRUPTED = 3;
+
+  void Finish(uint32_t state) {
+    state_.store(state, std::memory_order_release);
+    state_.notify_all();
   }
 
- private:
-  std::mutex m_;
-  std::condition_variable cv_;
-  std::queue<T> q_;
+  std::atomic<uint32_t> state_{SUCCEEDED};
+};
+
+// Service classes, highest first. Synchronous misses and flushes are FOREGROUND,
+// read-ahead is PREFETCH, and checkpoint/background write-back is BACKGROUND.
+enum class DiskRequestPriority : uint8_t { FOREGROUND = 0, PREFETCH, BACKGROUND };
+
+struct DiskRequest {
+  bool is_write_;
+  char *data_;
+  page_id_t page_id_;
+  DiskCompletion *callback_;
+  DiskRequestPriority priority_{DiskRequestPriority::FOREGROUND};
 };
 
 class DiskScheduler {
  public:
-  using DiskManager = bicycletub::DiskManagerMemory;
-  explicit DiskScheduler(DiskManager *disk_manager) : disk_manager_(disk_manager) {
-    background_thread_.emplace([&] { StartWorkerThread(); });
-  }
+  using DiskManager = bicycletub::DiskManager;
+  // background requests served per round while higher classes have work queued
+  static constexpr size_t DEFAULT_BACKGROUND_BUDGET = 8;
+  // background requests served per round when nothing else is queued
+  static constexpr size_t DEFAULT_BACKGROUND_BATCH = 64;
+
+  // use_io_uring: serve batches through an IoUringEngine when the disk manager is file
+  //               backed and the kernel supports it, otherwise the worker calls the disk manager.
+  explicit DiskScheduler(DiskManager *disk_manager, bool use_io_uring = true);
   ~DiskScheduler();
 
-  void Schedule(std::vector<DiskRequest> &requests);
+  // Requests are copied into the queue, so the span may point at the caller's stack.
+  void Schedule(std::span<DiskRequest> requests);
 
+  // Each round the worker takes every queued FOREGROUND request (or, if there are
+  // none, every PREFETCH request) plus a bounded slice of BACKGROUND requests. Each
+  // class is sorted by page id and runs of adjacent pages going in the same
+  // direction are served with one vectored disk call, highest class first.
   void StartWorkerThread();
 
-  using DiskSchedulerPromise = std::promise<bool>;
+  // Lets the io_uring engine use these PAGE_SIZE buffers (the buffer pool frames) as fixed
+  // buffers. Call before the first Schedule(), from any thread: the worker is then idle and
+  // only touches the engine for a batch it dequeued, which the queue latch orders after
+  // this call. Returns false if there is no engine or the kernel refused the registration.
+  auto RegisterBuffers(std::span<char *const> buffers) -> bool;
 
-  auto CreatePromise() -> DiskSchedulerPromise { return {}; };
+  auto UsesIoUring() const -> bool { return engine_ != nullptr; }
+
+  void SetBackgroundBudget(size_t budget, size_t batch) {
+    std::lock_guard<std::mutex> lk(queue_latch_);
+    background_budget_ = std::max<size_t>(budget, 1);
+    background_batch_ = std::max<size_t>(batch, 1);
+  }
 
   // Metrics
   uint64_t GetScheduledReads() const { return scheduled_reads_.load(); }
   uint64_t GetScheduledWrites() const { return scheduled_writes_.load(); }
+  // requests served as part of a run of two or more adjacent pages
+  uint64_t GetCoalescedRequests() const { return coalesced_requests_.load(); }
 
   void DeallocatePage(page_id_t page_id) { disk_manager_->DeallocatePage(page_id); }
 
  private:
+  static constexpr size_t NUM_PRIORITIES = 3;
+
+  void ProcessBatch(std::vector<DiskRequest> &batch);
+  // one page through the disk manager, completing the request with the outcome
+  void Serve(DiskRequest &request);
+
   DiskManager *disk_manager_;
-  Channel<std::optional<DiskRequest>> request_queue_;
+  std::unique_ptr<IoUringEngine> engine_;
+  std::mutex queue_latch_;
+  std::condition_variable queue_cv_;
+  std::array<std::deque<DiskRequest>, NUM_PRIORITIES> queues_;
+  bool stop_{false};
+  size_t background_budget_{DEFAULT_BACKGROUND_BUDGET};
+  size_t background_batch_{DEFAULT_BACKGROUND_BATCH};
   std::optional<std::thread> background_thread_;
   std::atomic<uint64_t> scheduled_reads_{0};
   std::atomic<uint64_t> scheduled_writes_{0};
+  std::atomic<uint64_t> coalesced_requests_{0};
+  // scratch buffer list for vectored calls, only touched by the worker thread
+  std::vector<char *> run_bufs_;
 };
 } // namespace bicycletub
 
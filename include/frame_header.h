@@ -1,11 +1,13 @@
 #pragma once
 
+#include <algorithm>
 #include <memory>
 #include <vector>
 #include <atomic>
 #include <shared_mutex>
 
 #include "types.h"
+#include "disk_scheduler.h"
 
 
 namespace bicycletub {
@@ -14,25 +16,57 @@ class FrameHeader {
   friend class BufferPoolManager;
   friend class ReadPageGuard;
   friend class WritePageGuard;
+  friend class AtomicWriteScope;
 
  public:
   explicit FrameHeader(frame_id_t frame_id)
-  : frame_id_(frame_id), data_(PAGE_SIZE, 0) { Reset(); }
+  : frame_id_(frame_id) { Reset(); }
 
  private:
-  auto GetData() const -> const char * { return data_.data(); };
-  auto GetDataMut() -> char * { return data_.data(); };
+  auto GetData() const -> const char * { return mapped_ != nullptr ? mapped_ : data_; };
+  // a zero-copy frame takes a private copy of the page before it can be modified
+  auto GetDataMut() -> char * {
+    if (mapped_ != nullptr) {
+      std::copy_n(mapped_, PAGE_SIZE, data_);
+      mapped_ = nullptr;
+    }
+    return data_;
+  };
+  auto IsMapped() const -> bool { return mapped_ != nullptr; }
   void Reset() {
-    std::fill(data_.begin(), data_.end(), 0);
+    mapped_ = nullptr;
+    std::fill_n(data_, PAGE_SIZE, 0);
     pin_count_.store(0);
     is_dirty_ = false;
+    page_lsn_ = INVALID_LSN;
+    rec_lsn_.store(INVALID_LSN);
+    prefetching_ = false;
+  }
+  // the page was written back, its logged changes are on disk
+  void MarkClean() {
+    is_dirty_ = false;
+    rec_lsn_.store(INVALID_LSN);
   }
 
   frame_id_t frame_id_;
   std::shared_mutex rwlatch_;
   std::atomic<size_t> pin_count_;
   bool is_dirty_;
-  std::vector<char> data_;
+  // LSN of the log record holding the latest image of the page; the log is flushed up to it
+  // before the page is written (pages have no header to stamp it into)
+  lsn_t page_lsn_{INVALID_LSN};
+  // LSN from which changes of the page may be missing on disk (the first change logged since
+  // it was last written), INVALID_LSN when clean; checkpoints read it without the latch
+  std::atomic<lsn_t> rec_lsn_{INVALID_LSN};
+  // signalled by the disk scheduler when the frame's pending read/write is done
+  DiskCompletion io_done_;
+  // a read started by BufferPoolManager::Prefetch may still be filling the frame; guarded by
+  // the pool latch
+  bool prefetching_{false};
+  // zero-copy reads: the disk manager's copy of the page, used instead of data_ until written
+  const char *mapped_{nullptr};
+  // page aligned so direct and registered-buffer I/O can target the frame itself
+  alignas(PAGE_SIZE) char data_[PAGE_SIZE];
 };
 
 
@@ -1,34 +1,74 @@
 #pragma once
+#include <functional>
+#include <optional>
 #include <utility>
 #include "b_plus_tree_leaf_page.h"
+#include "page_guard.h"
 
 namespace bicycletub {
 
 #define INDEXITERATOR_TYPE IndexIterator<KeyType, ValueType, KeyComparator>
 
+// Keeps the current leaf read-latched and pinned, so dereferencing and incrementing only
+// touch the page in memory; the buffer pool is asked for a page only when the iterator
+// crosses to the next leaf, which is latched before the current one is released. The
+// latch is given up once the iterator reaches the end, so an end iterator holds nothing, and
+// all iterators at the end compare equal. A live iterator blocks writers of its leaf: drop
+// it before modifying the tree from the same thread.
+// The iterator is bidirectional: operator-- steps back through prev_page_id_, and stepping
+// back from the first entry also ends it. Moving left cannot latch hand over hand (writers
+// latch leaves left to right), so the tree supplies how to reach the left neighbour.
 INDEX_TEMPLATE_ARGUMENTS
 class IndexIterator {
+  using LeafPage = B_PLUS_TREE_LEAF_PAGE_TYPE;
+
  public:
+  // releases the given leaf and returns the leaf holding the last entry below a key together
+  // with that entry's index, read-latched; nullopt if there is no such entry
+  using StepLeftFn = std::function<std::optional<std::pair<ReadPageGuard, int>>(ReadPageGuard, const KeyType &)>;
+
   IndexIterator();
   ~IndexIterator();
 
-  IndexIterator(page_id_t page_id, int index, BufferPoolManager *bpm)
-      : page_id_(page_id), index_(index), bpm_(bpm) {}
+  // at index of the leaf guard holds; an index past the leaf's last entry moves on to the
+  // following leaf, a negative one back to the preceding leaf
+  IndexIterator(ReadPageGuard guard, int index, BufferPoolManager *bpm, StepLeftFn step_left);
+
+  IndexIterator(IndexIterator &&) noexcept = default;
+  auto operator=(IndexIterator &&) noexcept -> IndexIterator & = default;
 
-  auto IsEnd() -> bool;
+  auto IsEnd() const -> bool { return !guard_.has_value(); }
 
   auto operator*() -> std::pair<const KeyType &, const ValueType &>;
 
   auto operator++() -> IndexIterator &;
 
-  auto operator==(const IndexIterator &itr) const -> bool { return page_id_ == itr.page_id_ && index_ == itr.index_; }
+  auto operator--() -> IndexIterator &;
+
+  auto operator==(const IndexIterator &itr) const -> bool {
+    if (IsEnd() || itr.IsEnd()) {
+      return IsEnd() && itr.IsEnd();
+    }
+    return page_id_ == itr.page_id_ && index_ == itr.index_;
+  }
 
   auto operator!=(const IndexIterator &itr) const -> bool { return !(*this == itr); }
 
  private:
+  // moves on to the next non-empty leaf while index_ is past the current leaf's entries,
+  // hand over hand; releases the latch at the end of the leaf chain
+  void Settle();
+  // moves to the last entry below bound, which lies left of the current leaf; releases the
+  // latch if there is none
+  void StepBack(const KeyType &bound);
+
+  std::optional<ReadPageGuard> guard_{std::nullopt};
+  // the latched leaf, valid while guard_ is
+  const LeafPage *leaf_{nullptr};
   page_id_t page_id_{INVALID_PAGE_ID};
   int index_{0};
   BufferPoolManager *bpm_{nullptr};
+  StepLeftFn step_left_;
 
 };
 
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <unordered_map>
+
+#include "types.h"
+
+struct io_uring_params;
+
+namespace bicycletub {
+
+class DiskManagerFile;
+struct DiskRequest;
+
+// Serves DiskScheduler batches against a DiskManagerFile through io_uring: a whole
+// batch is queued as one read/write per page, submitted with a single io_uring_enter
+// and completions are harvested as they arrive. Buffers registered with
+// RegisterBuffers (the buffer pool frames) use the fixed-buffer opcodes, so the
+// kernel does not have to map the pages for every request.
+// Not thread-safe. Process() only runs on the scheduler's worker thread. RegisterBuffers()
+// runs on the thread that sets up the buffer pool, before the pool schedules its first
+// request: the worker only reaches the engine with a batch it took from the scheduler's
+// queue, and queue_latch_ orders that after the registration.
+class IoUringEngine {
+ public:
+  static constexpr unsigned DEFAULT_QUEUE_DEPTH = 256;
+
+  // Returns nullptr when the kernel (or a seccomp policy) does not provide io_uring.
+  static auto Create(DiskManagerFile *disk, unsigned queue_depth = DEFAULT_QUEUE_DEPTH)
+      -> std::unique_ptr<IoUringEngine>;
+
+  IoUringEngine(const IoUringEngine &) = delete;
+  auto operator=(const IoUringEngine &) -> IoUringEngine & = delete;
+  ~IoUringEngine();
+
+  // Replaces the registered buffer set; each buffer is PAGE_SIZE bytes. Must not overlap
+  // with Process(), see above.
+  // Returns false if the kernel refused them (e.g. RLIMIT_MEMLOCK), requests then use plain opcodes.
+  auto RegisterBuffers(std::span<char *const> buffers) -> bool;
+
+  // Serves every request of the batch and completes its callback. Requests on the same
+  // page are executed in batch order. Short or failed transfers are retried through the
+  // disk manager's synchronous path, so end-of-file reads still return zero pages.
+  void Process(std::span<DiskRequest> batch);
+
+  // set after io_uring_enter failed for good; the scheduler then stops using the engine
+  auto IsBroken() const -> bool { return broken_; }
+
+  auto GetNumEnters() const -> uint64_t { return num_enters_; }
+  auto GetFixedRequests() const -> uint64_t { return fixed_requests_; }
+
+ private:
+  IoUringEngine(DiskManagerFile *disk, int ring_fd);
+
+  // maps the rings described by io_uring_setup
+  auto Setup(const io_uring_params &params) -> bool;
+  // submits queued entries and optionally waits for at least one completion; false on a hard error
+  auto Enter(unsigned to_submit, bool wait) -> bool;
+  // harvests every available completion, returns how many
+  auto Reap(std::span<DiskRequest> batch) -> unsigned;
+  void Finish(DiskRequest &request, int32_t result);
+  void ServeSynchronously(DiskRequest &request);
+
+  DiskManagerFile *disk_;
+  int ring_fd_;
+  bool direct_io_;
+  bool broken_{false};
+
+  void *sq_ring_{nullptr};
+  size_t sq_ring_size_{0};
+  void *cq_ring_{nullptr};
+  size_t cq_ring_size_{0};
+  void *sqes_{nullptr};
+  size_t sqes_size_{0};
+  unsigned sq_entries_{0};
+
+  unsigned *sq_head_{nullptr};
+  unsigned *sq_tail_{nullptr};
+  unsigned sq_mask_{0};
+  unsigned *sq_array_{nullptr};
+  unsigned *cq_head_{nullptr};
+  unsigned *cq_tail_{nullptr};
+  unsigned cq_mask_{0};
+  void *cqes_{nullptr};
+
+  // registered buffer -> index for the *_FIXED opcodes
+  std::unordered_map<const char *, uint16_t> fixed_buffers_;
+
+  uint64_t num_enters_{0};
+  uint64_t fixed_requests_{0};
+};
+
+}  // namespace bicycletub
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <cstdint>
+
+namespace bicycletub {
+
+// Lower bound over an ascending int32_t array, the in-page search for IntegerKey pages.
+// Returns the index of the first of the n keys that is not less than key, n if there is none.
+// The range is first halved without branches (conditional moves) down to a small window,
+// which is then counted with one vector compare pass: AVX2 when the CPU has it, SSE2 on any
+// other x86-64, and the branchless halving all the way down elsewhere.
+auto LowerBoundInt32(const int32_t *keys, int n, int32_t key) -> int;
+
+// The branchless scalar search, exposed for tests and benchmarks.
+auto LowerBoundInt32Portable(const int32_t *keys, int n, int32_t key) -> int;
+
+// Whether LowerBoundInt32 finishes with vector compares.
+auto KeySearchIsVectorized() -> bool;
+
+}  // namespace bicycletub
@@ -0,0 +1,194 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <string>
+#include <thread>  // NOLINT
+#include <utility>
+#include <vector>
+
+#include "page_codec.h"
+#include "types.h"
+
+namespace bicycletub {
+
+enum class LogRecordType : uint8_t {
+  INVALID = 0,
+  PAGE_IMAGE,
+  COMMIT,
+  CHECKPOINT_BEGIN,
+  // payload: the BEGIN record's LSN followed by the dirty page table (DirtyPageEntry[])
+  CHECKPOINT_END,
+  // the images of every page one atomic operation changed, see AtomicWriteScope
+  MULTI_PAGE_IMAGE,
+};
+
+// Layout of a record in the log, its payload follows directly.
+struct LogRecordHeader {
+  // header plus payload
+  uint32_t size_;
+  // CRC32C of everything after this field, so a torn tail is recognized
+  uint32_t checksum_;
+  lsn_t lsn_;
+  LogRecordType type_;
+  uint8_t reserved_[3];
+  page_id_t page_id_;
+};
+static_assert(sizeof(LogRecordHeader) == 24);
+
+// Dirty page table entry of a checkpoint: the page's changes from rec_lsn_ on may be
+// missing on disk.
+struct DirtyPageEntry {
+  page_id_t page_id_;
+  lsn_t rec_lsn_;
+};
+
+// Where the last complete checkpoint is, kept in the master record next to the log.
+struct CheckpointLocation {
+  lsn_t begin_lsn_;
+  lsn_t end_lsn_;
+};
+
+struct LogRecord {
+  lsn_t lsn_{INVALID_LSN};
+  LogRecordType type_{LogRecordType::INVALID};
+  page_id_t page_id_{INVALID_PAGE_ID};
+  std::vector<char> payload_;
+};
+
+// Sequential reader over a log file written by LogManager.
+class LogReader {
+ public:
+  // Starts at the first record, or at start_lsn (which has to be the LSN of a record).
+  // Throws std::runtime_error if path exists but is not a log, or start_lsn was truncated away.
+  explicit LogReader(const std::string &path, lsn_t start_lsn = INVALID_LSN);
+  ~LogReader();
+  LogReader(const LogReader &) = delete;
+  auto operator=(const LogReader &) -> LogReader & = delete;
+
+  // Reads the next record; false at the end of the log or at the first record that is
+  // incomplete or fails its checksum (the tail of a crashed write).
+  auto Next(LogRecord *record) -> bool;
+  // LSN the log starts at (records before it were truncated away)
+  auto GetBeginLsn() const -> lsn_t { return begin_lsn_; }
+  // LSN right after the last record Next() returned
+  auto GetEndLsn() const -> lsn_t { return end_lsn_; }
+
+ private:
+  std::FILE *file_{nullptr};
+  // bytes of the file holding records, a torn size field cannot make Next read past them
+  lsn_t file_records_{0};
+  lsn_t begin_lsn_{0};
+  lsn_t end_lsn_{0};
+};
+
+// Write-ahead log. Records are appended to an in-memory buffer and get the LSN of their
+// position in the log; a flusher thread writes the buffer out and makes it durable with one
+// fdatasync. Every caller that asks for durability while a sync is running is served by the
+// next one, so concurrent commits share syncs (group commit), and appends never wait for
+// the disk unless the buffer is full.
+// The buffer pool logs every page a write guard modified as an image and, before it writes
+// a page, flushes the log up to that image (the WAL rule), see BufferPoolManager.
+class LogManager {
+ public:
+  static constexpr size_t DEFAULT_BUFFER_SIZE = 1 << 20;
+
+  // Opens (or creates) the log at path; a torn tail left by a crash is cut off and new
+  // records continue after the last intact one.
+  explicit LogManager(std::string path, size_t buffer_size = DEFAULT_BUFFER_SIZE);
+  // makes everything appended durable
+  ~LogManager();
+  LogManager(const LogManager &) = delete;
+  auto operator=(const LogManager &) -> LogManager & = delete;
+
+  auto Append(LogRecordType type, page_id_t page_id, const char *payload, size_t size) -> lsn_t;
+  // a PAGE_IMAGE record holding the page encoded by PageCodec
+  auto AppendPageImage(page_id_t page_id, const char *page) -> lsn_t;
+  // one record holding all these pages, recovery applies all of them or none
+  auto AppendPageImages(std::span<const std::pair<page_id_t, const char *>> pages) -> lsn_t;
+  // Appends a COMMIT record and returns once it is durable.
+  auto Commit() -> lsn_t;
+  // Blocks until the record at lsn (and everything before it) is durable. Throws
+  // std::runtime_error if the log could not be written.
+  void Flush(lsn_t lsn);
+
+  // records starting below this LSN are durable
+  auto GetPersistentLsn() const -> lsn_t;
+  // LSN the next record gets
+  auto GetNextLsn() const -> lsn_t;
+  auto GetPath() const -> const std::string & { return path_; }
+  auto GetNumSyncs() const -> uint64_t;
+  auto GetNumRecords() const -> uint64_t;
+
+  // Makes the checkpoint between these records the starting point of recovery
+  // (written atomically to GetMasterPath()).
+  void SetCheckpoint(lsn_t begin_lsn, lsn_t end_lsn);
+  static auto ReadCheckpoint(const std::string &log_path) -> std::optional<CheckpointLocation>;
+  static auto GetMasterPath(const std::string &log_path) -> std::string { return log_path + ".master"; }
+
+  // restores a page from a PAGE_IMAGE record
+  static void DecodePageImage(const LogRecord &record, char *page);
+  // Decodes every page of a PAGE_IMAGE or MULTI_PAGE_IMAGE record into page (PAGE_SIZE
+  // bytes) and calls visit(page_id) for each; other records have none.
+  template <class Visitor>
+  static void ForEachPageImage(const LogRecord &record, char *page, Visitor &&visit);
+
+ private:
+  void RunFlusher();
+
+  std::string path_;
+  std::FILE *file_{nullptr};
+  size_t buffer_size_;
+
+  mutable std::mutex latch_;
+  // wakes the flusher
+  std::condition_variable flush_cv_;
+  // signalled after each sync, and when buffer space frees up
+  std::condition_variable flushed_cv_;
+  // appends go to active_, the flusher writes flushing_ without holding the latch
+  std::vector<char> active_;
+  std::vector<char> flushing_;
+  lsn_t next_lsn_{0};
+  lsn_t persistent_lsn_{0};
+  // highest LSN a caller is waiting for
+  lsn_t wanted_lsn_{INVALID_LSN};
+  bool stop_{false};
+  bool failed_{false};
+  uint64_t num_syncs_{0};
+  uint64_t num_records_{0};
+  std::optional<std::thread> flusher_;
+};
+
+// MULTI_PAGE_IMAGE payload: per page a MultiPageEntry followed by the encoded image.
+struct MultiPageEntry {
+  page_id_t page_id_;
+  uint32_t size_;
+};
+
+template <class Visitor>
+void LogManager::ForEachPageImage(const LogRecord &record, char *page, Visitor &&visit) {
+  if (record.type_ == LogRecordType::PAGE_IMAGE) {
+    DecodePageImage(record, page);
+    visit(record.page_id_);
+    return;
+  }
+  if (record.type_ != LogRecordType::MULTI_PAGE_IMAGE) {
+    return;
+  }
+  size_t pos = 0;
+  while (pos + sizeof(MultiPageEntry) <= record.payload_.size()) {
+    MultiPageEntry entry;
+    std::memcpy(&entry, record.payload_.data() + pos, sizeof(entry));
+    pos += sizeof(entry);
+    PageCodec::Decompress(record.payload_.data() + pos, entry.size_, page);
+    pos += entry.size_;
+    visit(entry.page_id_);
+  }
+}
+
+}  // namespace bicycletub
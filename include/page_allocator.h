@@ -0,0 +1,82 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "types.h"
+
+namespace bicycletub {
+
+// Owner of a sequence of extents, e.g. one index or table (or one loading thread).
+enum class AllocationGroup : int32_t { DEFAULT = 0 };
+
+// Hands out page ids in extents of EXTENT_SIZE contiguous pages. Every extent belongs to
+// one allocation group and a group fills its current extent before it takes the next free
+// one, so pages of one tree stay together even when several trees or threads allocate at
+// the same time. Allocating near a hint page first looks for a free slot after the hint in
+// the hint's own extent, which keeps a leaf and the sibling split off it adjacent and makes
+// next-page chains mostly ascending runs on disk.
+// Pages of the default group are dense as long as no other group allocates, which is what
+// NewPage() callers always got.
+// Allocation is serialized by a latch. The extents' slot masks live in a two-level
+// directory whose blocks never move, so IsAllocated() reads them without the latch.
+class PageAllocator {
+ public:
+  static constexpr size_t EXTENT_SIZE = 64;
+  // extents per directory block
+  static constexpr size_t BLOCK_EXTENTS = 4096;
+  // enough blocks for every non-negative page_id_t
+  static constexpr size_t ROOT_BLOCKS = (size_t{1} << 31) / EXTENT_SIZE / BLOCK_EXTENTS;
+
+  PageAllocator();
+  ~PageAllocator();
+  PageAllocator(const PageAllocator &) = delete;
+  auto operator=(const PageAllocator &) -> PageAllocator & = delete;
+
+  // a group with no extents yet; its first allocation opens a fresh extent
+  auto NewGroup() -> AllocationGroup;
+  auto Allocate(AllocationGroup group = AllocationGroup::DEFAULT) -> page_id_t;
+  // allocates in hint's group, as close after hint as possible; an invalid or unallocated
+  // hint falls back to the default group
+  auto AllocateNear(page_id_t hint) -> page_id_t;
+
+  // marks pages [0, end_page_id) allocated (in the default group), for a store that already
+  // holds pages, e.g. one loaded from an image; the extents' original groups are not known
+  void Adopt(page_id_t end_page_id);
+
+  // lock-free, so the buffer pool can ask under its own latch
+  auto IsAllocated(page_id_t page_id) const -> bool;
+  auto GetNumExtents() const -> size_t;
+
+ private:
+  struct ExtentBlock {
+    // per extent the slots in use; written under latch_, read by IsAllocated() without it
+    std::array<std::atomic<uint64_t>, BLOCK_EXTENTS> used_{};
+    std::array<AllocationGroup, BLOCK_EXTENTS> groups_{};
+  };
+  static constexpr size_t NO_EXTENT = SIZE_MAX;
+  static_assert(EXTENT_SIZE == 64, "an extent's slots are tracked in one 64-bit mask");
+
+  // the block holding extent, nullptr if it was never created
+  auto FindBlock(size_t extent) const -> ExtentBlock *;
+  // the block holding extent, created if needed; latch_ held
+  auto GetBlock(size_t extent) -> ExtentBlock &;
+  // appends an extent of group; latch_ held
+  auto AddExtent(AllocationGroup group) -> size_t;
+  // takes the lowest free slot of extent whose offset is at least from; INVALID_PAGE_ID if none
+  auto TakeSlot(size_t extent, size_t from) -> page_id_t;
+  auto AllocateLocked(AllocationGroup group) -> page_id_t;
+
+  mutable std::mutex latch_;
+  // blocks are published with release and never freed before the allocator
+  std::unique_ptr<std::atomic<ExtentBlock *>[]> root_;
+  size_t num_extents_{0};
+  // per group: the extent it is currently filling
+  std::vector<size_t> current_extent_{NO_EXTENT};
+};
+
+}  // namespace bicycletub
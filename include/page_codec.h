@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstddef>
+
+#include "types.h"
+
+namespace bicycletub {
+
+// Fast page codec used by the compressed DiskManagerMemory. Pages are mostly small
+// integers, zero padding and unused tail space, so instead of a general purpose LZ codec
+// it suppresses zero bytes:
+//   - an all-zero page encodes to 0 bytes,
+//   - trailing zeros are dropped (the decoder zero-fills the rest of the page),
+//   - every 8-byte group is written as a mask byte of its non-zero bytes followed by them.
+// A page that would not shrink is stored as-is, its encoded size is then PAGE_SIZE.
+class PageCodec {
+ public:
+  // worst-case encoded size written to out before falling back to a raw copy
+  static constexpr size_t MAX_ENCODED_SIZE = PAGE_SIZE + PAGE_SIZE / 8;
+
+  // Encodes one page into out (MAX_ENCODED_SIZE bytes) and returns the encoded size.
+  static auto Compress(const char *page, char *out) -> size_t;
+
+  // Decodes size bytes produced by Compress into a full page.
+  static void Decompress(const char *blob, size_t size, char *page);
+};
+
+}  // namespace bicycletub
@@ -1,10 +1,13 @@
 #pragma once
 
+#include <optional>
 #include <shared_mutex>
+#include <vector>
 #include "types.h"
 #include "frame_header.h"
 #include "arc_replacer.h"
 #include "disk_scheduler.h"
+#include "log_manager.h"
 
 namespace bicycletub {
 class ReadPageGuard {
@@ -29,18 +32,21 @@ class ReadPageGuard {
 
  private:
   explicit ReadPageGuard(page_id_t page_id, std::shared_ptr<FrameHeader> frame, std::shared_ptr<ArcReplacer> replacer,
-                         std::shared_ptr<std::mutex> bpm_latch, std::shared_ptr<DiskScheduler> disk_scheduler);
+                         std::shared_ptr<std::mutex> bpm_latch, std::shared_ptr<DiskScheduler> disk_scheduler,
+                         LogManager *log_manager);
 
   page_id_t page_id_;
   std::shared_ptr<FrameHeader> frame_;
   std::shared_ptr<ArcReplacer> replacer_;
   std::shared_ptr<std::mutex> bpm_latch_;
   std::shared_ptr<DiskScheduler> disk_scheduler_;
+  LogManager *log_manager_{nullptr};
   bool is_valid_{false};
 };
 
 class WritePageGuard {
   friend class BufferPoolManager;
+  friend class AtomicWriteScope;
 
  public:
   WritePageGuard() = default;
@@ -53,29 +59,77 @@ class WritePageGuard {
   auto GetData() const -> const char * { return frame_->GetData(); }
   template <class T>
   auto As() const -> const T * { return reinterpret_cast<const T *>(GetData()); }
-  // Any mutable access marks the frame as dirty to ensure it is flushed on eviction
+  // Any mutable access marks the frame as dirty to ensure it is flushed on eviction,
+  // and with a log manager the page image is logged when the guard is dropped
   auto GetDataMut() -> char * {
     frame_->is_dirty_ = true;
+    modified_ = true;
     return frame_->GetDataMut();
   }
   template <class T>
   auto AsMut() -> T * { return reinterpret_cast<T *>(GetDataMut()); }
   auto IsDirty() const -> bool { return frame_->is_dirty_; }
   void Flush();
+  // logs the changes made through this guard, then releases the latch and the pin
   void Drop();
   bool IsValid() const { return is_valid_; }
   ~WritePageGuard() { Drop(); }
 
  private:
   explicit WritePageGuard(page_id_t page_id, std::shared_ptr<FrameHeader> frame, std::shared_ptr<ArcReplacer> replacer,
-                          std::shared_ptr<std::mutex> bpm_latch, std::shared_ptr<DiskScheduler> disk_scheduler);
+                          std::shared_ptr<std::mutex> bpm_latch, std::shared_ptr<DiskScheduler> disk_scheduler,
+                          LogManager *log_manager);
+  // appends the page image if it was modified through this guard
+  void LogChanges();
+  // called before the page's changes are logged: sets the frame's rec_lsn_ if it was clean
+  void NoteRecoveryLsn();
 
   page_id_t page_id_;
   std::shared_ptr<FrameHeader> frame_;
   std::shared_ptr<ArcReplacer> replacer_;
   std::shared_ptr<std::mutex> bpm_latch_;
   std::shared_ptr<DiskScheduler> disk_scheduler_;
+  LogManager *log_manager_{nullptr};
+  // the page was changed through this guard and not logged yet
+  bool modified_{false};
   bool is_valid_{false};
 };
 
+// Makes the page changes of one operation, e.g. a B+ tree insert with all its splits, atomic
+// in the log (a mini-transaction). While the scope is open, modified write guards dropped on
+// this thread hand their latch and pin over to it instead of logging and releasing the page.
+// When the scope ends all those pages are logged as one MULTI_PAGE_IMAGE record and only then
+// released, so neither the disk nor recovery can ever see half of the operation.
+// Fetching a page the scope holds through BufferPoolManager::WritePage hands it back.
+// Without a log manager the scope does nothing.
+class AtomicWriteScope {
+  friend class BufferPoolManager;
+  friend class WritePageGuard;
+
+ public:
+  AtomicWriteScope() = default;
+  AtomicWriteScope(const AtomicWriteScope &) = delete;
+  auto operator=(const AtomicWriteScope &) -> AtomicWriteScope & = delete;
+  ~AtomicWriteScope() { Commit(); }
+
+  // logs the operation and releases its pages; the scope is closed afterwards
+  void Commit();
+
+ private:
+  AtomicWriteScope(LogManager *log_manager, const std::mutex *bpm_latch);
+
+  // takes over a modified guard being dropped on this thread; false if no scope is open
+  static auto Adopt(WritePageGuard &guard) -> bool;
+  // the guard of page_id held by this thread's scope on that pool, if any
+  static auto Reclaim(const std::mutex *bpm_latch, page_id_t page_id) -> std::optional<WritePageGuard>;
+
+  LogManager *log_manager_{nullptr};
+  // identifies the buffer pool
+  const std::mutex *bpm_latch_{nullptr};
+  std::vector<WritePageGuard> guards_;
+  // scope that was open on this thread before this one
+  AtomicWriteScope *outer_{nullptr};
+  bool open_{false};
+};
+
 } // namespace bicycletub
\ No newline at end of file
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "disk_manager.h"
+#include "log_manager.h"
+#include "types.h"
+
+namespace bicycletub {
+
+struct RecoveryStats {
+  // BEGIN record of the checkpoint recovery started from, INVALID_LSN without one
+  lsn_t checkpoint_lsn_{INVALID_LSN};
+  // where redo started and where the intact log ends
+  lsn_t redo_lsn_{0};
+  lsn_t end_lsn_{0};
+  // dirty page table size after analysis
+  size_t dirty_pages_{0};
+  size_t records_redone_{0};
+  size_t pages_written_{0};
+  // one past the highest page the log changed, e.g. for BufferPoolManager::AdoptPages
+  page_id_t page_id_end_{0};
+};
+
+// ARIES-style restart over the page image log of LogManager. Runs on the disk manager
+// before a buffer pool is put on it:
+//  - analysis reads the dirty page table of the last checkpoint (LogManager::ReadCheckpoint)
+//    and adds every page the log changed after the checkpoint began,
+//  - redo replays, from the smallest recovery LSN on, every image that may be missing on
+//    disk; repeated images of a page are collapsed and written in page order.
+// There is no undo pass: records are after-images of complete operations (a single guard or
+// an AtomicWriteScope) and the log holds no transactions that could lose, so the disk never
+// holds a change the log does not repeat. Without a checkpoint the whole log is redone.
+class RecoveryManager {
+ public:
+  RecoveryManager(std::string log_path, DiskManager *disk_manager);
+
+  auto Recover() -> RecoveryStats;
+
+ private:
+  // images collected by redo before they are written
+  static constexpr size_t MAX_PENDING_PAGES = 4096;
+
+  void Analysis(RecoveryStats *stats);
+  void Redo(RecoveryStats *stats);
+  void WritePending(RecoveryStats *stats);
+
+  std::string log_path_;
+  DiskManager *disk_manager_;
+  // page -> LSN from which its changes have to be redone; unused when redo_all_
+  std::unordered_map<page_id_t, lsn_t> dirty_pages_;
+  bool redo_all_{true};
+  std::map<page_id_t, std::vector<char>> pending_;
+};
+
+}  // namespace bicycletub
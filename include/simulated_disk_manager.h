@@ -0,0 +1,119 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "types.h"
+#include "disk_manager.h"
+#include "disk_scheduler.h"
+
+namespace bicycletub {
+
+// Timing model of a device, see SimulatedDiskManager.
+struct DiskProfile {
+  // positioning cost of an I/O that does not continue where the previous one ended
+  std::chrono::nanoseconds random_latency_;
+  // cost of an I/O that starts right after the previous one (read-ahead, no seek)
+  std::chrono::nanoseconds sequential_latency_;
+  // transfer rate shared by all in-flight I/Os, 0 for unlimited
+  uint64_t bandwidth_bytes_per_sec_;
+  // I/Os the device works on at the same time
+  size_t queue_depth_;
+  // cost of Sync() once every outstanding I/O has finished
+  std::chrono::nanoseconds sync_latency_;
+
+  // NVMe-class flash
+  static auto Ssd() -> DiskProfile {
+    using namespace std::chrono_literals;
+    return {80us, 20us, 2'000'000'000, 32, 200us};
+  }
+  // 7200 rpm spindle
+  static auto Hdd() -> DiskProfile {
+    using namespace std::chrono_literals;
+    return {8ms, 0us, 150'000'000, 1, 5ms};
+  }
+};
+
+// Decorator that makes any DiskManager (usually DiskManagerMemory) take as long as a real
+// device would, so prefetching, write-back and I/O scheduling show their effect in
+// benchmarks. Each call is one I/O (a vectored ReadPages/WritePages run is one I/O moving
+// count pages): it occupies the earliest free of queue_depth_ slots for its access latency,
+// then the shared transfer bandwidth, and the caller blocks until that completion time.
+// An I/O starting at the page after the previous one ended pays the sequential latency.
+//
+// Callers do not sleep individually: they park on a DiskCompletion registered in a timer
+// wheel, and a single timer thread advances the wheel and completes them when due.
+// The inner manager is not owned and must outlive the decorator.
+class SimulatedDiskManager : public DiskManager {
+ public:
+  SimulatedDiskManager(DiskManager *inner, DiskProfile profile);
+  ~SimulatedDiskManager() override;
+
+  void ReadPage(page_id_t page_id, char *out_buf) override;
+  void WritePage(page_id_t page_id, const char *buf) override;
+  void ReadPages(page_id_t first_page_id, char *const *out_bufs, size_t count) override;
+  void WritePages(page_id_t first_page_id, const char *const *bufs, size_t count) override;
+  // metadata only, no simulated cost
+  void DeallocatePage(page_id_t page_id) override { inner_->DeallocatePage(page_id); }
+  void Sync() override;
+  auto NumPages() const -> size_t override { return inner_->NumPages(); }
+  void Advise(page_id_t first_page_id, size_t count, AccessHint hint) override {
+    inner_->Advise(first_page_id, count, hint);
+  }
+
+  auto GetProfile() const -> const DiskProfile & { return profile_; }
+  auto GetSequentialIOs() const -> uint64_t { return sequential_ios_.load(); }
+  auto GetRandomIOs() const -> uint64_t { return random_ios_.load(); }
+  // simulated time callers spent blocked, summed over all I/Os
+  auto GetWaitTime() const -> std::chrono::nanoseconds { return std::chrono::nanoseconds(wait_ns_.load()); }
+
+ private:
+  using Clock = std::chrono::steady_clock;
+  static constexpr std::chrono::nanoseconds TICK{2000};
+  static constexpr size_t WHEEL_SLOTS = 1024;
+
+  struct Timer {
+    uint64_t tick_;
+    DiskCompletion *done_;
+  };
+
+  // books an I/O of count pages starting at first_page_id and returns when it completes
+  auto Reserve(page_id_t first_page_id, size_t count) -> Clock::time_point;
+  // blocks until due has passed
+  void WaitUntil(Clock::time_point due);
+  auto TickOf(Clock::time_point time) const -> uint64_t;
+  void RunTimer();
+
+  DiskManager *inner_;
+  DiskProfile profile_;
+
+  // device model
+  std::mutex model_latch_;
+  std::vector<Clock::time_point> slot_free_at_;
+  Clock::time_point bus_free_at_;
+  page_id_t next_sequential_page_{INVALID_PAGE_ID};
+
+  // timer wheel: a timer due at tick t sits in slot t % WHEEL_SLOTS until the hand reaches t
+  std::mutex wheel_latch_;
+  std::condition_variable wheel_cv_;
+  std::vector<std::vector<Timer>> wheel_;
+  Clock::time_point epoch_;
+  uint64_t hand_{0};
+  size_t pending_{0};
+  // tick the timer thread sleeps until; a sooner timer has to wake it
+  uint64_t wake_tick_{UINT64_MAX};
+  bool stop_{false};
+  std::optional<std::thread> timer_thread_;
+
+  std::atomic<uint64_t> sequential_ios_{0};
+  std::atomic<uint64_t> random_ios_{0};
+  std::atomic<uint64_t> wait_ns_{0};
+};
+
+}  // namespace bicycletub
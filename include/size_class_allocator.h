@@ -0,0 +1,52 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "types.h"
+
+namespace bicycletub {
+
+// Slab allocator for variable-sized blobs of at most PAGE_SIZE bytes, e.g. compressed
+// pages. Each request is rounded up to a size class; every class carves fixed-size slots
+// out of 64 KiB slabs and recycles freed slots through its own free list and latch, so
+// blobs of different sizes never fragment each other and never hit the general heap.
+// Memory is returned to the system only when the allocator is destroyed.
+class SizeClassAllocator {
+ public:
+  static constexpr std::array<size_t, 12> CLASS_SIZES = {64,  128,  192,  256,  384,  512,
+                                                          768, 1024, 1536, 2048, 3072, PAGE_SIZE};
+  static constexpr size_t SLAB_SIZE = 64 * 1024;
+
+  SizeClassAllocator() = default;
+  SizeClassAllocator(const SizeClassAllocator &) = delete;
+  auto operator=(const SizeClassAllocator &) -> SizeClassAllocator & = delete;
+
+  // size must be in [1, PAGE_SIZE]; the same size has to be passed to Free
+  auto Allocate(size_t size) -> char *;
+  void Free(char *blob, size_t size);
+
+  // bytes of slots handed out, including the rounding to size classes
+  auto GetAllocatedBytes() const -> size_t { return allocated_bytes_.load(); }
+  // bytes of slabs obtained from the system
+  auto GetReservedBytes() const -> size_t { return reserved_bytes_.load(); }
+
+  static auto ClassOf(size_t size) -> size_t;
+
+ private:
+  struct SizeClass {
+    std::mutex latch_;
+    std::vector<char *> free_;
+    std::vector<std::unique_ptr<char[]>> slabs_;
+  };
+
+  std::array<SizeClass, CLASS_SIZES.size()> classes_;
+  std::atomic<size_t> allocated_bytes_{0};
+  std::atomic<size_t> reserved_bytes_{0};
+};
+
+}  // namespace bicycletub
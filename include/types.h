@@ -8,9 +8,12 @@ namespace bicycletub {
 
 using page_id_t = int32_t;
 using frame_id_t = int32_t;
+// log sequence number: byte position of a log record in the write-ahead log
+using lsn_t = int64_t;
 
 constexpr page_id_t INVALID_PAGE_ID = -1;
 constexpr frame_id_t INVALID_FRAME_ID = -1;
+constexpr lsn_t INVALID_LSN = -1;
 
 struct RID {
   RID() = default;
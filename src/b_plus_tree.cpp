@@ -1,7 +1,14 @@
 #include "b_plus_tree.h"
 #include "b_plus_tree_key.h"
+#include <array>
 #include <cassert>
+#include <exception>
+#include <limits>
+#include <numeric>
+#include <stdexcept>
 #include <sstream>
+#include <thread>
+#include <type_traits>
 
 // Define BUSTUB_ASSERT macro if not already defined
 #ifndef BUSTUB_ASSERT
@@ -13,22 +20,53 @@ namespace bicycletub {
 INDEX_TEMPLATE_ARGUMENTS
 BPLUSTREE_TYPE::BPlusTree(std::string name, page_id_t header_page_id, BufferPoolManager *buffer_pool_manager,
                           const KeyComparator &comparator, int leaf_max_size, int internal_max_size)
+    : BPlusTree(OpenTag{}, std::move(name), header_page_id, buffer_pool_manager, comparator, leaf_max_size,
+                internal_max_size) {
+  WritePageGuard guard = bpm_->WritePage(header_page_id_);
+  auto root_page = guard.AsMut<BPlusTreeHeaderPage>();
+  root_page->root_page_id_ = INVALID_PAGE_ID;
+  root_page->magic_ = BPlusTreeHeaderPage::MAGIC;
+  root_page->leaf_max_size_ = leaf_max_size_;
+  root_page->internal_max_size_ = internal_max_size_;
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+BPLUSTREE_TYPE::BPlusTree(OpenTag /*tag*/, std::string name, page_id_t header_page_id,
+                          BufferPoolManager *buffer_pool_manager, const KeyComparator &comparator, int leaf_max_size,
+                          int internal_max_size)
     : index_name_(std::move(name)),
       bpm_(buffer_pool_manager),
       comparator_(std::move(comparator)),
       leaf_max_size_(leaf_max_size),
       internal_max_size_(internal_max_size),
-      header_page_id_(header_page_id) {
-  WritePageGuard guard = bpm_->WritePage(header_page_id_);
-  auto root_page = guard.AsMut<BPlusTreeHeaderPage>();
-  root_page->root_page_id_ = INVALID_PAGE_ID;
+      header_page_id_(header_page_id),
+      leaf_group_(bpm_->NewAllocationGroup()),
+      internal_group_(bpm_->NewAllocationGroup()) {}
+
+INDEX_TEMPLATE_ARGUMENTS
+auto BPLUSTREE_TYPE::Open(std::string name, page_id_t header_page_id, BufferPoolManager *buffer_pool_manager,
+                          const KeyComparator &comparator) -> BPlusTree {
+  int leaf_max_size;
+  int internal_max_size;
+  {
+    ReadPageGuard guard = buffer_pool_manager->ReadPage(header_page_id);
+    auto header = guard.As<BPlusTreeHeaderPage>();
+    leaf_max_size = header->leaf_max_size_;
+    internal_max_size = header->internal_max_size_;
+    if (header->magic_ != BPlusTreeHeaderPage::MAGIC || leaf_max_size <= 0 ||
+        leaf_max_size > static_cast<int>(LEAF_PAGE_SLOT_CNT) || internal_max_size <= 0 ||
+        internal_max_size > static_cast<int>(INTERNAL_PAGE_SLOT_CNT)) {
+      throw std::runtime_error("page " + std::to_string(header_page_id) + " is not a B+ tree header");
+    }
+  }
+  return BPlusTree(OpenTag{}, std::move(name), header_page_id, buffer_pool_manager, comparator, leaf_max_size,
+                   internal_max_size);
 }
 
 INDEX_TEMPLATE_ARGUMENTS
 auto BPLUSTREE_TYPE::IsEmpty() const -> bool {
-  WritePageGuard guard = bpm_->WritePage(header_page_id_);
-  auto root_page = guard.AsMut<BPlusTreeHeaderPage>();
-  return root_page->root_page_id_ == INVALID_PAGE_ID;
+  ReadPageGuard guard = bpm_->ReadPage(header_page_id_);
+  return guard.As<BPlusTreeHeaderPage>()->root_page_id_ == INVALID_PAGE_ID;
 }
 
 /*****************************************************************************
@@ -38,13 +76,10 @@ INDEX_TEMPLATE_ARGUMENTS
 auto BPLUSTREE_TYPE::GetValue(const KeyType &key, std::vector<ValueType> *result) -> bool {
   // Declaration of context instance. Using the Context is not necessary but advised.
   Context ctx;
-  WritePageGuard header_page = bpm_->WritePage(header_page_id_);
-  ctx.root_page_id_ = header_page.As<BPlusTreeHeaderPage>()->root_page_id_;
-  ctx.header_page_ = std::move(header_page);
-  if(ctx.root_page_id_ == INVALID_PAGE_ID) {
+  FindLeafPage(key, &ctx);
+  if(ctx.read_set_.empty()) {
     return false;
   }
-  FindLeafPage(key, &ctx);
   const LeafPage *leaf_page = ctx.read_set_.back().As<LeafPage>();
   int index = leaf_page->KeyIndex(key, comparator_);
   if(index < leaf_page->GetSize() && comparator_(leaf_page->KeyAt(index), key) == 0) {
@@ -53,23 +88,392 @@ auto BPLUSTREE_TYPE::GetValue(const KeyType &key, std::vector<ValueType> *result
     ctx.read_set_.pop_back();
     return true;
   }
-  ctx.header_page_ = std::nullopt;
   ctx.read_set_.clear();
   return false;
 }
 
+INDEX_TEMPLATE_ARGUMENTS
+auto BPLUSTREE_TYPE::GetValues(std::span<const KeyType> keys, std::vector<std::optional<ValueType>> *results)
+    -> size_t {
+  results->assign(keys.size(), std::nullopt);
+  std::vector<size_t> order(keys.size());
+  std::iota(order.begin(), order.end(), 0);
+  auto less = [&](size_t a, size_t b) { return comparator_(keys[a], keys[b]) < 0; };
+  if(!std::is_sorted(order.begin(), order.end(), less)) {
+    std::sort(order.begin(), order.end(), less);
+  }
+
+  // a latched node of the current path; fence is the first key right of its subtree (none on
+  // the right edge) and prefetched_to the probe up to which its children were prefetched
+  struct PathNode {
+    ReadPageGuard guard;
+    std::optional<KeyType> fence;
+    size_t prefetched_to;
+  };
+  std::vector<PathNode> path;
+  size_t next = 0;
+  size_t found = 0;
+  int leaves = 0;
+  // starts the reads of the next children of node that later probes go to, so they overlap
+  // with the work in the current subtree
+  auto prefetch_ahead = [&](PathNode &node, page_id_t current_child) {
+    const ReadPageGuard &guard = node.guard;
+    const InternalPage *inner = guard.As<InternalPage>();
+    page_id_t last = current_child;
+    int issued = 0;
+    size_t pos = std::max(node.prefetched_to, next);
+    for(; pos < order.size() && issued < PREFETCH_CHILDREN; pos++) {
+      const KeyType &probe = keys[order[pos]];
+      if(node.fence.has_value() && comparator_(probe, *node.fence) >= 0) {
+        break;
+      }
+      // probes are sorted, so a new child id is one not seen yet
+      page_id_t child = inner->ValueAt(ChildIndex(inner, probe));
+      if(child != last) {
+        bpm_->Prefetch(child);
+        last = child;
+        issued++;
+      }
+    }
+    node.prefetched_to = pos;
+  };
+
+  while(next < order.size()) {
+    const KeyType &key = keys[order[next]];
+    // climb to the lowest node that still covers key
+    while(!path.empty() && path.back().fence.has_value() && comparator_(key, *path.back().fence) >= 0) {
+      path.pop_back();
+    }
+    if(path.empty() || leaves == PATH_HOLD_LEAVES) {
+      path.clear();
+      leaves = 0;
+      ReadPageGuard header_page = bpm_->ReadPage(header_page_id_);
+      page_id_t root_page_id = header_page.As<BPlusTreeHeaderPage>()->root_page_id_;
+      if(root_page_id == INVALID_PAGE_ID) {
+        return found;
+      }
+      path.push_back({bpm_->ReadPage(root_page_id), std::nullopt, 0});
+    }
+    while(true) {
+      PathNode &node = path.back();
+      const ReadPageGuard &guard = node.guard;
+      if(guard.As<BPlusTreePage>()->IsLeafPage()) {
+        break;
+      }
+      const InternalPage *inner = guard.As<InternalPage>();
+      int child_index = ChildIndex(inner, key);
+      page_id_t child = inner->ValueAt(child_index);
+      std::optional<KeyType> fence = child_index + 1 < inner->GetSize() ? std::optional<KeyType>(inner->KeyAt(child_index + 1))
+                                                                         : node.fence;
+      prefetch_ahead(node, child);
+      ReadPageGuard child_guard = bpm_->ReadPage(child);
+      path.push_back({std::move(child_guard), fence, 0});
+    }
+    // answer every probe below the leaf's fence while it is pinned
+    const ReadPageGuard &leaf_page_guard = path.back().guard;
+    const LeafPage *leaf_page = leaf_page_guard.As<LeafPage>();
+    const std::optional<KeyType> &fence = path.back().fence;
+    do {
+      const KeyType &probe = keys[order[next]];
+      int index = leaf_page->KeyIndex(probe, comparator_);
+      if(index < leaf_page->GetSize() && comparator_(leaf_page->KeyAt(index), probe) == 0) {
+        (*results)[order[next]] = leaf_page->rid_array_[index];
+        found++;
+      }
+      next++;
+    } while(next < order.size() && (!fence.has_value() || comparator_(keys[order[next]], *fence) < 0));
+    path.pop_back();
+    leaves++;
+  }
+  return found;
+}
+
+/*****************************************************************************
+ * BULK LOAD
+ *****************************************************************************/
+namespace {
+// runs fn(0) .. fn(count - 1) on threads of their own, the last on the calling thread, and
+// rethrows the first exception once all of them are done
+template <typename Fn>
+void RunParallel(size_t count, const Fn &fn) {
+  std::vector<std::exception_ptr> errors(count);
+  auto guarded = [&](size_t i) {
+    try {
+      fn(i);
+    } catch (...) {
+      errors[i] = std::current_exception();
+    }
+  };
+  std::vector<std::thread> workers;
+  for (size_t i = 0; i + 1 < count; i++) {
+    workers.emplace_back(guarded, i);
+  }
+  if (count > 0) {
+    guarded(count - 1);
+  }
+  for (auto &worker : workers) {
+    worker.join();
+  }
+  for (auto &error : errors) {
+    if (error) {
+      std::rethrow_exception(error);
+    }
+  }
+}
+
+// first element of part i when n elements are split into parts even parts
+auto PartBegin(size_t n, size_t parts, size_t i) -> size_t { return n / parts * i + std::min(i, n % parts); }
+
+// Stable LSD radix sort on the key, one byte per pass. Every thread histograms and then
+// scatters its own slice; a pass whose digit is the same for all keys is skipped.
+template <typename ValueType>
+void RadixSortByKey(std::vector<std::pair<IntegerKey, ValueType>> *entries, size_t num_threads) {
+  using Entry = std::pair<IntegerKey, ValueType>;
+  constexpr size_t RADIX = 256;
+  size_t n = entries->size();
+  size_t parts = std::max<size_t>(1, std::min(num_threads, n / 4096));
+  std::vector<Entry> buffer(n);
+  Entry *src = entries->data();
+  Entry *dst = buffer.data();
+  std::vector<std::array<size_t, RADIX>> offsets(parts);
+  auto digit = [](const Entry &entry, int shift) {
+    // flipping the sign bit orders negative keys first
+    return ((static_cast<uint32_t>(entry.first.GetValue()) ^ 0x80000000U) >> shift) & (RADIX - 1);
+  };
+  for (int shift = 0; shift < 32; shift += 8) {
+    RunParallel(parts, [&](size_t part) {
+      offsets[part].fill(0);
+      for (size_t i = PartBegin(n, parts, part); i < PartBegin(n, parts, part + 1); i++) {
+        offsets[part][digit(src[i], shift)]++;
+      }
+    });
+    bool single_digit = false;
+    size_t position = 0;
+    for (size_t d = 0; d < RADIX; d++) {
+      size_t total = 0;
+      for (size_t part = 0; part < parts; part++) {
+        size_t count = offsets[part][d];
+        offsets[part][d] = position + total;
+        total += count;
+      }
+      single_digit = single_digit || total == n;
+      position += total;
+    }
+    if (single_digit) {
+      continue;
+    }
+    RunParallel(parts, [&](size_t part) {
+      for (size_t i = PartBegin(n, parts, part); i < PartBegin(n, parts, part + 1); i++) {
+        dst[offsets[part][digit(src[i], shift)]++] = src[i];
+      }
+    });
+    std::swap(src, dst);
+  }
+  if (src != entries->data()) {
+    std::copy(src, src + n, entries->data());
+  }
+}
+}  // namespace
+
+INDEX_TEMPLATE_ARGUMENTS
+void BPLUSTREE_TYPE::BulkLoad(std::span<const std::pair<KeyType, ValueType>> entries, double fill_factor) {
+  if(!(fill_factor > 0.0 && fill_factor <= 1.0)) {
+    throw std::invalid_argument("fill factor must be in (0, 1]");
+  }
+  for(size_t i=1; i<entries.size(); i++) {
+    if(comparator_(entries[i-1].first, entries[i].first) >= 0) {
+      throw std::runtime_error("bulk load input is not in strictly ascending key order");
+    }
+  }
+  // held for the whole load: writers wait, and nobody can see the tree half built
+  WritePageGuard header = bpm_->WritePage(header_page_id_);
+  if(header.As<BPlusTreeHeaderPage>()->root_page_id_ != INVALID_PAGE_ID) {
+    throw std::runtime_error("bulk load into a non-empty tree");
+  }
+  if(entries.empty()) {
+    return;
+  }
+  int leaf_min = std::max((leaf_max_size_ + 1) / 2, 1);
+  size_t pages = PackedPageCount(entries.size(), FillTarget(leaf_max_size_, leaf_min, fill_factor), leaf_min,
+                                 leaf_max_size_);
+  auto level = WriteLeafRun(entries, pages, 0, pages, leaf_group_);
+  header.AsMut<BPlusTreeHeaderPage>()->root_page_id_ = BuildInnerLevels(std::move(level), fill_factor);
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+void BPLUSTREE_TYPE::BulkLoadUnsorted(std::vector<std::pair<KeyType, ValueType>> entries, size_t num_threads,
+                                      double fill_factor) {
+  if(!(fill_factor > 0.0 && fill_factor <= 1.0)) {
+    throw std::invalid_argument("fill factor must be in (0, 1]");
+  }
+  if(num_threads == 0) {
+    num_threads = std::max(1U, std::thread::hardware_concurrency());
+  }
+  SortEntries(&entries, num_threads);
+  for(size_t i=1; i<entries.size(); i++) {
+    if(comparator_(entries[i-1].first, entries[i].first) == 0) {
+      throw std::runtime_error("bulk load input has duplicate keys");
+    }
+  }
+  WritePageGuard header = bpm_->WritePage(header_page_id_);
+  if(header.As<BPlusTreeHeaderPage>()->root_page_id_ != INVALID_PAGE_ID) {
+    throw std::runtime_error("bulk load into a non-empty tree");
+  }
+  if(entries.empty()) {
+    return;
+  }
+  int leaf_min = std::max((leaf_max_size_ + 1) / 2, 1);
+  size_t pages = PackedPageCount(entries.size(), FillTarget(leaf_max_size_, leaf_min, fill_factor), leaf_min,
+                                 leaf_max_size_);
+  // one run of consecutive leaves per thread, each from its own allocation group so every
+  // run is sequential on disk
+  size_t runs = std::min(num_threads, pages);
+  std::vector<AllocationGroup> groups;
+  groups.push_back(leaf_group_);
+  while(groups.size() < runs) {
+    groups.push_back(bpm_->NewAllocationGroup());
+  }
+  std::vector<std::vector<std::pair<KeyType, page_id_t>>> run_levels(runs);
+  RunParallel(runs, [&](size_t run) {
+    run_levels[run] = WriteLeafRun(entries, pages, PartBegin(pages, runs, run), PartBegin(pages, runs, run + 1),
+                                   groups[run]);
+  });
+  // stitch the runs into one leaf chain
+  std::vector<std::pair<KeyType, page_id_t>> level;
+  level.reserve(pages);
+  for(size_t run=0; run<runs; run++) {
+    if(run > 0) {
+      WritePageGuard last_leaf = bpm_->WritePage(level.back().second);
+      last_leaf.AsMut<LeafPage>()->SetNextPageId(run_levels[run].front().second);
+      WritePageGuard first_leaf = bpm_->WritePage(run_levels[run].front().second);
+      first_leaf.AsMut<LeafPage>()->SetPrevPageId(level.back().second);
+    }
+    level.insert(level.end(), run_levels[run].begin(), run_levels[run].end());
+  }
+  header.AsMut<BPlusTreeHeaderPage>()->root_page_id_ = BuildInnerLevels(std::move(level), fill_factor);
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+void BPLUSTREE_TYPE::SortEntries(std::vector<std::pair<KeyType, ValueType>> *entries, size_t num_threads) const {
+  if constexpr (std::is_same_v<KeyType, IntegerKey>) {
+    RadixSortByKey(entries, num_threads);
+  } else {
+    // sort even slices in parallel, then merge neighbouring runs pairwise, in parallel too
+    auto less = [this](const auto &a, const auto &b) { return comparator_(a.first, b.first) < 0; };
+    size_t n = entries->size();
+    size_t parts = std::max<size_t>(1, std::min(num_threads, n / 4096));
+    auto at = [&](size_t part) { return entries->begin() + PartBegin(n, parts, std::min(part, parts)); };
+    RunParallel(parts, [&](size_t part) { std::sort(at(part), at(part + 1), less); });
+    for(size_t width=1; width<parts; width*=2) {
+      RunParallel((parts + 2 * width - 1) / (2 * width), [&](size_t pair) {
+        size_t left = pair * 2 * width;
+        std::inplace_merge(at(left), at(left + width), at(left + 2 * width), less);
+      });
+    }
+  }
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+auto BPLUSTREE_TYPE::WriteLeafRun(std::span<const std::pair<KeyType, ValueType>> entries, size_t pages,
+                                  size_t first_page, size_t last_page, AllocationGroup group)
+    -> std::vector<std::pair<KeyType, page_id_t>> {
+  // leaves in key order; each one is linked once its successor exists
+  std::vector<std::pair<KeyType, page_id_t>> level;
+  std::optional<WritePageGuard> prev_leaf = std::nullopt;
+  for(size_t i=first_page; i<last_page; i++) {
+    size_t begin = PartBegin(entries.size(), pages, i);
+    size_t size = PartBegin(entries.size(), pages, i + 1) - begin;
+    page_id_t page_id = bpm_->NewPage(group);
+    WritePageGuard guard = bpm_->WritePage(page_id);
+    LeafPage *leaf_page = guard.AsMut<LeafPage>();
+    leaf_page->Init(leaf_max_size_);
+    for(size_t j=0; j<size; j++) {
+      leaf_page->key_array_[j] = entries[begin + j].first;
+      leaf_page->rid_array_[j] = entries[begin + j].second;
+    }
+    leaf_page->ChangeSizeBy(static_cast<int>(size));
+    level.emplace_back(leaf_page->KeyAt(0), page_id);
+    if(prev_leaf.has_value()) {
+      prev_leaf->AsMut<LeafPage>()->SetNextPageId(page_id);
+      leaf_page->SetPrevPageId(prev_leaf->GetPageId());
+    }
+    prev_leaf = std::move(guard);
+  }
+  return level;
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+auto BPLUSTREE_TYPE::BuildInnerLevels(std::vector<std::pair<KeyType, page_id_t>> level, double fill_factor)
+    -> page_id_t {
+  // an inner page takes its children's first keys as separators
+  int internal_min = std::max((internal_max_size_ + 1) / 2, 2);
+  int target = FillTarget(internal_max_size_, internal_min, fill_factor);
+  while(level.size() > 1) {
+    std::vector<std::pair<KeyType, page_id_t>> upper;
+    size_t pages = PackedPageCount(level.size(), target, internal_min, internal_max_size_);
+    for(size_t i=0; i<pages; i++) {
+      size_t begin = PartBegin(level.size(), pages, i);
+      size_t size = PartBegin(level.size(), pages, i + 1) - begin;
+      page_id_t page_id = bpm_->NewPage(internal_group_);
+      WritePageGuard guard = bpm_->WritePage(page_id);
+      InternalPage *internal_page = guard.AsMut<InternalPage>();
+      internal_page->Init(internal_max_size_);
+      upper.emplace_back(level[begin].first, page_id);
+      for(size_t j=0; j<size; j++) {
+        if(j > 0) internal_page->key_array_[j] = level[begin + j].first;
+        internal_page->page_id_array_[j] = level[begin + j].second;
+      }
+      internal_page->ChangeSizeBy(static_cast<int>(size));
+    }
+    level = std::move(upper);
+  }
+  return level.front().second;
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+auto BPLUSTREE_TYPE::FillTarget(int max_size, int min_size, double fill_factor) -> int {
+  return std::clamp(static_cast<int>(max_size * fill_factor + 0.5), min_size, max_size);
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+auto BPLUSTREE_TYPE::PackedPageCount(size_t count, int target, int min_size, int max_size) -> size_t {
+  size_t pages = (count + target - 1) / target;
+  // fewer, fuller pages while the even share would fall below the minimum
+  while(pages > 1 && count / pages < static_cast<size_t>(min_size) &&
+        (count + pages - 2) / (pages - 1) <= static_cast<size_t>(max_size)) {
+    pages--;
+  }
+  return pages;
+}
+
 /*****************************************************************************
  * INSERTION
  *****************************************************************************/
 INDEX_TEMPLATE_ARGUMENTS
 auto BPLUSTREE_TYPE::Insert(const KeyType &key, const ValueType &value) -> bool {
   //UNIMPLEMENTED("TODO(P2): Add implementation.");
+  // with a log manager, the insert and all splits it causes reach the log as one record;
+  // declared before ctx so it ends after every guard was dropped into it
+  auto atomic_write = bpm_->BeginAtomic();
+  // optimistic pass: most inserts only change their leaf
+  if (std::optional<WritePageGuard> leaf_guard = FindLeafOptimistic(key); leaf_guard.has_value()) {
+    const LeafPage *leaf = leaf_guard->As<LeafPage>();
+    int index = leaf->KeyIndex(key, comparator_);
+    if (index < leaf->GetSize() && comparator_(leaf->KeyAt(index), key) == 0) {
+      return false;
+    }
+    if (IsSafe(leaf, Operation::INSERT)) {
+      InsertIntoLeaf(leaf_guard->AsMut<LeafPage>(), index, key, value);
+      return true;
+    }
+  }
+  // the leaf may split: restart with write latches from the header down
   // Declaration of context instance. Using the Context is not necessary but advised.
   Context ctx;
   ctx.header_page_ = bpm_->WritePage(header_page_id_);
   ctx.root_page_id_ = ctx.header_page_->As<BPlusTreeHeaderPage>()->root_page_id_;
   if(IsEmpty(ctx)){
-    auto new_root_page_id = bpm_->NewPage();
+    auto new_root_page_id = bpm_->NewPage(leaf_group_);
     ctx.root_page_id_ = new_root_page_id;
     ctx.header_page_->AsMut<BPlusTreeHeaderPage>()->root_page_id_ = new_root_page_id;
     auto new_root_page_guard = bpm_->WritePage(new_root_page_id);
@@ -81,7 +485,7 @@ auto BPLUSTREE_TYPE::Insert(const KeyType &key, const ValueType &value) -> bool
     return true;
   }
 
-  FindAndLock(key, &ctx);
+  FindAndLock(key, &ctx, Operation::INSERT);
   auto leaf_page_guard = std::move(ctx.write_set_.back());
   ctx.write_set_.pop_back();
   LeafPage *leaf_page = leaf_page_guard.AsMut<LeafPage>();
@@ -102,7 +506,7 @@ auto BPLUSTREE_TYPE::Insert(const KeyType &key, const ValueType &value) -> bool
   page_id_t l_child_page_id = leaf_page_guard.GetPageId();
   // split leaf before insert
   if(leaf_page->GetSize() >= leaf_page->GetMaxSize()){
-    auto new_leaf_page_id = bpm_->NewPage();
+    auto new_leaf_page_id = bpm_->NewPage(leaf_page_guard.GetPageId());
     auto new_leaf_page_guard = bpm_->WritePage(new_leaf_page_id);
     LeafPage* new_leaf_page = new_leaf_page_guard.AsMut<LeafPage>();
     new_leaf_page->Init(leaf_max_size_);
@@ -117,7 +521,13 @@ auto BPLUSTREE_TYPE::Insert(const KeyType &key, const ValueType &value) -> bool
     }
     leaf_page->ChangeSizeBy(-i);
     new_leaf_page->SetNextPageId(leaf_page->GetNextPageId());
+    new_leaf_page->SetPrevPageId(leaf_page_guard.GetPageId());
     leaf_page->SetNextPageId(new_leaf_page_id);
+    if(new_leaf_page->GetNextPageId() != INVALID_PAGE_ID) {
+      // right of both split halves, so latching it keeps the left-to-right order
+      WritePageGuard next_leaf_guard = bpm_->WritePage(new_leaf_page->GetNextPageId());
+      next_leaf_guard.AsMut<LeafPage>()->SetPrevPageId(new_leaf_page_id);
+    }
 
     if(index >= leaf_page->GetMinSize()){
       index -= leaf_page->GetMinSize();
@@ -131,13 +541,7 @@ auto BPLUSTREE_TYPE::Insert(const KeyType &key, const ValueType &value) -> bool
   }
 
   // insert key & value into leaf page
-  for(int i=leaf_page->GetSize(); i>index; i--){
-    leaf_page->key_array_[i] = leaf_page->key_array_[i-1];
-    leaf_page->rid_array_[i] = leaf_page->rid_array_[i-1];
-  }
-  leaf_page->key_array_[index] = key;
-  leaf_page->rid_array_[index] = value;
-  leaf_page->ChangeSizeBy(1);
+  InsertIntoLeaf(leaf_page, index, key, value);
 
   if(leaf_page_guard.GetPageId() == new_child_id) {
     // the first key of leaf page changed after insert
@@ -149,7 +553,7 @@ auto BPLUSTREE_TYPE::Insert(const KeyType &key, const ValueType &value) -> bool
 
     // create a new root if need
     if(!parent.has_value()){
-      auto new_root_page_id = bpm_->NewPage();
+      auto new_root_page_id = bpm_->NewPage(internal_group_);
       ctx.root_page_id_ = new_root_page_id;
       ctx.header_page_->AsMut<BPlusTreeHeaderPage>()->root_page_id_ = new_root_page_id;
       auto new_root_page_guard = bpm_->WritePage(new_root_page_id);
@@ -165,7 +569,7 @@ auto BPLUSTREE_TYPE::Insert(const KeyType &key, const ValueType &value) -> bool
     int key_insert_index = parent_page->KeyIndex(up_key.value(), comparator_);
     // split internal if need (and insert)
     if(parent_page->GetSize() >= parent_page->GetMaxSize()){
-      auto new_internal_page_id = bpm_->NewPage();
+      auto new_internal_page_id = bpm_->NewPage(parent.value().GetPageId());
       auto new_internal_page_guard = bpm_->WritePage(new_internal_page_id);
       InternalPage* new_internal_page = new_internal_page_guard.AsMut<InternalPage>();
       // Initialize the newly created internal page before using it
@@ -294,7 +698,7 @@ auto BPLUSTREE_TYPE::Insert(const KeyType &key, const ValueType &value) -> bool
 
     // create a new root if need
     if(!parent.has_value()){
-      auto new_root_page_id = bpm_->NewPage();
+      auto new_root_page_id = bpm_->NewPage(internal_group_);
       ctx.root_page_id_ = new_root_page_id;
       ctx.header_page_->AsMut<BPlusTreeHeaderPage>()->root_page_id_ = new_root_page_id;
       auto new_root_page_guard = bpm_->WritePage(new_root_page_id);
@@ -311,7 +715,7 @@ auto BPLUSTREE_TYPE::Insert(const KeyType &key, const ValueType &value) -> bool
 
     // split internal if need (and insert)
     if(parent_page->GetSize() >= parent_page->GetMaxSize()){
-      auto new_internal_page_id = bpm_->NewPage();
+      auto new_internal_page_id = bpm_->NewPage(parent.value().GetPageId());
       auto new_internal_page_guard = bpm_->WritePage(new_internal_page_id);
       InternalPage* new_internal_page = new_internal_page_guard.AsMut<InternalPage>();
       // Initialize the newly created internal page before using it
@@ -435,6 +839,22 @@ auto BPLUSTREE_TYPE::Insert(const KeyType &key, const ValueType &value) -> bool
  *****************************************************************************/
 INDEX_TEMPLATE_ARGUMENTS
 void BPLUSTREE_TYPE::Remove(const KeyType &key) {
+  // the removal and its merges/redistributions are logged atomically, as in Insert
+  auto atomic_write = bpm_->BeginAtomic();
+  // optimistic pass: done in the leaf unless it underflows
+  if (std::optional<WritePageGuard> leaf_guard = FindLeafOptimistic(key); leaf_guard.has_value()) {
+    const LeafPage *leaf = leaf_guard->As<LeafPage>();
+    int index = leaf->KeyIndex(key, comparator_);
+    if (index >= leaf->GetSize() || comparator_(leaf->KeyAt(index), key) != 0) {
+      return;
+    }
+    if (IsSafe(leaf, Operation::REMOVE)) {
+      RemoveFromLeaf(leaf_guard->AsMut<LeafPage>(), index);
+      return;
+    }
+  } else {
+    return;
+  }
   // Declaration of context instance.
   Context ctx;
   ctx.header_page_ = bpm_->WritePage(header_page_id_);
@@ -443,23 +863,34 @@ void BPLUSTREE_TYPE::Remove(const KeyType &key) {
 
   // search and check key existence
   // cache the parent's pointer may boost the performance of deletion
-  FindAndLock(key, &ctx);
-  LeafPage *leaf_page = ctx.write_set_.back().AsMut<LeafPage>();
-  int index = leaf_page->KeyIndex(key, comparator_);
-  if(index >= leaf_page->GetSize() || comparator_(leaf_page->KeyAt(index), key) != 0) {
+  FindAndLock(key, &ctx, Operation::REMOVE);
+  const LeafPage *found_leaf = ctx.write_set_.back().As<LeafPage>();
+  int index = found_leaf->KeyIndex(key, comparator_);
+  if(index >= found_leaf->GetSize() || comparator_(found_leaf->KeyAt(index), key) != 0) {
     while(!ctx.write_set_.empty())
       ctx.write_set_.pop_front();
     return; 
   }
 
-  // delete key & value in leaf page
-  for(int i=index; i<leaf_page->GetSize()-1; i++){
-    leaf_page->key_array_[i] = leaf_page->key_array_[i+1];
-    leaf_page->rid_array_[i] = leaf_page->rid_array_[i+1];
+  // An underflowing leaf borrows from or merges with its left sibling. Leaves are latched
+  // left to right, the direction iterators and scans move in, so the leaf is let go and
+  // latched again after the sibling; meanwhile the parent's write latch keeps every writer
+  // away from it.
+  std::optional<WritePageGuard> l_leaf_guard = std::nullopt;
+  if(found_leaf->GetSize() - 1 < found_leaf->GetMinSize() && ctx.write_set_.size() >= 2) {
+    const InternalPage *leaf_parent = ctx.write_set_[ctx.write_set_.size() - 2].As<InternalPage>();
+    int child_index = ChildIndex(leaf_parent, key);
+    if(child_index > 0) {
+      page_id_t leaf_page_id = ctx.write_set_.back().GetPageId();
+      ctx.write_set_.pop_back();
+      l_leaf_guard = bpm_->WritePage(leaf_parent->ValueAt(child_index - 1));
+      ctx.write_set_.push_back(bpm_->WritePage(leaf_page_id));
+    }
   }
-  leaf_page->key_array_[leaf_page->GetSize()-1] = KeyType{};
-  leaf_page->rid_array_[leaf_page->GetSize()-1] = RID{};
-  leaf_page->ChangeSizeBy(-1);
+
+  // delete key & value in leaf page
+  LeafPage *leaf_page = ctx.write_set_.back().AsMut<LeafPage>();
+  RemoveFromLeaf(leaf_page, index);
 
   //check underflow
   if(leaf_page->GetSize() >= leaf_page->GetMinSize()){
@@ -500,9 +931,8 @@ void BPLUSTREE_TYPE::Remove(const KeyType &key) {
   // try redistribute
   // left
   if(l_parent_index >= 0){
-    page_id_t l_page_id = parent_page->ValueAt(l_parent_index);
-    auto l_page_guard = bpm_->WritePage(l_page_id);
-    LeafPage *l_page = l_page_guard.AsMut<LeafPage>();
+    BUSTUB_ASSERT(l_leaf_guard.has_value(), "left sibling not latched");
+    LeafPage *l_page = l_leaf_guard->AsMut<LeafPage>();
     if(l_page->GetSize() > l_page->GetMinSize()){
       // redistribute from left
       for(int i=leaf_page->GetSize(); i>0; i--){
@@ -554,7 +984,7 @@ void BPLUSTREE_TYPE::Remove(const KeyType &key) {
       m_l_page = parent_page->ValueAt(l_parent_index);
       m_r_page = parent_page->ValueAt(parent_index);
       m_r_page_guard = std::move(leaf_page_guard);
-      m_l_page_guard = bpm_->WritePage(m_l_page);
+      m_l_page_guard = std::move(l_leaf_guard);
     }
     else{
       BUSTUB_ASSERT(r_parent_index != INVALID_PAGE_ID, "internal error");
@@ -577,6 +1007,10 @@ void BPLUSTREE_TYPE::Remove(const KeyType &key) {
     }
     r_page->ChangeSizeBy(-j);
     l_page->SetNextPageId(r_page->GetNextPageId());
+    if(l_page->GetNextPageId() != INVALID_PAGE_ID) {
+      WritePageGuard next_leaf_guard = bpm_->WritePage(l_page->GetNextPageId());
+      next_leaf_guard.AsMut<LeafPage>()->SetPrevPageId(m_l_page);
+    }
     // delete parent key & value
     old_key = parent_page->key_array_[parent_index];
     for(int i=parent_index; i<parent_page->GetSize()-1; i++){
@@ -797,51 +1231,242 @@ auto BPLUSTREE_TYPE::Redistribute(InternalPage *parent_page, InternalPage *child
   return false;
 }
 
+/*****************************************************************************
+ * RANGE SCAN
+ *****************************************************************************/
+INDEX_TEMPLATE_ARGUMENTS
+auto BPLUSTREE_TYPE::ScanRange(const KeyType &lo, const KeyType &hi,
+                               const std::function<bool(std::span<const KeyType>, std::span<const ValueType>)> &visit,
+                               ScanOrder order) -> size_t {
+  if(order == ScanOrder::DESCENDING) {
+    return ScanDescending(lo, hi, visit);
+  }
+  Context ctx;
+  FindLeafPage(lo, &ctx);
+  if(ctx.read_set_.empty() || comparator_(lo, hi) > 0) {
+    return 0;
+  }
+  ReadPageGuard leaf_page_guard = std::move(ctx.read_set_.back());
+  ctx.read_set_.pop_back();
+  int begin = leaf_page_guard.As<LeafPage>()->KeyIndex(lo, comparator_);
+  size_t visited = 0;
+  while(true) {
+    const LeafPage *leaf_page = leaf_page_guard.As<LeafPage>();
+    int size = leaf_page->GetSize();
+    // first index past hi
+    int end = leaf_page->KeyIndex(hi, comparator_);
+    if(end < size && comparator_(leaf_page->KeyAt(end), hi) == 0) {
+      end++;
+    }
+    page_id_t next_page_id = end == size ? leaf_page->GetNextPageId() : INVALID_PAGE_ID;
+    if(next_page_id != INVALID_PAGE_ID) {
+      bpm_->Prefetch(next_page_id);
+    }
+    if(begin < end) {
+      visited += end - begin;
+      if(!visit(std::span<const KeyType>(leaf_page->key_array_ + begin, end - begin),
+                std::span<const ValueType>(leaf_page->rid_array_ + begin, end - begin))) {
+        break;
+      }
+    }
+    if(next_page_id == INVALID_PAGE_ID) {
+      break;
+    }
+    // the batch is consumed: latch the successor, then let go of this leaf
+    ReadPageGuard next_page_guard = bpm_->ReadPage(next_page_id);
+    leaf_page_guard = std::move(next_page_guard);
+    begin = 0;
+  }
+  return visited;
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+auto BPLUSTREE_TYPE::ScanRange(const KeyType &lo, const KeyType &hi, std::vector<std::pair<KeyType, ValueType>> *out,
+                               ScanOrder order) -> size_t {
+  return ScanRange(lo, hi, [out, order](std::span<const KeyType> keys, std::span<const ValueType> values) {
+    for(size_t i=0; i<keys.size(); i++) {
+      size_t at = order == ScanOrder::ASCENDING ? i : keys.size() - 1 - i;
+      out->emplace_back(keys[at], values[at]);
+    }
+    return true;
+  }, order);
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+auto BPLUSTREE_TYPE::ScanDescending(const KeyType &lo, const KeyType &hi,
+                                    const std::function<bool(std::span<const KeyType>, std::span<const ValueType>)> &visit)
+    -> size_t {
+  Context ctx;
+  FindLeafPage(hi, &ctx);
+  if(ctx.read_set_.empty() || comparator_(lo, hi) > 0) {
+    return 0;
+  }
+  ReadPageGuard leaf_page_guard = std::move(ctx.read_set_.back());
+  ctx.read_set_.pop_back();
+  // entries from end on are done (or above hi)
+  int end = std::numeric_limits<int>::max();
+  size_t visited = 0;
+  while(true) {
+    const LeafPage *leaf_page = leaf_page_guard.As<LeafPage>();
+    int size = leaf_page->GetSize();
+    if(size == 0) {
+      break;
+    }
+    // first index past hi
+    int hi_end = leaf_page->KeyIndex(hi, comparator_);
+    if(hi_end < size && comparator_(leaf_page->KeyAt(hi_end), hi) == 0) {
+      hi_end++;
+    }
+    end = std::min(end, hi_end);
+    int begin = leaf_page->KeyIndex(lo, comparator_);
+    page_id_t prev_page_id = begin == 0 ? leaf_page->GetPrevPageId() : INVALID_PAGE_ID;
+    if(prev_page_id != INVALID_PAGE_ID) {
+      bpm_->Prefetch(prev_page_id);
+    }
+    if(begin < end) {
+      visited += end - begin;
+      if(!visit(std::span<const KeyType>(leaf_page->key_array_ + begin, end - begin),
+                std::span<const ValueType>(leaf_page->rid_array_ + begin, end - begin))) {
+        break;
+      }
+    }
+    if(prev_page_id == INVALID_PAGE_ID) {
+      break;
+    }
+    KeyType bound = leaf_page->KeyAt(0);
+    auto left = StepLeft(std::move(leaf_page_guard), bound);
+    if(!left.has_value()) {
+      break;
+    }
+    leaf_page_guard = std::move(left->first);
+    end = left->second + 1;
+  }
+  return visited;
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+auto BPLUSTREE_TYPE::StepLeft(ReadPageGuard leaf_guard, const KeyType &bound) const
+    -> std::optional<std::pair<ReadPageGuard, int>> {
+  while(true) {
+    page_id_t page_id = leaf_guard.GetPageId();
+    page_id_t prev_page_id = leaf_guard.As<LeafPage>()->GetPrevPageId();
+    leaf_guard.Drop();
+    if(prev_page_id == INVALID_PAGE_ID) {
+      return std::nullopt;
+    }
+    {
+      ReadPageGuard prev_guard = bpm_->ReadPage(prev_page_id);
+      ReadPageGuard guard = bpm_->ReadPage(page_id);
+      const LeafPage *prev_leaf = prev_guard.As<LeafPage>();
+      const LeafPage *leaf = guard.As<LeafPage>();
+      if(prev_leaf->GetNextPageId() == page_id && leaf->GetPrevPageId() == prev_page_id) {
+        // still neighbours, but borrows may have moved entries across the boundary either way
+        int index = leaf->KeyIndex(bound, comparator_) - 1;
+        if(index >= 0) {
+          return std::make_pair(std::move(guard), index);
+        }
+        index = prev_leaf->KeyIndex(bound, comparator_) - 1;
+        if(index >= 0) {
+          return std::make_pair(std::move(prev_guard), index);
+        }
+        leaf_guard = std::move(prev_guard);
+        continue;
+      }
+    }
+    // the chain changed while nothing was latched: find bound's leaf again from the root
+    Context ctx;
+    FindLeafPage(bound, &ctx);
+    if(ctx.read_set_.empty()) {
+      return std::nullopt;
+    }
+    leaf_guard = std::move(ctx.read_set_.back());
+    int index = leaf_guard.As<LeafPage>()->KeyIndex(bound, comparator_) - 1;
+    if(index >= 0) {
+      return std::make_pair(std::move(leaf_guard), index);
+    }
+  }
+}
+
 /*****************************************************************************
  * INDEX ITERATOR
  *****************************************************************************/
 INDEX_TEMPLATE_ARGUMENTS
 auto BPLUSTREE_TYPE::Begin() -> INDEXITERATOR_TYPE {
   INDEXITERATOR_TYPE it;
-  if(IsEmpty()) return it;
-  auto header_page_guard = bpm_->WritePage(header_page_id_);
+  auto header_page_guard = bpm_->ReadPage(header_page_id_);
   page_id_t root_page_id = header_page_guard.As<BPlusTreeHeaderPage>()->root_page_id_;
+  if(root_page_id == INVALID_PAGE_ID) return it;
   auto current_page = bpm_->ReadPage(root_page_id);
+  header_page_guard.Drop();
   while(!current_page.As<BPlusTreePage>()->IsLeafPage()){
     auto child_page_id = current_page.As<InternalPage>()->ValueAt(0);
-    current_page = bpm_->ReadPage(child_page_id);
+    auto child_page = bpm_->ReadPage(child_page_id);
+    current_page = std::move(child_page);
   }
-  return INDEXITERATOR_TYPE(current_page.GetPageId(), 0, bpm_);
+  return MakeIterator(std::move(current_page), 0);
 }
 
 INDEX_TEMPLATE_ARGUMENTS
 auto BPLUSTREE_TYPE::Begin(const KeyType &key) -> INDEXITERATOR_TYPE {
   Context ctx;
-  ctx.header_page_ = bpm_->WritePage(header_page_id_);
-  ctx.root_page_id_ = ctx.header_page_->As<BPlusTreeHeaderPage>()->root_page_id_;
   FindLeafPage(key, &ctx);
+  if(ctx.read_set_.empty()) return INDEXITERATOR_TYPE();
   auto leaf_page_guard = std::move(ctx.read_set_.back());
   ctx.read_set_.pop_back();
-  INDEXITERATOR_TYPE it;
-  const LeafPage *leaf_page = leaf_page_guard.As<LeafPage>();
-  int index = leaf_page->KeyIndex(key, comparator_);
-  return INDEXITERATOR_TYPE(leaf_page_guard.GetPageId(), index, bpm_);
+  int index = leaf_page_guard.As<LeafPage>()->KeyIndex(key, comparator_);
+  return MakeIterator(std::move(leaf_page_guard), index);
 }
 
 INDEX_TEMPLATE_ARGUMENTS
 auto BPLUSTREE_TYPE::End() -> INDEXITERATOR_TYPE {
+  // iterators drop their latch at the end and then all compare equal, so the end needs no
+  // descent (which would wait for the header while the caller's iterator holds a leaf)
+  return INDEXITERATOR_TYPE();
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+auto BPLUSTREE_TYPE::RBegin() -> INDEXITERATOR_TYPE {
   INDEXITERATOR_TYPE it;
-  if(IsEmpty()) return it;
-  auto header_page_guard = bpm_->WritePage(header_page_id_);
+  auto header_page_guard = bpm_->ReadPage(header_page_id_);
   page_id_t root_page_id = header_page_guard.As<BPlusTreeHeaderPage>()->root_page_id_;
-  auto current_page_guard = bpm_->ReadPage(root_page_id);
-  while(!current_page_guard.As<BPlusTreePage>()->IsLeafPage()){
-    const InternalPage *current_page = current_page_guard.As<InternalPage>();
-    auto child_page_id = current_page->ValueAt(current_page->GetSize()-1);
-    current_page_guard = bpm_->ReadPage(child_page_id);
+  if(root_page_id == INVALID_PAGE_ID) return it;
+  auto current_page = bpm_->ReadPage(root_page_id);
+  header_page_guard.Drop();
+  while(!current_page.As<BPlusTreePage>()->IsLeafPage()){
+    const InternalPage *internal_page = current_page.As<InternalPage>();
+    auto child_page = bpm_->ReadPage(internal_page->ValueAt(internal_page->GetSize() - 1));
+    current_page = std::move(child_page);
+  }
+  int last = current_page.As<LeafPage>()->GetSize() - 1;
+  return MakeIterator(std::move(current_page), last);
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+auto BPLUSTREE_TYPE::RBegin(const KeyType &key) -> INDEXITERATOR_TYPE {
+  Context ctx;
+  FindLeafPage(key, &ctx);
+  if(ctx.read_set_.empty()) return INDEXITERATOR_TYPE();
+  auto leaf_page_guard = std::move(ctx.read_set_.back());
+  ctx.read_set_.pop_back();
+  const LeafPage *leaf_page = leaf_page_guard.As<LeafPage>();
+  int index = leaf_page->KeyIndex(key, comparator_);
+  if(index >= leaf_page->GetSize() || comparator_(leaf_page->KeyAt(index), key) != 0) {
+    // no exact match: the entry before the insertion point, possibly in the previous leaf
+    index--;
   }
-  return INDEXITERATOR_TYPE(current_page_guard.GetPageId(), current_page_guard.As<LeafPage>()->GetSize(), bpm_);
-  // return INDEXITERATOR_TYPE(bpm_, current_page_guard.GetPageId(), current_page_guard.As<LeafPage>()->GetSize());
+  return MakeIterator(std::move(leaf_page_guard), index);
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+auto BPLUSTREE_TYPE::REnd() -> INDEXITERATOR_TYPE {
+  return INDEXITERATOR_TYPE();
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+auto BPLUSTREE_TYPE::MakeIterator(ReadPageGuard guard, int index) const -> INDEXITERATOR_TYPE {
+  return INDEXITERATOR_TYPE(std::move(guard), index, bpm_, [this](ReadPageGuard leaf_guard, const KeyType &bound) {
+    return StepLeft(std::move(leaf_guard), bound);
+  });
 }
 
 /**
@@ -855,7 +1480,7 @@ auto BPLUSTREE_TYPE::GetRootPageId() -> page_id_t { return bpm_->ReadPage(header
 INDEX_TEMPLATE_ARGUMENTS
 auto BPLUSTREE_TYPE::DumpTree() const -> std::string {
   std::ostringstream out;
-  WritePageGuard header = bpm_->WritePage(header_page_id_);
+  ReadPageGuard header = bpm_->ReadPage(header_page_id_);
   page_id_t root_id = header.As<BPlusTreeHeaderPage>()->root_page_id_;
   if (root_id == INVALID_PAGE_ID) {
     out << index_name_ << " (empty)";
@@ -913,47 +1538,103 @@ void BPLUSTREE_TYPE::Print(std::ostream &os) const {
 
 INDEX_TEMPLATE_ARGUMENTS
 auto BPLUSTREE_TYPE::FindLeafPage(const KeyType &key, Context *ctx) const -> void {
+  auto header_page = bpm_->ReadPage(header_page_id_);
+  ctx->root_page_id_ = header_page.As<BPlusTreeHeaderPage>()->root_page_id_;
+  if(ctx->root_page_id_ == INVALID_PAGE_ID) {
+    return;
+  }
   auto page = bpm_->ReadPage(ctx->root_page_id_);
+  header_page.Drop();
   while(!page.As<BPlusTreePage>()->IsLeafPage()){
     const InternalPage* internal_page = page.As<InternalPage>();
     auto tmp_lock = std::move(page);
-    int index = internal_page->KeyIndex(key, comparator_);
-    if(index >= internal_page->GetSize()) {
-      index--;
-    } else if(comparator_(key, internal_page->KeyAt(index)) != 0) {
-      index--;
-    }
-    // Ensure index is valid
-    if(index < 0) {
-      index = 0;
-    }
-    page = bpm_->ReadPage(internal_page->ValueAt(index));
+    page = bpm_->ReadPage(internal_page->ValueAt(ChildIndex(internal_page, key)));
     tmp_lock.Drop();
   }
   ctx->read_set_.emplace_back(std::move(page));
 }
 
 INDEX_TEMPLATE_ARGUMENTS
-auto BPLUSTREE_TYPE::FindAndLock(const KeyType &key, Context *ctx) const -> void {
+auto BPLUSTREE_TYPE::FindAndLock(const KeyType &key, Context *ctx, Operation op) const -> void {
   auto page = bpm_->WritePage(ctx->root_page_id_);
+  if(IsSafe(page.As<BPlusTreePage>(), op)){
+    ctx->header_page_ = std::nullopt;
+  }
   while(!page.As<BPlusTreePage>()->IsLeafPage()){
     const InternalPage* internal_page = page.As<InternalPage>();
     ctx->write_set_.emplace_back(std::move(page));
-    int index = internal_page->KeyIndex(key, comparator_);
-    if(index >= internal_page->GetSize()) {
-      index--;
-    } else if(comparator_(key, internal_page->KeyAt(index)) != 0) {
-      index--;
+    page = bpm_->WritePage(internal_page->ValueAt(ChildIndex(internal_page, key)));
+    if(IsSafe(page.As<BPlusTreePage>(), op)){
+      // nothing above can change anymore
+      ctx->header_page_ = std::nullopt;
+      ctx->write_set_.clear();
     }
-    // Ensure index is valid
-    if(index < 0) {
-      index = 0;
-    }
-    page = bpm_->WritePage(internal_page->ValueAt(index));
   }
   ctx->write_set_.emplace_back(std::move(page));
 }
 
+INDEX_TEMPLATE_ARGUMENTS
+auto BPLUSTREE_TYPE::FindLeafOptimistic(const KeyType &key) const -> std::optional<WritePageGuard> {
+  ReadPageGuard parent = bpm_->ReadPage(header_page_id_);
+  page_id_t page_id = parent.As<BPlusTreeHeaderPage>()->root_page_id_;
+  if(page_id == INVALID_PAGE_ID){
+    return std::nullopt;
+  }
+  while(true){
+    ReadPageGuard page = bpm_->ReadPage(page_id);
+    if(page.As<BPlusTreePage>()->IsLeafPage()){
+      // Relatch for writing. The parent's read latch keeps the page the leaf for key: splitting
+      // or merging it needs the parent's write latch.
+      page.Drop();
+      return bpm_->WritePage(page_id);
+    }
+    page_id = page.As<InternalPage>()->ValueAt(ChildIndex(page.As<InternalPage>(), key));
+    parent = std::move(page);
+  }
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+auto BPLUSTREE_TYPE::IsSafe(const BPlusTreePage *page, Operation op) -> bool {
+  if(op == Operation::INSERT){
+    return page->GetSize() < page->GetMaxSize();
+  }
+  return page->IsLeafPage() && page->GetSize() > page->GetMinSize();
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+auto BPLUSTREE_TYPE::ChildIndex(const InternalPage *page, const KeyType &key) const -> int {
+  int index = page->KeyIndex(key, comparator_);
+  if(index >= page->GetSize()) {
+    index--;
+  } else if(comparator_(key, page->KeyAt(index)) != 0) {
+    index--;
+  }
+  // Ensure index is valid
+  return std::max(index, 0);
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+void BPLUSTREE_TYPE::InsertIntoLeaf(LeafPage *leaf_page, int index, const KeyType &key, const ValueType &value) {
+  for(int i=leaf_page->GetSize(); i>index; i--){
+    leaf_page->key_array_[i] = leaf_page->key_array_[i-1];
+    leaf_page->rid_array_[i] = leaf_page->rid_array_[i-1];
+  }
+  leaf_page->key_array_[index] = key;
+  leaf_page->rid_array_[index] = value;
+  leaf_page->ChangeSizeBy(1);
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+void BPLUSTREE_TYPE::RemoveFromLeaf(LeafPage *leaf_page, int index) {
+  for(int i=index; i<leaf_page->GetSize()-1; i++){
+    leaf_page->key_array_[i] = leaf_page->key_array_[i+1];
+    leaf_page->rid_array_[i] = leaf_page->rid_array_[i+1];
+  }
+  leaf_page->key_array_[leaf_page->GetSize()-1] = KeyType{};
+  leaf_page->rid_array_[leaf_page->GetSize()-1] = RID{};
+  leaf_page->ChangeSizeBy(-1);
+}
+
 template class BPlusTree<IntegerKey, RID, IntegerKeyComparator>;
 
 }  // namespace bicycletub
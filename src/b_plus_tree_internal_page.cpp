@@ -1,6 +1,8 @@
 #include <cassert>
 #include "b_plus_tree_internal_page.h"
 #include "b_plus_tree_key.h"
+#include "key_search.h"
+#include <type_traits>
 
 namespace bicycletub {
 
@@ -48,6 +50,10 @@ auto B_PLUS_TREE_INTERNAL_PAGE_TYPE::ValueIndex(const ValueType &value) const ->
 
 INDEX_TEMPLATE_ARGUMENTS
 auto B_PLUS_TREE_INTERNAL_PAGE_TYPE::KeyIndex(const KeyType &key, const KeyComparator &comparator) const -> int {
+  if constexpr (std::is_same_v<KeyComparator, IntegerKeyComparator>) {
+    // slot 0 holds no key
+    return 1 + LowerBoundInt32(reinterpret_cast<const int32_t *>(key_array_) + 1, GetSize() - 1, key.GetValue());
+  }
   int l=1, r=GetSize();
   while(l < r){
     int mid = l + (r - l) / 2;
@@ -1,6 +1,8 @@
 #include "b_plus_tree_leaf_page.h"
 #include "b_plus_tree_key.h"  
+#include "key_search.h"
 #include <sstream>
+#include <type_traits>
 
 namespace bicycletub {
 
@@ -10,6 +12,7 @@ void B_PLUS_TREE_LEAF_PAGE_TYPE::Init(int max_size) {
   SetMaxSize(max_size);
   SetPageType(IndexPageType::LEAF_PAGE);
   next_page_id_ = INVALID_PAGE_ID;
+  prev_page_id_ = INVALID_PAGE_ID;
 }
 
 INDEX_TEMPLATE_ARGUMENTS
@@ -20,11 +23,23 @@ void B_PLUS_TREE_LEAF_PAGE_TYPE::SetNextPageId(page_id_t next_page_id) {
   next_page_id_ = next_page_id;
 }
 
+INDEX_TEMPLATE_ARGUMENTS
+auto B_PLUS_TREE_LEAF_PAGE_TYPE::GetPrevPageId() const -> page_id_t { return prev_page_id_; }
+
+INDEX_TEMPLATE_ARGUMENTS
+void B_PLUS_TREE_LEAF_PAGE_TYPE::SetPrevPageId(page_id_t prev_page_id) {
+  prev_page_id_ = prev_page_id;
+}
+
 INDEX_TEMPLATE_ARGUMENTS
 auto B_PLUS_TREE_LEAF_PAGE_TYPE::KeyAt(int index) const -> KeyType { return key_array_[index]; }
 
 INDEX_TEMPLATE_ARGUMENTS
 auto B_PLUS_TREE_LEAF_PAGE_TYPE::KeyIndex(const KeyType &key, const KeyComparator &comparator) const -> int {
+  if constexpr (std::is_same_v<KeyComparator, IntegerKeyComparator>) {
+    // plain int order: branchless halving plus a vector compare pass instead of the functor
+    return LowerBoundInt32(reinterpret_cast<const int32_t *>(key_array_), GetSize(), key.GetValue());
+  }
   int l=0, r=GetSize();
   while(l < r){
     int mid = l + (r - l) / 2;
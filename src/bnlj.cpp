@@ -4,10 +4,26 @@
 
 namespace bicycletub {
 
+namespace {
+// both inputs are scanned in page order, so the disk manager is asked to read ahead this far
+constexpr size_t SCAN_READAHEAD_PAGES = 64;
+
+// re-issues the hint whenever the scan leaves the window advised last time
+void AdviseScan(BufferPoolManager *bpm, page_id_t page_id, page_id_t &advised_begin) {
+  if (advised_begin < 0 || page_id < advised_begin ||
+      page_id >= advised_begin + static_cast<page_id_t>(SCAN_READAHEAD_PAGES)) {
+    bpm->Advise(page_id, SCAN_READAHEAD_PAGES, AccessHint::SEQUENTIAL);
+    advised_begin = page_id;
+  }
+}
+}  // namespace
+
 template<typename LeftRowType, typename RightRowType>
 void BlockNestedLoopJoinExecutor<LeftRowType, RightRowType>::ExecuteJoin(BufferPoolManager *bpm, RID left_start, RID right_start, size_t block_size) {
   results_.clear();
   RID left_curr_rid = left_start;
+  page_id_t left_advised = -1;
+  page_id_t right_advised = -1;
   
   while(left_curr_rid.IsValid()){
     std::vector<item> block_items;
@@ -15,10 +31,12 @@ void BlockNestedLoopJoinExecutor<LeftRowType, RightRowType>::ExecuteJoin(BufferP
     block_items.reserve(block_size * PAGE_SIZE / sizeof(LeftRowType) + 1);
     left_page_guards.reserve(block_size);
     size_t left_block_count = 1;
+    AdviseScan(bpm, left_curr_rid.page_id, left_advised);
     auto left_curr_guard = bpm->ReadPage(left_curr_rid.page_id);
     while(left_block_count <= block_size && left_curr_rid.IsValid()){
       if(left_curr_guard.GetPageId() != left_curr_rid.page_id){
         left_page_guards.push_back(std::move(left_curr_guard));
+        AdviseScan(bpm, left_curr_rid.page_id, left_advised);
         left_curr_guard = bpm->ReadPage(left_curr_rid.page_id);
         left_block_count++;
       }
@@ -33,9 +51,11 @@ void BlockNestedLoopJoinExecutor<LeftRowType, RightRowType>::ExecuteJoin(BufferP
     }
     if(block_items.empty()) break;
     RID right_curr_rid = right_start;
+    AdviseScan(bpm, right_start.page_id, right_advised);
     auto right_page_guard = bpm->ReadPage(right_start.page_id);
     while(right_curr_rid.IsValid()){
       if(right_page_guard.GetPageId() != right_curr_rid.page_id){
+        AdviseScan(bpm, right_curr_rid.page_id, right_advised);
         right_page_guard = std::move(bpm->ReadPage(right_curr_rid.page_id));
       }
       const auto right_page = right_page_guard.As<Page<RightRowType>>();
@@ -1,147 +1,258 @@
 #include "buffer_pool_manager.h"
+#include <algorithm>
+#include <cstring>
 #include <iostream>
+#include <stdexcept>
 
 namespace bicycletub {
 
-BufferPoolManager::BufferPoolManager(size_t num_frames, DiskManager *disk_manager)
+BufferPoolManager::BufferPoolManager(size_t num_frames, DiskManager *disk_manager, LogManager *log_manager)
     : num_frames_(num_frames),
-      next_page_id_(0),
       bpm_latch_(std::make_shared<std::mutex>()),
       replacer_(std::make_shared<ArcReplacer>(num_frames)),
-      disk_scheduler_(std::make_shared<DiskScheduler>(disk_manager)) {
-  next_page_id_.store(0);
+      disk_manager_(disk_manager),
+      disk_scheduler_(std::make_shared<DiskScheduler>(disk_manager)),
+      log_manager_(log_manager) {
   frames_.reserve(num_frames_);
   page_table_.reserve(num_frames_);
   for (size_t i = 0; i < num_frames_; i++) {
     frames_.push_back(std::make_shared<FrameHeader>(i));
     free_frames_.push_back(static_cast<int>(i));
   }
+  std::vector<char *> buffers;
+  buffers.reserve(num_frames_);
+  for (auto &frame : frames_) {
+    buffers.push_back(frame->GetDataMut());
+  }
+  // nothing is scheduled yet, so the worker cannot be using the engine concurrently
+  disk_scheduler_->RegisterBuffers(buffers);
 }
 
-auto BufferPoolManager::PageSwitch(bool is_write, page_id_t page_id, frame_id_t frame_id) -> bool {
-  auto promise = disk_scheduler_->CreatePromise();
-  auto future = promise.get_future();
-  auto disk_request = DiskRequest{
+auto BufferPoolManager::PageSwitch(bool is_write, page_id_t page_id, frame_id_t frame_id, DiskRequestPriority priority)
+    -> bool {
+  auto &frame = frames_[frame_id];
+  if (is_write && log_manager_ != nullptr) {
+    // WAL rule: the log record of the image goes to disk before the page does
+    log_manager_->Flush(frame->page_lsn_);
+  }
+  frame->io_done_.Reset();
+  DiskRequest disk_request{
     .is_write_ = is_write,
-    .data_ = frames_[frame_id]->GetDataMut(),
+    .data_ = frame->GetDataMut(),
     .page_id_ = page_id,
-    .callback_ = std::move(promise)
+    .callback_ = &frame->io_done_,
+    .priority_ = priority
   };
-  std::vector<DiskRequest> requests;
-  requests.push_back(std::move(disk_request));
-  disk_scheduler_->Schedule(requests);
+  disk_scheduler_->Schedule({&disk_request, 1});
   if (is_write) {
     disk_writes_.fetch_add(1, std::memory_order_relaxed);
   } else {
     disk_reads_.fetch_add(1, std::memory_order_relaxed);
   }
-  future.get();
-  return true;
+  return frame->io_done_.Wait();
+}
+
+auto BufferPoolManager::LoadForRead(page_id_t page_id, frame_id_t frame_id) -> bool {
+  if (const char *mapped = disk_manager_->MappedPage(page_id); mapped != nullptr) {
+    frames_[frame_id]->mapped_ = mapped;
+    zero_copy_reads_.fetch_add(1, std::memory_order_relaxed);
+    return true;
+  }
+  return PageSwitch(false, page_id, frame_id);
+}
+
+void BufferPoolManager::AbandonLoad(page_id_t page_id, frame_id_t frame_id) {
+  auto it = page_table_.find(page_id);
+  if (it != page_table_.end() && it->second == frame_id) {
+    page_table_.erase(it);
+  }
+  bool corrupted = frames_[frame_id]->io_done_.IsCorrupted();
+  frames_[frame_id]->Reset();
+  free_frames_.push_back(frame_id);
+  if (corrupted) {
+    throw PageCorruptionError(page_id);
+  }
+}
+
+auto BufferPoolManager::TakeFrame() -> std::optional<frame_id_t> {
+  if(!free_frames_.empty()){
+    frame_id_t frame_id = free_frames_.front();
+    free_frames_.pop_front();
+    frames_[frame_id]->Reset();
+    return frame_id;
+  }
+  ReapPrefetches();
+  auto evicted_frame_id = replacer_->Evict();
+  if(!evicted_frame_id.has_value()){
+    return std::nullopt;
+  }
+  frame_id_t frame_id = evicted_frame_id.value();
+  for(const auto& [loop_page_id,loop_frame_id]:page_table_){
+    if(loop_frame_id == frame_id){
+      if(frames_[frame_id]->is_dirty_){
+        PageSwitch(true, loop_page_id, frame_id);
+      }
+      page_table_.erase(loop_page_id);
+      break;
+    }
+  }
+  frames_[frame_id]->Reset();  // Reset the frame before using it
+  return frame_id;
+}
+
+auto BufferPoolManager::Resident(page_id_t page_id) -> std::optional<frame_id_t> {
+  auto it = page_table_.find(page_id);
+  if(it == page_table_.end()){
+    return std::nullopt;
+  }
+  frame_id_t frame_id = it->second;
+  if(frames_[frame_id]->prefetching_ && !FinishPrefetch(page_id, frame_id)){
+    return std::nullopt;
+  }
+  return frame_id;
 }
 
 auto BufferPoolManager::CheckedWritePage(page_id_t page_id) -> std::optional<WritePageGuard> {
   frame_id_t frame_id = -1;
   {
     std::lock_guard<std::mutex> lock(*bpm_latch_);
-    if(page_id < 0 || page_id >= next_page_id_.load()){
+    if(!page_allocator_.IsAllocated(page_id)){
       return std::nullopt;
     }
-    if(page_table_.find(page_id) != page_table_.end()){
-      frame_id = page_table_[page_id];
+    if(auto resident = Resident(page_id); resident.has_value()){
+      frame_id = resident.value();
       cache_hits_.fetch_add(1, std::memory_order_relaxed);
     }
-    else if(free_frames_.size() > 0){
-      frame_id = free_frames_.front();
-      free_frames_.pop_front();
-      page_table_[page_id] = frame_id;
-      frames_[frame_id]->Reset();  // Reset the frame before using it
-      if(!PageSwitch(false, page_id, frame_id)){
-        std::cerr << "Failed to read page " << page_id << " from disk.\n";
-        return std::nullopt;
-      }
-      cache_misses_.fetch_add(1, std::memory_order_relaxed);
-    }
     else{
-      auto evicted_frame_id = replacer_->Evict();
-      if(!evicted_frame_id.has_value()){
+      auto taken = TakeFrame();
+      if(!taken.has_value()){
         std::cerr << "Failed to evict a page for page " << page_id << ".\n";
         return std::nullopt;
       }
-      frame_id = evicted_frame_id.value();
-      for(const auto& [loop_page_id,loop_frame_id]:page_table_){
-        if(loop_frame_id == frame_id){
-          if(frames_[frame_id]->is_dirty_){
-            PageSwitch(true, loop_page_id, frame_id);
-          }
-          page_table_.erase(loop_page_id);
-          break;
-        }
-      }
-      frames_[frame_id]->Reset();  // Reset the frame before using it
+      frame_id = taken.value();
+      page_table_[page_id] = frame_id;
       if(!PageSwitch(false, page_id, frame_id)){
+        AbandonLoad(page_id, frame_id);
+        std::cerr << "Failed to read page " << page_id << " from disk.\n";
         return std::nullopt;
       }
-      page_table_[page_id] = frame_id;
       cache_misses_.fetch_add(1, std::memory_order_relaxed);
     }
+    // Pinned before the pool latch is let go, or another thread could evict the frame before
+    // the guard pins it; the guard's own pin then replaces this one.
+    frames_[frame_id]->pin_count_.fetch_add(1);
+    replacer_->RecordAccess(frame_id, page_id);
+    replacer_->SetEvictable(frame_id, false);
   }
   auto frame = frames_[frame_id];
-  replacer_->RecordAccess(frame_id, page_id);
-  return WritePageGuard(page_id, frame, replacer_, bpm_latch_, disk_scheduler_);
+  WritePageGuard guard(page_id, frame, replacer_, bpm_latch_, disk_scheduler_, log_manager_);
+  frame->pin_count_.fetch_sub(1);
+  return guard;
 }
 
 auto BufferPoolManager::CheckedReadPage(page_id_t page_id) -> std::optional<ReadPageGuard> {
   frame_id_t frame_id = -1;
   {
     std::lock_guard<std::mutex> lock(*bpm_latch_);
-    if(page_id < 0 || page_id >= next_page_id_.load()){
+    if(!page_allocator_.IsAllocated(page_id)){
       return std::nullopt;
     }
-    if(page_table_.find(page_id) != page_table_.end()){
-      frame_id = page_table_[page_id];
+    if(auto resident = Resident(page_id); resident.has_value()){
+      frame_id = resident.value();
       cache_hits_.fetch_add(1, std::memory_order_relaxed);
     }
-    else if(free_frames_.size() > 0){
-      frame_id = free_frames_.front();
-      free_frames_.pop_front();
-      page_table_[page_id] = frame_id;
-      frames_[frame_id]->Reset();  // Reset the frame before using it
-      if(!PageSwitch(false, page_id, frame_id)){
-        std::cerr << "Failed to read page " << page_id << " from disk.\n";
-        return std::nullopt;
-      }
-      cache_misses_.fetch_add(1, std::memory_order_relaxed);
-    }
     else{
-      auto evicted_frame_id = replacer_->Evict();
-      if(!evicted_frame_id.has_value()){
+      auto taken = TakeFrame();
+      if(!taken.has_value()){
         std::cerr << "Failed to evict a page for page " << page_id << ".\n";
         return std::nullopt;
       }
-      frame_id = evicted_frame_id.value();
-      for(const auto& [loop_page_id,loop_frame_id]:page_table_){
-        if(loop_frame_id == frame_id){
-          if(frames_[frame_id]->is_dirty_){
-            PageSwitch(true, loop_page_id, frame_id);
-          }
-          page_table_.erase(loop_page_id);
-          break;
-        }
-      }
-      frames_[frame_id]->Reset();  // Reset the frame before using it
-      if(!PageSwitch(false, page_id, frame_id)){
+      frame_id = taken.value();
+      page_table_[page_id] = frame_id;
+      if(!LoadForRead(page_id, frame_id)){
+        AbandonLoad(page_id, frame_id);
+        std::cerr << "Failed to read page " << page_id << " from disk.\n";
         return std::nullopt;
       }
-      page_table_[page_id] = frame_id;
       cache_misses_.fetch_add(1, std::memory_order_relaxed);
     }
+    // Pinned before the pool latch is let go, or another thread could evict the frame before
+    // the guard pins it; the guard's own pin then replaces this one.
+    frames_[frame_id]->pin_count_.fetch_add(1);
+    replacer_->RecordAccess(frame_id, page_id);
+    replacer_->SetEvictable(frame_id, false);
   }
   auto frame = frames_[frame_id];
-  replacer_->RecordAccess(frame_id, page_id);
-  return ReadPageGuard(page_id, frame, replacer_, bpm_latch_, disk_scheduler_);
+  ReadPageGuard guard(page_id, frame, replacer_, bpm_latch_, disk_scheduler_, log_manager_);
+  frame->pin_count_.fetch_sub(1);
+  return guard;
+}
+
+void BufferPoolManager::Prefetch(page_id_t page_id) {
+  std::lock_guard<std::mutex> lock(*bpm_latch_);
+  if(!page_allocator_.IsAllocated(page_id) || page_table_.find(page_id) != page_table_.end()){
+    return;
+  }
+  if(disk_manager_->MappedPage(page_id) != nullptr){
+    // zero-copy reads need no frame, let the kernel read the page ahead instead
+    disk_manager_->Advise(page_id, 1, AccessHint::SEQUENTIAL);
+    prefetch_reads_.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+  if(prefetches_.size() >= std::max<size_t>(num_frames_ / 8, 1)){
+    return;
+  }
+  auto taken = TakeFrame();
+  if(!taken.has_value()){
+    return;
+  }
+  frame_id_t frame_id = taken.value();
+  auto &frame = frames_[frame_id];
+  page_table_[page_id] = frame_id;
+  frame->prefetching_ = true;
+  prefetches_.emplace_back(page_id, frame_id);
+  frame->io_done_.Reset();
+  DiskRequest disk_request{
+    .is_write_ = false,
+    .data_ = frame->GetDataMut(),
+    .page_id_ = page_id,
+    .callback_ = &frame->io_done_,
+    .priority_ = DiskRequestPriority::PREFETCH
+  };
+  disk_scheduler_->Schedule({&disk_request, 1});
+  disk_reads_.fetch_add(1, std::memory_order_relaxed);
+  prefetch_reads_.fetch_add(1, std::memory_order_relaxed);
+}
+
+auto BufferPoolManager::FinishPrefetch(page_id_t page_id, frame_id_t frame_id) -> bool {
+  auto &frame = frames_[frame_id];
+  bool ok = frame->io_done_.Wait();
+  frame->prefetching_ = false;
+  std::erase(prefetches_, std::make_pair(page_id, frame_id));
+  if(!ok){
+    // the page is read again, synchronously, by whoever needs it
+    page_table_.erase(page_id);
+    frame->Reset();
+    free_frames_.push_back(frame_id);
+  }
+  return ok;
+}
+
+void BufferPoolManager::ReapPrefetches() {
+  // prefetched pages nobody asked for yet become evictable once their read is done
+  auto pending = prefetches_;
+  for(const auto &[page_id, frame_id] : pending){
+    if(frames_[frame_id]->io_done_.IsDone() && FinishPrefetch(page_id, frame_id)){
+      replacer_->RecordAccess(frame_id, page_id);
+      replacer_->SetEvictable(frame_id, true);
+    }
+  }
 }
 
 auto BufferPoolManager::WritePage(page_id_t page_id) -> WritePageGuard {
+  if (auto held = AtomicWriteScope::Reclaim(bpm_latch_.get(), page_id); held.has_value()) {
+    return std::move(held).value();
+  }
   auto guard_opt = CheckedWritePage(page_id);
 
   if (!guard_opt.has_value()) {
@@ -166,7 +277,7 @@ auto BufferPoolManager::ReadPage(page_id_t page_id) -> ReadPageGuard {
 
 auto BufferPoolManager::FlushPage(page_id_t page_id) -> bool {
   std::lock_guard<std::mutex> lock(*bpm_latch_); 
-  if(page_id < 0 || page_id >= next_page_id_.load()){
+  if(!page_allocator_.IsAllocated(page_id)){
     return false;
   }
   if(page_table_.find(page_id) == page_table_.end()){
@@ -178,27 +289,153 @@ auto BufferPoolManager::FlushPage(page_id_t page_id) -> bool {
       return true;
     }
     PageSwitch(true, page_id, page_table_[page_id]);
-    frames_[page_table_[page_id]]->is_dirty_ = false;
+    frames_[page_table_[page_id]]->MarkClean();
   }
   return true;
 }
 
-void BufferPoolManager::FlushAllPages() {
-  std::lock_guard<std::mutex> lock(*bpm_latch_);
-  for(const auto& [page_id, frame_id]: page_table_){
+void BufferPoolManager::FlushAllPages() { WriteBack(std::nullopt); }
+
+// A page is old when its first unwritten change was logged before dirtied_before.
+auto BufferPoolManager::NeedsWriteBack(const FrameHeader &frame, std::optional<lsn_t> dirtied_before) -> bool {
+  if (!frame.is_dirty_) {
+    return false;
+  }
+  if (!dirtied_before.has_value()) {
+    return true;
+  }
+  lsn_t rec_lsn = frame.rec_lsn_.load();
+  return rec_lsn != INVALID_LSN && rec_lsn < dirtied_before.value();
+}
+
+void BufferPoolManager::WriteBack(std::optional<lsn_t> dirtied_before) {
+  // The pool latch is only held to snapshot the page table and to pin a slice of frames,
+  // so misses keep being served while the write-back runs at background priority.
+  std::vector<page_id_t> resident;
+  {
+    std::lock_guard<std::mutex> lock(*bpm_latch_);
+    resident.reserve(page_table_.size());
+    for(const auto& [page_id, frame_id]: page_table_){
+      resident.push_back(page_id);
+    }
+  }
+  // bound the pinned slice so concurrent misses can still find a victim
+  const size_t slice = std::clamp<size_t>(num_frames_ / 8, 1, DiskScheduler::DEFAULT_BACKGROUND_BATCH);
+  std::vector<std::pair<page_id_t, frame_id_t>> pinned;
+  std::vector<std::pair<page_id_t, frame_id_t>> busy;
+  std::vector<DiskRequest> requests;
+  std::vector<frame_id_t> latched;
+  lsn_t max_lsn = INVALID_LSN;
+  for(size_t begin = 0; begin < resident.size(); begin += slice){
+    pinned.clear();
+    busy.clear();
+    requests.clear();
+    latched.clear();
+    max_lsn = INVALID_LSN;
     {
-      std::lock_guard<std::shared_mutex> lock(frames_[frame_id]->rwlatch_);
-      if(frames_[frame_id]->is_dirty_){
-        PageSwitch(true, page_id, frame_id);
-        frames_[frame_id]->is_dirty_ = false;
+      std::lock_guard<std::mutex> lock(*bpm_latch_);
+      for(size_t i = begin; i < std::min(begin + slice, resident.size()); i++){
+        auto it = page_table_.find(resident[i]);
+        if(it == page_table_.end()){
+          continue;  // evicted meanwhile, the eviction wrote it back
+        }
+        if(frames_[it->second]->prefetching_){
+          continue;  // still being read in, so never dirty; the replacer does not know it yet
+        }
+        frames_[it->second]->pin_count_.fetch_add(1);
+        replacer_->SetEvictable(it->second, false);
+        pinned.emplace_back(it->first, it->second);
+      }
+    }
+    // shared latches keep the images stable until their writes complete; never block on a
+    // latch while holding others, frames held exclusively are written one by one below
+    for(const auto& [page_id, frame_id]: pinned){
+      auto &frame = frames_[frame_id];
+      if(!frame->rwlatch_.try_lock_shared()){
+        busy.emplace_back(page_id, frame_id);
+        continue;
+      }
+      if(!NeedsWriteBack(*frame, dirtied_before)){
+        frame->rwlatch_.unlock_shared();
+        continue;
+      }
+      max_lsn = std::max(max_lsn, frame->page_lsn_);
+      frame->io_done_.Reset();
+      requests.push_back(DiskRequest{.is_write_ = true,
+                                     .data_ = frame->GetDataMut(),
+                                     .page_id_ = page_id,
+                                     .callback_ = &frame->io_done_,
+                                     .priority_ = DiskRequestPriority::BACKGROUND});
+      latched.push_back(frame_id);
+    }
+    if (log_manager_ != nullptr) {
+      // one log flush covers the whole slice
+      log_manager_->Flush(max_lsn);
+    }
+    disk_scheduler_->Schedule(requests);
+    disk_writes_.fetch_add(requests.size(), std::memory_order_relaxed);
+    for(auto frame_id: latched){
+      auto &frame = frames_[frame_id];
+      frame->io_done_.Wait();
+      frame->MarkClean();
+      frame->rwlatch_.unlock_shared();
+    }
+    for(const auto& [page_id, frame_id]: busy){
+      auto &frame = frames_[frame_id];
+      std::shared_lock<std::shared_mutex> frame_lock(frame->rwlatch_);
+      if(NeedsWriteBack(*frame, dirtied_before)){
+        PageSwitch(true, page_id, frame_id, DiskRequestPriority::BACKGROUND);
+        frame->MarkClean();
+      }
+    }
+    {
+      std::lock_guard<std::mutex> lock(*bpm_latch_);
+      for(const auto& [page_id, frame_id]: pinned){
+        if(frames_[frame_id]->pin_count_.fetch_sub(1) == 1){
+          replacer_->SetEvictable(frame_id, true);
+        }
+      }
+    }
+  }
+}
+
+// Fuzzy checkpoint: nothing is stopped, the dirty page table is a snapshot of the frames'
+// recovery LSNs taken between the BEGIN and END records. Any change logged before BEGIN
+// whose page is not in the table is durable on disk: written pages are synced before END.
+// Pages that stayed dirty since the previous checkpoint are written back first, so redo
+// never has to start more than about two checkpoint intervals back.
+auto BufferPoolManager::Checkpoint() -> lsn_t {
+  if (log_manager_ == nullptr) {
+    throw std::logic_error("checkpoints need a log manager");
+  }
+  std::lock_guard<std::mutex> checkpoint_lock(checkpoint_latch_);
+  lsn_t begin_lsn = log_manager_->Append(LogRecordType::CHECKPOINT_BEGIN, INVALID_PAGE_ID, nullptr, 0);
+  if (last_checkpoint_lsn_ != INVALID_LSN) {
+    WriteBack(last_checkpoint_lsn_);
+  }
+  std::vector<char> payload(sizeof(lsn_t));
+  std::memcpy(payload.data(), &begin_lsn, sizeof(lsn_t));
+  {
+    std::lock_guard<std::mutex> lock(*bpm_latch_);
+    for (const auto &[page_id, frame_id] : page_table_) {
+      DirtyPageEntry entry{page_id, frames_[frame_id]->rec_lsn_.load()};
+      if (entry.rec_lsn_ != INVALID_LSN) {
+        const auto *bytes = reinterpret_cast<const char *>(&entry);
+        payload.insert(payload.end(), bytes, bytes + sizeof(entry));
       }
     }
   }
+  disk_manager_->Sync();
+  lsn_t end_lsn = log_manager_->Append(LogRecordType::CHECKPOINT_END, INVALID_PAGE_ID, payload.data(), payload.size());
+  log_manager_->Flush(end_lsn);
+  log_manager_->SetCheckpoint(begin_lsn, end_lsn);
+  last_checkpoint_lsn_ = begin_lsn;
+  return begin_lsn;
 }
 
 auto BufferPoolManager::GetPinCount(page_id_t page_id) -> std::optional<size_t> {
   std::lock_guard<std::mutex> lock(*bpm_latch_);
-  if(page_id < 0 || page_id >= next_page_id_.load()){
+  if(!page_allocator_.IsAllocated(page_id)){
     return std::nullopt;
   }
   if(page_table_.find(page_id) == page_table_.end()){
@@ -0,0 +1,260 @@
+#include "checksum_disk_manager.h"
+
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <stdexcept>
+
+#include "crc32c.h"
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace bicycletub {
+
+namespace {
+// Sidecar layout: this header, then the raw entries of every page up to the last directory
+// block. clean_ is 0 from the first write after a save until the next save replaces the file.
+constexpr char SIDECAR_MAGIC[8] = {'B', 'T', 'U', 'B', 'C', 'R', 'C', '1'};
+
+struct SidecarHeader {
+  char magic_[8];
+  uint64_t clean_;
+};
+
+auto MakeHeader(bool clean) -> SidecarHeader {
+  SidecarHeader header{};
+  std::memcpy(header.magic_, SIDECAR_MAGIC, sizeof(SIDECAR_MAGIC));
+  header.clean_ = clean ? 1 : 0;
+  return header;
+}
+
+auto SyncFile(std::FILE *file) -> bool {
+  if (std::fflush(file) != 0) {
+    return false;
+  }
+#ifdef _WIN32
+  return ::_commit(::_fileno(file)) == 0;
+#else
+  return ::fdatasync(::fileno(file)) == 0;
+#endif
+}
+}  // namespace
+
+ChecksumDiskManager::ChecksumDiskManager(DiskManager *inner, std::string checksum_path)
+    : inner_(inner), checksum_path_(std::move(checksum_path)) {
+  if (!checksum_path_.empty()) {
+    Load();
+  }
+}
+
+ChecksumDiskManager::~ChecksumDiskManager() {
+  if (!checksum_path_.empty()) {
+    try {
+      Sync();
+    } catch (const std::exception &) {
+    }
+  }
+}
+
+auto ChecksumDiskManager::Entry(page_id_t page_id, bool create) -> std::atomic<uint64_t> * {
+  if (page_id < 0) {
+    return nullptr;
+  }
+  size_t block = static_cast<size_t>(page_id) / BLOCK_ENTRIES;
+  size_t slot = static_cast<size_t>(page_id) % BLOCK_ENTRIES;
+  {
+    std::shared_lock lock(blocks_latch_);
+    if (block < blocks_.size() && blocks_[block] != nullptr) {
+      return &blocks_[block][slot];
+    }
+  }
+  if (!create) {
+    return nullptr;
+  }
+  std::unique_lock lock(blocks_latch_);
+  if (block >= blocks_.size()) {
+    blocks_.resize(block + 1);
+  }
+  if (blocks_[block] == nullptr) {
+    blocks_[block] = std::make_unique<std::atomic<uint64_t>[]>(BLOCK_ENTRIES);
+  }
+  return &blocks_[block][slot];
+}
+
+auto ChecksumDiskManager::Record(page_id_t page_id, const char *buf) -> uint64_t {
+  return Entry(page_id, true)->exchange(Crc32c(buf, PAGE_SIZE) | PRESENT, std::memory_order_acq_rel);
+}
+
+void ChecksumDiskManager::Verify(page_id_t page_id, const char *buf) {
+  auto *entry = Entry(page_id, false);
+  uint64_t expected = entry == nullptr ? 0 : entry->load(std::memory_order_acquire);
+  if (expected == 0) {
+    return;
+  }
+  verified_reads_.fetch_add(1, std::memory_order_relaxed);
+  if ((Crc32c(buf, PAGE_SIZE) | PRESENT) != expected) {
+    corrupt_reads_.fetch_add(1, std::memory_order_relaxed);
+    throw PageCorruptionError(page_id);
+  }
+}
+
+void ChecksumDiskManager::ReadPage(page_id_t page_id, char *out_buf) {
+  inner_->ReadPage(page_id, out_buf);
+  Verify(page_id, out_buf);
+}
+
+auto ChecksumDiskManager::LatchForWrite() -> std::shared_lock<std::shared_mutex> {
+  if (checksum_path_.empty()) {
+    return {};
+  }
+  std::shared_lock lock(sidecar_latch_);
+  while (!sidecar_dirty_) {
+    lock.unlock();
+    MarkSidecarDirty();
+    lock.lock();
+  }
+  return lock;
+}
+
+// Synced before any page write it covers is issued, so a sidecar that still says clean
+// after a crash matches the pages.
+void ChecksumDiskManager::MarkSidecarDirty() {
+  std::unique_lock lock(sidecar_latch_);
+  if (sidecar_dirty_) {
+    return;
+  }
+  std::FILE *file = std::fopen(checksum_path_.c_str(), "r+b");
+  if (file == nullptr) {
+    file = std::fopen(checksum_path_.c_str(), "wb");  // first write ever
+  }
+  if (file == nullptr) {
+    throw std::runtime_error("cannot write checksum file " + checksum_path_);
+  }
+  SidecarHeader header = MakeHeader(false);
+  bool ok = std::fwrite(&header, sizeof(header), 1, file) == 1 && SyncFile(file);
+  ok = std::fclose(file) == 0 && ok;
+  if (!ok) {
+    throw std::runtime_error("cannot write checksum file " + checksum_path_);
+  }
+  sidecar_dirty_ = true;
+}
+
+// The checksum is recorded before the write is issued: a reader racing with the write of
+// the same page is excluded by the buffer pool, which has at most one frame per page.
+void ChecksumDiskManager::WritePage(page_id_t page_id, const char *buf) {
+  auto sidecar = LatchForWrite();
+  uint64_t previous = Record(page_id, buf);
+  try {
+    inner_->WritePage(page_id, buf);
+  } catch (...) {
+    // the old image is still in place
+    Entry(page_id, false)->store(previous, std::memory_order_release);
+    throw;
+  }
+}
+
+void ChecksumDiskManager::ReadPages(page_id_t first_page_id, char *const *out_bufs, size_t count) {
+  inner_->ReadPages(first_page_id, out_bufs, count);
+  for (size_t i = 0; i < count; i++) {
+    Verify(first_page_id + static_cast<page_id_t>(i), out_bufs[i]);
+  }
+}
+
+void ChecksumDiskManager::WritePages(page_id_t first_page_id, const char *const *bufs, size_t count) {
+  auto sidecar = LatchForWrite();
+  std::vector<uint64_t> previous(count);
+  for (size_t i = 0; i < count; i++) {
+    previous[i] = Record(first_page_id + static_cast<page_id_t>(i), bufs[i]);
+  }
+  try {
+    inner_->WritePages(first_page_id, bufs, count);
+  } catch (...) {
+    // unknown how much of the run landed: forget these checksums rather than report false corruption
+    for (size_t i = 0; i < count; i++) {
+      Entry(first_page_id + static_cast<page_id_t>(i), false)->store(0, std::memory_order_release);
+    }
+    throw;
+  }
+}
+
+void ChecksumDiskManager::DeallocatePage(page_id_t page_id) {
+  if (auto *entry = Entry(page_id, false); entry != nullptr) {
+    entry->store(0, std::memory_order_release);
+  }
+  inner_->DeallocatePage(page_id);
+}
+
+// The pages are synced under the exclusive latch, so no write lands between them and the
+// table that is saved as clean.
+void ChecksumDiskManager::Sync() {
+  if (checksum_path_.empty()) {
+    inner_->Sync();
+    return;
+  }
+  std::unique_lock lock(sidecar_latch_);
+  inner_->Sync();
+  if (sidecar_dirty_) {
+    Save();
+  }
+}
+
+void ChecksumDiskManager::Load() {
+  std::FILE *file = std::fopen(checksum_path_.c_str(), "rb");
+  if (file == nullptr) {
+    return;  // first run
+  }
+  std::unique_ptr<std::FILE, int (*)(std::FILE *)> closer(file, &std::fclose);
+  SidecarHeader header{};
+  size_t n = std::fread(&header, 1, sizeof(header), file);
+  if (n == sizeof(header) && std::memcmp(header.magic_, SIDECAR_MAGIC, sizeof(SIDECAR_MAGIC)) != 0) {
+    throw std::runtime_error(checksum_path_ + " is not a checksum file");
+  }
+  if (n != sizeof(header) || header.clean_ == 0) {
+    // pages may have been written after these checksums were saved
+    loaded_dirty_ = true;
+    sidecar_dirty_ = true;
+    return;
+  }
+  std::unique_lock lock(blocks_latch_);
+  std::vector<uint64_t> entries(BLOCK_ENTRIES);
+  while ((n = std::fread(entries.data(), sizeof(uint64_t), BLOCK_ENTRIES, file)) > 0) {
+    auto &block = blocks_.emplace_back(std::make_unique<std::atomic<uint64_t>[]>(BLOCK_ENTRIES));
+    for (size_t i = 0; i < n; i++) {
+      block[i].store(entries[i], std::memory_order_relaxed);
+    }
+  }
+}
+
+void ChecksumDiskManager::Save() {
+  std::string tmp = checksum_path_ + ".tmp";
+  std::FILE *file = std::fopen(tmp.c_str(), "wb");
+  if (file == nullptr) {
+    throw std::runtime_error("cannot write checksum file " + tmp);
+  }
+  std::vector<uint64_t> entries(BLOCK_ENTRIES);
+  SidecarHeader header = MakeHeader(true);
+  bool ok = std::fwrite(&header, sizeof(header), 1, file) == 1;
+  {
+    std::shared_lock lock(blocks_latch_);
+    for (const auto &block : blocks_) {
+      for (size_t i = 0; i < BLOCK_ENTRIES; i++) {
+        entries[i] = block == nullptr ? 0 : block[i].load(std::memory_order_relaxed);
+      }
+      ok = ok && std::fwrite(entries.data(), sizeof(uint64_t), BLOCK_ENTRIES, file) == BLOCK_ENTRIES;
+    }
+  }
+  ok = ok && SyncFile(file);
+  ok = std::fclose(file) == 0 && ok;
+  // replace atomically so a crash leaves either the old or the new table
+  if (!ok || std::rename(tmp.c_str(), checksum_path_.c_str()) != 0) {
+    std::remove(tmp.c_str());
+    throw std::runtime_error("cannot write checksum file " + checksum_path_);
+  }
+  sidecar_dirty_ = false;
+}
+
+}  // namespace bicycletub
@@ -0,0 +1,92 @@
+#include "crc32c.h"
+
+#include <array>
+#include <cstring>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define BICY_CRC32C_SSE42 1
+#include <nmmintrin.h>
+#endif
+
+namespace bicycletub {
+
+namespace {
+constexpr uint32_t POLY = 0x82F63B78;  // reflected Castagnoli polynomial
+
+using Tables = std::array<std::array<uint32_t, 256>, 8>;
+
+constexpr auto MakeTables() -> Tables {
+  Tables t{};
+  for (uint32_t i = 0; i < 256; i++) {
+    uint32_t crc = i;
+    for (int k = 0; k < 8; k++) {
+      crc = (crc & 1) != 0 ? (crc >> 1) ^ POLY : crc >> 1;
+    }
+    t[0][i] = crc;
+  }
+  for (uint32_t i = 0; i < 256; i++) {
+    for (size_t k = 1; k < 8; k++) {
+      t[k][i] = (t[k - 1][i] >> 8) ^ t[0][t[k - 1][i] & 0xFF];
+    }
+  }
+  return t;
+}
+
+constexpr Tables TABLES = MakeTables();
+
+#ifdef BICY_CRC32C_SSE42
+__attribute__((target("sse4.2"))) auto Crc32cSse42(const void *data, size_t len, uint32_t crc) -> uint32_t {
+  const auto *p = static_cast<const unsigned char *>(data);
+  uint64_t c = ~crc;
+  for (; len >= 8; len -= 8, p += 8) {
+    uint64_t word;
+    std::memcpy(&word, p, 8);
+    c = _mm_crc32_u64(c, word);
+  }
+  auto c32 = static_cast<uint32_t>(c);
+  for (; len > 0; len--, p++) {
+    c32 = _mm_crc32_u8(c32, *p);
+  }
+  return ~c32;
+}
+
+const bool HAS_SSE42 = __builtin_cpu_supports("sse4.2");
+#endif
+}  // namespace
+
+auto Crc32cPortable(const void *data, size_t len, uint32_t crc) -> uint32_t {
+  const auto *p = static_cast<const unsigned char *>(data);
+  uint32_t c = ~crc;
+  for (; len >= 8; len -= 8, p += 8) {
+    uint32_t lo;
+    uint32_t hi;
+    std::memcpy(&lo, p, 4);
+    std::memcpy(&hi, p + 4, 4);
+    lo ^= c;
+    c = TABLES[7][lo & 0xFF] ^ TABLES[6][(lo >> 8) & 0xFF] ^ TABLES[5][(lo >> 16) & 0xFF] ^ TABLES[4][lo >> 24] ^
+        TABLES[3][hi & 0xFF] ^ TABLES[2][(hi >> 8) & 0xFF] ^ TABLES[1][(hi >> 16) & 0xFF] ^ TABLES[0][hi >> 24];
+  }
+  for (; len > 0; len--, p++) {
+    c = (c >> 8) ^ TABLES[0][(c ^ *p) & 0xFF];
+  }
+  return ~c;
+}
+
+auto Crc32c(const void *data, size_t len, uint32_t crc) -> uint32_t {
+#ifdef BICY_CRC32C_SSE42
+  if (HAS_SSE42) {
+    return Crc32cSse42(data, len, crc);
+  }
+#endif
+  return Crc32cPortable(data, len, crc);
+}
+
+auto Crc32cIsHardware() -> bool {
+#ifdef BICY_CRC32C_SSE42
+  return HAS_SSE42;
+#else
+  return false;
+#endif
+}
+
+}  // namespace bicycletub
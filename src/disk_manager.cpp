@@ -0,0 +1,17 @@
+#include "disk_manager.h"
+
+namespace bicycletub {
+
+void DiskManager::ReadPages(page_id_t first_page_id, char *const *out_bufs, size_t count) {
+  for (size_t i = 0; i < count; i++) {
+    ReadPage(first_page_id + static_cast<page_id_t>(i), out_bufs[i]);
+  }
+}
+
+void DiskManager::WritePages(page_id_t first_page_id, const char *const *bufs, size_t count) {
+  for (size_t i = 0; i < count; i++) {
+    WritePage(first_page_id + static_cast<page_id_t>(i), bufs[i]);
+  }
+}
+
+}  // namespace bicycletub
@@ -0,0 +1,258 @@
+#include "disk_manager_file.h"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+namespace bicycletub {
+
+namespace {
+auto IsAligned(const void *ptr) -> bool { return reinterpret_cast<uintptr_t>(ptr) % PAGE_SIZE == 0; }
+
+// per-thread aligned page used when O_DIRECT meets an unaligned caller buffer
+auto BouncePage() -> char * {
+  struct Deleter {
+    void operator()(char *p) const { std::free(p); }
+  };
+  thread_local std::unique_ptr<char, Deleter> page(static_cast<char *>(std::aligned_alloc(PAGE_SIZE, PAGE_SIZE)));
+  return page.get();
+}
+
+[[noreturn]] void ThrowErrno(const std::string &what) {
+  throw std::runtime_error(what + ": " + std::strerror(errno));
+}
+
+constexpr size_t MAX_IOVECS = 256;
+}  // namespace
+
+DiskManagerFile::DiskManagerFile(const std::string &path, bool direct_io, size_t sync_batch,
+                                 size_t preallocate_pages)
+    : path_(path), direct_io_(direct_io), sync_batch_(sync_batch), preallocate_pages_(preallocate_pages) {
+  int flags = O_RDWR | O_CREAT;
+#ifdef O_DIRECT
+  if (direct_io_) {
+    fd_ = ::open(path_.c_str(), flags | O_DIRECT, 0644);
+    if (fd_ < 0 && errno != EINVAL) {
+      ThrowErrno("open " + path_);
+    }
+  }
+#else
+  direct_io_ = false;
+#endif
+  if (fd_ < 0) {
+    direct_io_ = false;
+    fd_ = ::open(path_.c_str(), flags, 0644);
+    if (fd_ < 0) {
+      ThrowErrno("open " + path_);
+    }
+  }
+  struct stat st {};
+  if (::fstat(fd_, &st) != 0) {
+    ThrowErrno("fstat " + path_);
+  }
+  num_pages_.store(static_cast<page_id_t>((st.st_size + PAGE_SIZE - 1) / PAGE_SIZE));
+  allocated_pages_.store(num_pages_.load());
+}
+
+DiskManagerFile::~DiskManagerFile() {
+  if (fd_ >= 0) {
+    try {
+      Sync();
+    } catch (const std::exception &) {
+    }
+    ::close(fd_);
+  }
+}
+
+void DiskManagerFile::ReadAt(char *buf, size_t len, int64_t offset) {
+  char *target = buf;
+  if (direct_io_ && !IsAligned(buf)) {
+    target = BouncePage();
+  }
+  size_t done = 0;
+  while (done < len) {
+    ssize_t n = ::pread(fd_, target + done, len - done, static_cast<off_t>(offset + done));
+    if (n < 0) {
+      if (errno == EINTR) continue;
+      ThrowErrno("pread " + path_);
+    }
+    if (n == 0) {
+      // past the end of the file: never written
+      std::memset(target + done, 0, len - done);
+      break;
+    }
+    done += static_cast<size_t>(n);
+  }
+  if (target != buf) {
+    std::memcpy(buf, target, len);
+  }
+}
+
+void DiskManagerFile::WriteAt(const char *buf, size_t len, int64_t offset) {
+  const char *source = buf;
+  if (direct_io_ && !IsAligned(buf)) {
+    char *bounce = BouncePage();
+    std::memcpy(bounce, buf, len);
+    source = bounce;
+  }
+  size_t done = 0;
+  while (done < len) {
+    ssize_t n = ::pwrite(fd_, source + done, len - done, static_cast<off_t>(offset + done));
+    if (n < 0) {
+      if (errno == EINTR) continue;
+      ThrowErrno("pwrite " + path_);
+    }
+    if (n == 0) {
+      // no progress and no errno to report; retrying would spin forever
+      throw std::runtime_error("pwrite " + path_ + ": no bytes written");
+    }
+    done += static_cast<size_t>(n);
+  }
+}
+
+void DiskManagerFile::Preallocate(page_id_t end_page_id) {
+  if (preallocate_pages_ == 0 || end_page_id <= allocated_pages_.load(std::memory_order_acquire)) {
+    return;
+  }
+#ifdef __linux__
+  std::lock_guard<std::mutex> lk(alloc_latch_);
+  page_id_t allocated = allocated_pages_.load();
+  if (end_page_id <= allocated) {
+    return;
+  }
+  auto step = static_cast<page_id_t>(preallocate_pages_.load());
+  page_id_t target = (end_page_id + step - 1) / step * step;
+  // KEEP_SIZE reserves blocks without moving EOF, so NumPages still tracks written pages
+  if (::fallocate(fd_, FALLOC_FL_KEEP_SIZE, static_cast<off_t>(allocated) * PAGE_SIZE,
+                  static_cast<off_t>(target - allocated) * PAGE_SIZE) == 0) {
+    allocated_pages_.store(target, std::memory_order_release);
+  } else {
+    // not supported here, stop trying
+    preallocate_pages_ = 0;
+  }
+#endif
+}
+
+void DiskManagerFile::NoteWrites(page_id_t end_page_id, size_t count) {
+  page_id_t seen = num_pages_.load(std::memory_order_relaxed);
+  while (seen < end_page_id && !num_pages_.compare_exchange_weak(seen, end_page_id)) {
+  }
+  uint64_t issued = writes_issued_.fetch_add(count, std::memory_order_acq_rel) + count;
+  if (sync_batch_ != 0 && issued / sync_batch_ != (issued - count) / sync_batch_) {
+    Sync();
+  }
+}
+
+void DiskManagerFile::ReadPage(page_id_t page_id, char *out_buf) {
+  ReadAt(out_buf, PAGE_SIZE, static_cast<int64_t>(page_id) * PAGE_SIZE);
+}
+
+void DiskManagerFile::WritePage(page_id_t page_id, const char *buf) {
+  Preallocate(page_id + 1);
+  WriteAt(buf, PAGE_SIZE, static_cast<int64_t>(page_id) * PAGE_SIZE);
+  NoteWrites(page_id + 1, 1);
+}
+
+void DiskManagerFile::ReadPages(page_id_t first_page_id, char *const *out_bufs, size_t count) {
+  bool vectored = !direct_io_ || std::all_of(out_bufs, out_bufs + count, [](char *b) { return IsAligned(b); });
+  if (!vectored) {
+    DiskManager::ReadPages(first_page_id, out_bufs, count);
+    return;
+  }
+  iovec iov[MAX_IOVECS];
+  for (size_t begin = 0; begin < count; begin += MAX_IOVECS) {
+    size_t n = std::min(MAX_IOVECS, count - begin);
+    for (size_t i = 0; i < n; i++) {
+      iov[i].iov_base = out_bufs[begin + i];
+      iov[i].iov_len = PAGE_SIZE;
+    }
+    int64_t offset = static_cast<int64_t>(first_page_id + static_cast<page_id_t>(begin)) * PAGE_SIZE;
+    ssize_t got;
+    do {
+      got = ::preadv(fd_, iov, static_cast<int>(n), static_cast<off_t>(offset));
+    } while (got < 0 && errno == EINTR);
+    if (got < 0) {
+      ThrowErrno("preadv " + path_);
+    }
+    // short read (end of file): finish the remaining pages one by one
+    auto full = static_cast<size_t>(got) / PAGE_SIZE;
+    for (size_t i = full; i < n; i++) {
+      ReadAt(out_bufs[begin + i], PAGE_SIZE, offset + static_cast<int64_t>(i) * PAGE_SIZE);
+    }
+  }
+}
+
+void DiskManagerFile::WritePages(page_id_t first_page_id, const char *const *bufs, size_t count) {
+  bool vectored = !direct_io_ || std::all_of(bufs, bufs + count, [](const char *b) { return IsAligned(b); });
+  if (!vectored) {
+    DiskManager::WritePages(first_page_id, bufs, count);
+    return;
+  }
+  Preallocate(first_page_id + static_cast<page_id_t>(count));
+  iovec iov[MAX_IOVECS];
+  for (size_t begin = 0; begin < count; begin += MAX_IOVECS) {
+    size_t n = std::min(MAX_IOVECS, count - begin);
+    for (size_t i = 0; i < n; i++) {
+      iov[i].iov_base = const_cast<char *>(bufs[begin + i]);
+      iov[i].iov_len = PAGE_SIZE;
+    }
+    int64_t offset = static_cast<int64_t>(first_page_id + static_cast<page_id_t>(begin)) * PAGE_SIZE;
+    ssize_t put;
+    do {
+      put = ::pwritev(fd_, iov, static_cast<int>(n), static_cast<off_t>(offset));
+    } while (put < 0 && errno == EINTR);
+    if (put < 0) {
+      ThrowErrno("pwritev " + path_);
+    }
+    auto full = static_cast<size_t>(put) / PAGE_SIZE;
+    for (size_t i = full; i < n; i++) {
+      WriteAt(bufs[begin + i], PAGE_SIZE, offset + static_cast<int64_t>(i) * PAGE_SIZE);
+    }
+  }
+  NoteWrites(first_page_id + static_cast<page_id_t>(count), count);
+}
+
+void DiskManagerFile::DeallocatePage(page_id_t page_id) {
+#ifdef __linux__
+  ::fallocate(fd_, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, static_cast<off_t>(page_id) * PAGE_SIZE, PAGE_SIZE);
+#else
+  (void)page_id;
+#endif
+}
+
+void DiskManagerFile::Sync() {
+  uint64_t target = writes_issued_.load(std::memory_order_acquire);
+  if (writes_synced_.load(std::memory_order_acquire) >= target) {
+    return;
+  }
+  std::lock_guard<std::mutex> lk(sync_latch_);
+  if (writes_synced_.load(std::memory_order_acquire) >= target) {
+    // another caller's fdatasync already covered our writes
+    return;
+  }
+  uint64_t covered = writes_issued_.load(std::memory_order_acquire);
+#ifdef __linux__
+  int rc = ::fdatasync(fd_);
+#else
+  int rc = ::fsync(fd_);
+#endif
+  if (rc != 0) {
+    ThrowErrno("fdatasync " + path_);
+  }
+  num_syncs_.fetch_add(1, std::memory_order_relaxed);
+  writes_synced_.store(covered, std::memory_order_release);
+}
+
+auto DiskManagerFile::NumPages() const -> size_t { return static_cast<size_t>(num_pages_.load()); }
+
+}  // namespace bicycletub
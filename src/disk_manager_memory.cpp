@@ -1,54 +1,439 @@
 #include "disk_manager_memory.h"
 
-#include <stdexcept>
+#include <algorithm>
+#include <bit>
+#include <cstdio>
+#include <cstdlib>
 #include <cstring>
 #include <mutex>
+#include <new>
 #include <shared_mutex>
-#include <array>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "page_codec.h"
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#endif
 
 namespace bicycletub {
+
+namespace {
+constexpr size_t SEGMENT_PAGES = DiskManagerMemory::CHUNK_PAGES * DiskManagerMemory::SEGMENT_CHUNKS;
+
+auto CheckedIndex(page_id_t page_id) -> size_t {
+  if (page_id < 0) {
+    throw std::runtime_error("Invalid page id " + std::to_string(page_id));
+  }
+  return static_cast<size_t>(page_id);
+}
+
+// Publishes a freshly created node in slot unless another thread got there first.
+template <typename T>
+auto InstallOnce(std::atomic<T *> &slot) -> T * {
+  T *node = slot.load(std::memory_order_acquire);
+  if (node != nullptr) {
+    return node;
+  }
+  auto fresh = std::make_unique<T>();
+  if (slot.compare_exchange_strong(node, fresh.get(), std::memory_order_acq_rel, std::memory_order_acquire)) {
+    return fresh.release();
+  }
+  return node;
+}
+
+// Image layout: the header, a presence mask of CHUNK_PAGES bits per chunk, and from the
+// next PAGE_SIZE boundary on every chunk's pages at a fixed offset, so chunk c can be read
+// (or mapped) with one call. Chunks without pages are holes.
+constexpr char IMAGE_MAGIC[8] = {'B', 'T', 'U', 'B', 'I', 'M', 'G', '1'};
+constexpr size_t CHUNK_BYTES = DiskManagerMemory::CHUNK_PAGES * PAGE_SIZE;
+using ChunkMask = std::array<uint8_t, DiskManagerMemory::CHUNK_PAGES / 8>;
+
+struct ImageHeader {
+  char magic_[8];
+  uint32_t page_size_;
+  uint32_t chunk_pages_;
+  uint64_t num_chunks_;
+};
+
+auto ChunkOffset(uint64_t num_chunks, uint64_t chunk) -> uint64_t {
+  uint64_t masks_end = sizeof(ImageHeader) + num_chunks * sizeof(ChunkMask);
+  return (masks_end + PAGE_SIZE - 1) / PAGE_SIZE * PAGE_SIZE + chunk * CHUNK_BYTES;
+}
+}  // namespace
+
+void DiskManagerMemory::SlabDeleter::operator()(char *slab) const {
+  if (!borrowed_) {
+    std::free(slab);
+  }
+}
+
+DiskManagerMemory::DiskManagerMemory(bool compress)
+    : compress_(compress), root_(std::make_unique<std::atomic<Segment *>[]>(ROOT_SEGMENTS)) {}
+
+DiskManagerMemory::~DiskManagerMemory() {
+  for (size_t s = 0; s < ROOT_SEGMENTS; s++) {
+    Segment *segment = root_[s].load();
+    if (segment == nullptr) {
+      continue;
+    }
+    for (auto &chunk : segment->chunks_) {
+      delete chunk.load();
+    }
+    delete segment;
+  }
+#ifndef _WIN32
+  if (image_ != nullptr) {
+    ::munmap(image_, image_size_);
+  }
+#endif
+}
+
+auto DiskManagerMemory::GetChunk(page_id_t page_id) -> Chunk & {
+  size_t index = CheckedIndex(page_id);
+  Segment *segment = InstallOnce(root_[index / SEGMENT_PAGES]);
+  return *InstallOnce(segment->chunks_[index % SEGMENT_PAGES / CHUNK_PAGES]);
+}
+
+auto DiskManagerMemory::FindChunk(page_id_t page_id) const -> Chunk * {
+  size_t index = CheckedIndex(page_id);
+  Segment *segment = root_[index / SEGMENT_PAGES].load(std::memory_order_acquire);
+  if (segment == nullptr) {
+    return nullptr;
+  }
+  return segment->chunks_[index % SEGMENT_PAGES / CHUNK_PAGES].load(std::memory_order_acquire);
+}
+
+auto DiskManagerMemory::Materialize(Chunk &chunk, size_t slot) -> bool {
+  if (chunk.present_[slot]) {
+    return false;
+  }
+  if (!compress_ && chunk.slab_ == nullptr) {
+    // calloc'd slabs this large come straight from the OS, so untouched pages cost no memory
+    chunk.slab_.reset(static_cast<char *>(std::calloc(CHUNK_PAGES, PAGE_SIZE)));
+    if (!compress_ && chunk.slab_ == nullptr) {
+      throw std::bad_alloc();
+    }
+    num_chunks_.fetch_add(1, std::memory_order_relaxed);
+  }
+  chunk.present_[slot] = true;
+  num_pages_.fetch_add(1, std::memory_order_relaxed);
+  return true;
+}
+
 auto DiskManagerMemory::AllocatePage(page_id_t page_id) -> page_id_t {
-  if(pages_.find(page_id) != pages_.end()) {
+  Chunk &chunk = GetChunk(page_id);
+  std::unique_lock lock(chunk.latch_);
+  size_t slot = static_cast<size_t>(page_id) % CHUNK_PAGES;
+  if (!Materialize(chunk, slot)) {
     throw std::runtime_error("Page ID already allocated");
   }
-  pages_[page_id] = {};
+  // the slot may still hold a deallocated page
+  if (!compress_) {
+    std::memset(chunk.Page(slot), 0, PAGE_SIZE);
+  }
   return page_id;
 }
 
 void DiskManagerMemory::DeallocatePage(page_id_t page_id) {
-  pages_.erase(page_id);
+  Chunk *chunk = FindChunk(page_id);
+  if (chunk == nullptr) {
+    return;
+  }
+  size_t slot = static_cast<size_t>(page_id) % CHUNK_PAGES;
+  Blob freed{nullptr, 0};
+  {
+    std::unique_lock lock(chunk->latch_);
+    if (chunk->present_[slot]) {
+      // the slab keeps its memory; the slot reads as zeros again until rewritten
+      chunk->present_[slot] = false;
+      freed = {chunk->blobs_[slot], chunk->blob_sizes_[slot]};
+      chunk->blobs_[slot] = nullptr;
+      chunk->blob_sizes_[slot] = 0;
+      num_pages_.fetch_sub(1, std::memory_order_relaxed);
+    }
+  }
+  Release(freed);
+}
+
+void DiskManagerMemory::CopyOut(Chunk &chunk, size_t slot, char *out_buf) const {
+  if (!chunk.present_[slot]) {
+    std::memset(out_buf, 0, PAGE_SIZE);
+  } else if (compress_) {
+    PageCodec::Decompress(chunk.blobs_[slot], chunk.blob_sizes_[slot], out_buf);
+  } else {
+    std::memcpy(out_buf, chunk.Page(slot), PAGE_SIZE);
+  }
+}
+
+auto DiskManagerMemory::Encode(const char *buf) -> Blob {
+  thread_local std::array<char, PageCodec::MAX_ENCODED_SIZE> scratch;
+  size_t size = PageCodec::Compress(buf, scratch.data());
+  if (size == 0) {
+    return {nullptr, 0};
+  }
+  char *data = blob_allocator_.Allocate(size);
+  std::memcpy(data, scratch.data(), size);
+  return {data, size};
+}
+
+void DiskManagerMemory::Release(Blob blob) {
+  if (blob.data_ != nullptr) {
+    blob_allocator_.Free(blob.data_, blob.size_);
+  }
+}
+
+auto DiskManagerMemory::Store(Chunk &chunk, size_t slot, const char *buf, Blob blob) -> Blob {
+  Materialize(chunk, slot);
+  if (!compress_) {
+    std::memcpy(chunk.Page(slot), buf, PAGE_SIZE);
+    return {nullptr, 0};
+  }
+  Blob old{chunk.blobs_[slot], chunk.blob_sizes_[slot]};
+  chunk.blobs_[slot] = blob.data_;
+  chunk.blob_sizes_[slot] = static_cast<uint16_t>(blob.size_);
+  return old;
 }
 
 void DiskManagerMemory::ReadPage(page_id_t page_id, char *out_buf) {
-  do{
-  std::shared_lock lock(latch_);
-  auto it = pages_.find(page_id);
-  if (it == pages_.end()) break;
-  std::memcpy(out_buf, it->second.data(), PAGE_SIZE);
-  return;
-  } while(false);
-  std::unique_lock lock(latch_);
-  auto it = pages_.find(page_id);
-  if (it == pages_.end()) {
-    AllocatePage(page_id);
-    it = pages_.find(page_id);
-  }
-  std::memcpy(out_buf, it->second.data(), PAGE_SIZE);
+  Chunk *chunk = FindChunk(page_id);
+  if (chunk == nullptr) {
+    std::memset(out_buf, 0, PAGE_SIZE);
+    return;
+  }
+  std::shared_lock lock(chunk->latch_);
+  CopyOut(*chunk, static_cast<size_t>(page_id) % CHUNK_PAGES, out_buf);
 }
 
 void DiskManagerMemory::WritePage(page_id_t page_id, const char *buf) {
-  std::unique_lock lock(latch_);
-  auto it = pages_.find(page_id);
-  if (it == pages_.end()) {
-    AllocatePage(page_id);
-    it = pages_.find(page_id);
+  Chunk &chunk = GetChunk(page_id);
+  size_t slot = static_cast<size_t>(page_id) % CHUNK_PAGES;
+  Blob blob = compress_ ? Encode(buf) : Blob{nullptr, 0};
+  Blob old;
+  {
+    std::unique_lock lock(chunk.latch_);
+    old = Store(chunk, slot, buf, blob);
+  }
+  Release(old);
+}
+
+void DiskManagerMemory::ReadPages(page_id_t first_page_id, char *const *out_bufs, size_t count) {
+  size_t done = 0;
+  while (done < count) {
+    page_id_t page_id = first_page_id + static_cast<page_id_t>(done);
+    Chunk *chunk = FindChunk(page_id);
+    size_t slot = static_cast<size_t>(page_id) % CHUNK_PAGES;
+    size_t n = std::min(count - done, CHUNK_PAGES - slot);
+    if (chunk == nullptr) {
+      for (size_t i = 0; i < n; i++) {
+        std::memset(out_bufs[done + i], 0, PAGE_SIZE);
+      }
+    } else {
+      std::shared_lock lock(chunk->latch_);
+      for (size_t i = 0; i < n; i++) {
+        CopyOut(*chunk, slot + i, out_bufs[done + i]);
+      }
+    }
+    done += n;
+  }
+}
+
+void DiskManagerMemory::WritePages(page_id_t first_page_id, const char *const *bufs, size_t count) {
+  size_t done = 0;
+  while (done < count) {
+    page_id_t page_id = first_page_id + static_cast<page_id_t>(done);
+    Chunk &chunk = GetChunk(page_id);
+    size_t slot = static_cast<size_t>(page_id) % CHUNK_PAGES;
+    size_t n = std::min(count - done, CHUNK_PAGES - slot);
+    // encode outside the latch, swap under it, free the replaced blobs after it
+    std::array<Blob, CHUNK_PAGES> blobs{};
+    if (compress_) {
+      for (size_t i = 0; i < n; i++) {
+        blobs[i] = Encode(bufs[done + i]);
+      }
+    }
+    {
+      std::unique_lock lock(chunk.latch_);
+      for (size_t i = 0; i < n; i++) {
+        blobs[i] = Store(chunk, slot + i, bufs[done + i], blobs[i]);
+      }
+    }
+    for (size_t i = 0; i < n; i++) {
+      Release(blobs[i]);
+    }
+    done += n;
+  }
+}
+
+auto DiskManagerMemory::NumPages() const -> size_t { return num_pages_.load(); }
+
+auto DiskManagerMemory::GetPageIdLimit() const -> page_id_t {
+  for (size_t s = ROOT_SEGMENTS; s-- > 0;) {
+    Segment *segment = root_[s].load(std::memory_order_acquire);
+    if (segment == nullptr) {
+      continue;
+    }
+    for (size_t c = SEGMENT_CHUNKS; c-- > 0;) {
+      Chunk *chunk = segment->chunks_[c].load(std::memory_order_acquire);
+      if (chunk == nullptr) {
+        continue;
+      }
+      std::shared_lock lock(chunk->latch_);
+      for (size_t slot = CHUNK_PAGES; slot-- > 0;) {
+        if (chunk->present_[slot]) {
+          return static_cast<page_id_t>(s * SEGMENT_PAGES + c * CHUNK_PAGES + slot + 1);
+        }
+      }
+    }
+  }
+  return 0;
+}
+
+void DiskManagerMemory::SaveImage(const std::string &path) const {
+  uint64_t num_chunks = (static_cast<uint64_t>(GetPageIdLimit()) + CHUNK_PAGES - 1) / CHUNK_PAGES;
+  std::vector<ChunkMask> masks(num_chunks);
+  std::string tmp = path + ".tmp";
+  std::FILE *file = std::fopen(tmp.c_str(), "wb");
+  if (file == nullptr) {
+    throw std::runtime_error("cannot write image " + tmp);
+  }
+  // pages are copied out under the chunk latch and written after releasing it
+  std::unique_ptr<char[]> staging(new char[CHUNK_BYTES]);
+  bool ok = true;
+  for (uint64_t c = 0; c < num_chunks && ok; c++) {
+    Chunk *chunk = FindChunk(static_cast<page_id_t>(c * CHUNK_PAGES));
+    if (chunk == nullptr) {
+      continue;
+    }
+    bool any = false;
+    {
+      std::shared_lock lock(chunk->latch_);
+      for (size_t slot = 0; slot < CHUNK_PAGES; slot++) {
+        if (chunk->present_[slot]) {
+          masks[c][slot / 8] |= static_cast<uint8_t>(1U << (slot % 8));
+          any = true;
+        }
+        CopyOut(*chunk, slot, staging.get() + slot * PAGE_SIZE);
+      }
+    }
+    if (any) {
+      ok = std::fseek(file, static_cast<long>(ChunkOffset(num_chunks, c)), SEEK_SET) == 0 &&
+           std::fwrite(staging.get(), 1, CHUNK_BYTES, file) == CHUNK_BYTES;
+    }
+  }
+  ImageHeader header{};
+  std::memcpy(header.magic_, IMAGE_MAGIC, sizeof(IMAGE_MAGIC));
+  header.page_size_ = PAGE_SIZE;
+  header.chunk_pages_ = CHUNK_PAGES;
+  header.num_chunks_ = num_chunks;
+  ok = ok && std::fseek(file, 0, SEEK_SET) == 0 && std::fwrite(&header, sizeof(header), 1, file) == 1 &&
+       std::fwrite(masks.data(), sizeof(ChunkMask), masks.size(), file) == masks.size();
+  ok = std::fclose(file) == 0 && ok;
+  // replace atomically so a crash leaves either the old or the new image
+  if (!ok || std::rename(tmp.c_str(), path.c_str()) != 0) {
+    std::remove(tmp.c_str());
+    throw std::runtime_error("cannot write image " + path);
+  }
+}
+
+void DiskManagerMemory::LoadImage(const std::string &path, bool use_mmap) {
+  if (num_pages_.load() != 0 || num_chunks_.load() != 0 || image_ != nullptr) {
+    throw std::runtime_error("LoadImage needs an empty disk manager");
   }
-  std::memcpy(it->second.data(), buf, PAGE_SIZE);
+  std::FILE *file = std::fopen(path.c_str(), "rb");
+  if (file == nullptr) {
+    throw std::runtime_error("cannot open image " + path);
+  }
+  std::unique_ptr<std::FILE, int (*)(std::FILE *)> closer(file, &std::fclose);
+  ImageHeader header{};
+  if (std::fread(&header, sizeof(header), 1, file) != 1 ||
+      std::memcmp(header.magic_, IMAGE_MAGIC, sizeof(IMAGE_MAGIC)) != 0 || header.page_size_ != PAGE_SIZE ||
+      header.chunk_pages_ != CHUNK_PAGES) {
+    throw std::runtime_error(path + " is not a page image of this build");
+  }
+  uint64_t num_chunks = header.num_chunks_;
+  std::vector<ChunkMask> masks(num_chunks);
+  if (std::fread(masks.data(), sizeof(ChunkMask), masks.size(), file) != masks.size()) {
+    throw std::runtime_error("truncated image " + path);
+  }
+
+  char *mapped = nullptr;
+#ifndef _WIN32
+  if (use_mmap && !compress_ && num_chunks != 0) {
+    std::fseek(file, 0, SEEK_END);
+    auto size = static_cast<size_t>(std::ftell(file));
+    void *base = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fileno(file), 0);
+    if (base == MAP_FAILED) {
+      throw std::runtime_error("cannot map image " + path);
+    }
+    // start reading the whole image in the background
+    ::madvise(base, size, MADV_WILLNEED);
+    image_ = base;
+    image_size_ = size;
+    mapped = static_cast<char *>(base);
+  }
+#endif
+
+  std::unique_ptr<char[]> staging(compress_ ? new char[CHUNK_BYTES] : nullptr);
+  for (uint64_t c = 0; c < num_chunks; c++) {
+    size_t present = 0;
+    for (uint8_t bits : masks[c]) {
+      present += static_cast<size_t>(std::popcount(bits));
+    }
+    if (present == 0) {
+      continue;
+    }
+    uint64_t offset = ChunkOffset(num_chunks, c);
+    auto page_id = static_cast<page_id_t>(c * CHUNK_PAGES);
+    Chunk &chunk = GetChunk(page_id);
+    std::unique_lock lock(chunk.latch_);
+    auto is_present = [&](size_t slot) { return (masks[c][slot / 8] >> (slot % 8) & 1) != 0; };
+    if (mapped != nullptr) {
+      if (offset + CHUNK_BYTES > image_size_) {
+        throw std::runtime_error("truncated image " + path);
+      }
+      chunk.slab_ = std::unique_ptr<char, SlabDeleter>(mapped + offset, SlabDeleter{true});
+    } else {
+      char *dest = compress_ ? staging.get() : static_cast<char *>(std::malloc(CHUNK_BYTES));
+      if (dest == nullptr) {
+        throw std::bad_alloc();
+      }
+      if (!compress_) {
+        chunk.slab_ = std::unique_ptr<char, SlabDeleter>(dest, SlabDeleter{});
+      }
+      if (std::fseek(file, static_cast<long>(offset), SEEK_SET) != 0 ||
+          std::fread(dest, 1, CHUNK_BYTES, file) != CHUNK_BYTES) {
+        throw std::runtime_error("truncated image " + path);
+      }
+    }
+    if (compress_) {
+      for (size_t slot = 0; slot < CHUNK_PAGES; slot++) {
+        if (is_present(slot)) {
+          const char *page = staging.get() + slot * PAGE_SIZE;
+          Store(chunk, slot, page, Encode(page));
+        }
+      }
+      continue;
+    }
+    for (size_t slot = 0; slot < CHUNK_PAGES; slot++) {
+      chunk.present_[slot] = is_present(slot);
+    }
+    num_pages_.fetch_add(present, std::memory_order_relaxed);
+    num_chunks_.fetch_add(1, std::memory_order_relaxed);
+  }
+}
+
+auto DiskManagerMemory::GetStoredBytes() const -> size_t {
+  return compress_ ? blob_allocator_.GetAllocatedBytes() : num_chunks_.load() * CHUNK_PAGES * PAGE_SIZE;
 }
 
-auto DiskManagerMemory::NumPages() const -> size_t {
-  std::shared_lock lock(latch_);
-  return pages_.size();
+auto DiskManagerMemory::GetCompressionRatio() const -> double {
+  size_t stored = GetStoredBytes();
+  double logical = static_cast<double>(num_pages_.load()) * PAGE_SIZE;
+  // only zero pages stored: report the logical size against a single byte
+  return logical / static_cast<double>(std::max<size_t>(stored, 1));
 }
 
-}  // namespace bicycletub
\ No newline at end of file
+}  // namespace bicycletub
@@ -0,0 +1,147 @@
+#include "disk_manager_mmap.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+namespace bicycletub {
+
+namespace {
+[[noreturn]] void ThrowErrno(const std::string &what) {
+  throw std::runtime_error(what + ": " + std::strerror(errno));
+}
+}  // namespace
+
+DiskManagerMmap::DiskManagerMmap(const std::string &path, bool zero_copy, size_t reserve_pages)
+    : path_(path), zero_copy_(zero_copy), reserve_pages_(reserve_pages) {
+  fd_ = ::open(path_.c_str(), O_RDWR | O_CREAT, 0644);
+  if (fd_ < 0) {
+    ThrowErrno("open " + path_);
+  }
+  struct stat st {};
+  if (::fstat(fd_, &st) != 0) {
+    ::close(fd_);
+    ThrowErrno("fstat " + path_);
+  }
+  auto pages = static_cast<page_id_t>((st.st_size + PAGE_SIZE - 1) / PAGE_SIZE);
+  reserve_pages_ = std::max(reserve_pages_, static_cast<size_t>(pages));
+  // mapping past the end of the file is fine as long as nothing touches it before Grow
+  void *base = ::mmap(nullptr, reserve_pages_ * PAGE_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+  if (base == MAP_FAILED) {
+    ::close(fd_);
+    ThrowErrno("mmap " + path_);
+  }
+  base_ = static_cast<char *>(base);
+  file_pages_.store(pages);
+  num_pages_.store(pages);
+}
+
+DiskManagerMmap::~DiskManagerMmap() {
+  page_id_t written = num_pages_.load();
+  ::msync(base_, static_cast<size_t>(written) * PAGE_SIZE, MS_SYNC);
+  ::munmap(base_, reserve_pages_ * PAGE_SIZE);
+  // drop the unused tail of the last growth step so NumPages is exact after reopening
+  if (written < file_pages_.load()) {
+    [[maybe_unused]] int rc = ::ftruncate(fd_, static_cast<off_t>(written) * PAGE_SIZE);
+  }
+  ::close(fd_);
+}
+
+void DiskManagerMmap::Grow(page_id_t end_page_id) {
+  if (end_page_id <= file_pages_.load(std::memory_order_acquire)) {
+    return;
+  }
+  if (static_cast<size_t>(end_page_id) > reserve_pages_) {
+    throw std::runtime_error("page " + std::to_string(end_page_id - 1) + " is beyond the mapping of " + path_);
+  }
+  std::lock_guard<std::mutex> lk(grow_latch_);
+  page_id_t current = file_pages_.load();
+  if (end_page_id <= current) {
+    return;
+  }
+  auto target = static_cast<page_id_t>(
+      std::min(reserve_pages_, (static_cast<size_t>(end_page_id) + GROW_PAGES - 1) / GROW_PAGES * GROW_PAGES));
+  // allocate the blocks now: a full disk must fail here rather than raise SIGBUS on a store
+  int rc = ::posix_fallocate(fd_, static_cast<off_t>(current) * PAGE_SIZE,
+                             static_cast<off_t>(target - current) * PAGE_SIZE);
+  if (rc == EOPNOTSUPP || rc == EINVAL) {
+    rc = ::ftruncate(fd_, static_cast<off_t>(target) * PAGE_SIZE) == 0 ? 0 : errno;
+  }
+  if (rc != 0) {
+    errno = rc;
+    ThrowErrno("grow " + path_);
+  }
+  file_pages_.store(target, std::memory_order_release);
+}
+
+void DiskManagerMmap::ReadPage(page_id_t page_id, char *out_buf) {
+  if (page_id >= file_pages_.load(std::memory_order_acquire)) {
+    std::memset(out_buf, 0, PAGE_SIZE);
+    return;
+  }
+  std::memcpy(out_buf, PageAddress(page_id), PAGE_SIZE);
+}
+
+void DiskManagerMmap::WritePage(page_id_t page_id, const char *buf) {
+  Grow(page_id + 1);
+  char *target = PageAddress(page_id);
+  if (target != buf) {
+    std::memcpy(target, buf, PAGE_SIZE);
+  }
+  page_id_t seen = num_pages_.load(std::memory_order_relaxed);
+  while (seen < page_id + 1 && !num_pages_.compare_exchange_weak(seen, page_id + 1)) {
+  }
+}
+
+void DiskManagerMmap::DeallocatePage(page_id_t page_id) {
+  if (page_id >= file_pages_.load(std::memory_order_acquire)) {
+    return;
+  }
+#ifdef __linux__
+  ::fallocate(fd_, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, static_cast<off_t>(page_id) * PAGE_SIZE, PAGE_SIZE);
+#endif
+}
+
+void DiskManagerMmap::Sync() {
+  if (::msync(base_, static_cast<size_t>(num_pages_.load()) * PAGE_SIZE, MS_SYNC) != 0) {
+    ThrowErrno("msync " + path_);
+  }
+}
+
+auto DiskManagerMmap::NumPages() const -> size_t { return static_cast<size_t>(num_pages_.load()); }
+
+auto DiskManagerMmap::MappedPage(page_id_t page_id) -> const char * {
+  if (!zero_copy_ || page_id >= file_pages_.load(std::memory_order_acquire)) {
+    return nullptr;
+  }
+  return PageAddress(page_id);
+}
+
+void DiskManagerMmap::Advise(page_id_t first_page_id, size_t count, AccessHint hint) {
+  auto end = std::min(static_cast<size_t>(first_page_id) + count, static_cast<size_t>(file_pages_.load()));
+  if (first_page_id < 0 || static_cast<size_t>(first_page_id) >= end) {
+    return;
+  }
+  char *addr = PageAddress(first_page_id);
+  size_t len = (end - static_cast<size_t>(first_page_id)) * PAGE_SIZE;
+  switch (hint) {
+    case AccessHint::SEQUENTIAL:
+      ::madvise(addr, len, MADV_SEQUENTIAL);
+      ::madvise(addr, len, MADV_WILLNEED);
+      break;
+    case AccessHint::RANDOM:
+      ::madvise(addr, len, MADV_RANDOM);
+      break;
+    case AccessHint::NORMAL:
+      ::madvise(addr, len, MADV_NORMAL);
+      break;
+  }
+}
+
+}  // namespace bicycletub
@@ -1,17 +1,55 @@
 #include "disk_scheduler.h"
 
+#include <algorithm>
+#include <exception>
+
+#ifndef _WIN32
+#include "disk_manager_file.h"
+#include "io_uring_engine.h"
+#endif
+
 namespace bicycletub
 {
+DiskScheduler::DiskScheduler(DiskManager *disk_manager, bool use_io_uring) : disk_manager_(disk_manager) {
+#ifndef _WIN32
+  if (use_io_uring) {
+    if (auto *file = dynamic_cast<DiskManagerFile *>(disk_manager_); file != nullptr) {
+      engine_ = IoUringEngine::Create(file);
+    }
+  }
+#endif
+  background_thread_.emplace([&] { StartWorkerThread(); });
+}
+
 DiskScheduler::~DiskScheduler() {
-  request_queue_.Put(std::nullopt);
+  {
+    std::lock_guard<std::mutex> lk(queue_latch_);
+    stop_ = true;
+  }
+  queue_cv_.notify_all();
   if (background_thread_.has_value()) {
     background_thread_->join();
   }
 }
 
-void DiskScheduler::Schedule(std::vector<DiskRequest> &requests) {
+auto DiskScheduler::RegisterBuffers(std::span<char *const> buffers) -> bool {
+#ifndef _WIN32
+  if (engine_ != nullptr) {
+    return engine_->RegisterBuffers(buffers);
+  }
+#endif
+  return false;
+}
+
+void DiskScheduler::Schedule(std::span<DiskRequest> requests) {
+  {
+    std::lock_guard<std::mutex> lk(queue_latch_);
+    for (auto &request : requests) {
+      queues_[static_cast<size_t>(request.priority_)].push_back(request);
+    }
+  }
+  queue_cv_.notify_all();
   for (auto &request : requests) {
-    request_queue_.Put(std::make_optional(std::move(request)));
     if (request.is_write_) {
       scheduled_writes_.fetch_add(1, std::memory_order_relaxed);
     } else {
@@ -22,20 +60,104 @@ void DiskScheduler::Schedule(std::vector<DiskRequest> &requests) {
 }
 
 void DiskScheduler::StartWorkerThread() {
+  auto &foreground = queues_[static_cast<size_t>(DiskRequestPriority::FOREGROUND)];
+  auto &prefetch = queues_[static_cast<size_t>(DiskRequestPriority::PREFETCH)];
+  auto &background = queues_[static_cast<size_t>(DiskRequestPriority::BACKGROUND)];
+  std::vector<DiskRequest> urgent;
+  std::vector<DiskRequest> deferred;
   while (1) {
-    auto request = request_queue_.Get();
-    if (!request.has_value()) {
-      return;
+    urgent.clear();
+    deferred.clear();
+    {
+      std::unique_lock<std::mutex> lk(queue_latch_);
+      queue_cv_.wait(lk, [&]() { return stop_ || !foreground.empty() || !prefetch.empty() || !background.empty(); });
+      if (foreground.empty() && prefetch.empty() && background.empty()) {
+        // stop_ is set and everything queued before it has been served
+        return;
+      }
+      auto &high = !foreground.empty() ? foreground : prefetch;
+      urgent.assign(high.begin(), high.end());
+      high.clear();
+      // write-back only gets a small slice while reads are waiting, so it cannot starve them,
+      // but it always makes progress
+      size_t budget = urgent.empty() ? background_batch_ : background_budget_;
+      size_t take = std::min(budget, background.size());
+      deferred.assign(background.begin(), background.begin() + static_cast<std::ptrdiff_t>(take));
+      background.erase(background.begin(), background.begin() + static_cast<std::ptrdiff_t>(take));
     }
-    if (request->is_write_) {
-      disk_manager_->WritePage(request->page_id_, request->data_);
+    ProcessBatch(urgent);
+    ProcessBatch(deferred);
+  }
+  return;
+}
+
+void DiskScheduler::ProcessBatch(std::vector<DiskRequest> &batch) {
+  // elevator order; stable so requests on the same page keep their submission order
+  std::stable_sort(batch.begin(), batch.end(),
+                   [](const DiskRequest &a, const DiskRequest &b) { return a.page_id_ < b.page_id_; });
+#ifndef _WIN32
+  if (engine_ != nullptr && !engine_->IsBroken()) {
+    // the kernel queues every page itself, no need to build vectored runs
+    engine_->Process(batch);
+    return;
+  }
+#endif
+  size_t begin = 0;
+  while (begin < batch.size()) {
+    size_t end = begin + 1;
+    while (end < batch.size() && batch[end].is_write_ == batch[begin].is_write_ &&
+           batch[end].page_id_ == batch[end - 1].page_id_ + 1) {
+      end++;
+    }
+    auto &first = batch[begin];
+    size_t count = end - begin;
+    if (count == 1) {
+      Serve(first);
+      begin = end;
+      continue;
     }
-    else {
-      disk_manager_->ReadPage(request->page_id_, request->data_);
+    bool ok = true;
+    try {
+      run_bufs_.clear();
+      for (size_t i = begin; i < end; i++) {
+        run_bufs_.push_back(batch[i].data_);
+      }
+      if (first.is_write_) {
+        disk_manager_->WritePages(first.page_id_, run_bufs_.data(), count);
+      } else {
+        disk_manager_->ReadPages(first.page_id_, run_bufs_.data(), count);
+      }
+      coalesced_requests_.fetch_add(count, std::memory_order_relaxed);
+    } catch (const std::exception &) {
+      ok = false;
     }
-    request->callback_.set_value(true);
+    for (size_t i = begin; i < end; i++) {
+      if (ok) {
+        batch[i].callback_->Complete(true);
+      } else {
+        // find out which pages of the run failed, and how
+        Serve(batch[i]);
+      }
+    }
+    begin = end;
   }
-  return;
 }
-} // namespace bicycletub
 
+void DiskScheduler::Serve(DiskRequest &request) {
+  // a failing backend fails the request instead of taking the worker thread down
+  try {
+    if (request.is_write_) {
+      disk_manager_->WritePage(request.page_id_, request.data_);
+    } else {
+      disk_manager_->ReadPage(request.page_id_, request.data_);
+    }
+  } catch (const PageCorruptionError &) {
+    request.callback_->CompleteCorrupted();
+    return;
+  } catch (const std::exception &) {
+    request.callback_->Complete(false);
+    return;
+  }
+  request.callback_->Complete(true);
+}
+} // namespace bicycletub
@@ -1,5 +1,6 @@
 #include "index_iterator.h"
 #include "b_plus_tree_key.h"
+#include "buffer_pool_manager.h"
 #include <cassert>
 
 namespace bicycletub {
@@ -11,11 +12,50 @@ INDEX_TEMPLATE_ARGUMENTS
 INDEXITERATOR_TYPE::~IndexIterator() = default;
 
 INDEX_TEMPLATE_ARGUMENTS
-auto INDEXITERATOR_TYPE::IsEnd() -> bool {
-  auto page_guard = bpm_->ReadPage(page_id_);
-  // const BPlusTreeLeafPage *leaf_page = page_guard.As<BPlusTreeLeafPage>();
-  const B_PLUS_TREE_LEAF_PAGE_TYPE *leaf_page = page_guard.As<B_PLUS_TREE_LEAF_PAGE_TYPE>();
-  return leaf_page->next_page_id_ == INVALID_PAGE_ID && index_ == leaf_page->GetSize();
+INDEXITERATOR_TYPE::IndexIterator(ReadPageGuard guard, int index, BufferPoolManager *bpm, StepLeftFn step_left)
+    : guard_(std::move(guard)), index_(index), bpm_(bpm), step_left_(std::move(step_left)) {
+  leaf_ = guard_->As<LeafPage>();
+  page_id_ = guard_->GetPageId();
+  if(index_ < 0 && leaf_->GetSize() > 0) {
+    StepBack(leaf_->KeyAt(0));
+    return;
+  }
+  Settle();
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+void INDEXITERATOR_TYPE::Settle() {
+  while(index_ >= leaf_->GetSize()) {
+    page_id_t next_page_id = leaf_->GetNextPageId();
+    if(next_page_id == INVALID_PAGE_ID) {
+      // the end
+      leaf_ = nullptr;
+      guard_ = std::nullopt;
+      return;
+    }
+    // latch the next leaf before letting go of this one
+    ReadPageGuard next = bpm_->ReadPage(next_page_id);
+    guard_ = std::move(next);
+    leaf_ = guard_->As<LeafPage>();
+    page_id_ = next_page_id;
+    index_ = 0;
+  }
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+void INDEXITERATOR_TYPE::StepBack(const KeyType &bound) {
+  ReadPageGuard guard = std::move(*guard_);
+  guard_ = std::nullopt;
+  leaf_ = nullptr;
+  auto left = step_left_(std::move(guard), bound);
+  if(!left.has_value()) {
+    // stepped back from the first entry: the end
+    return;
+  }
+  guard_ = std::move(left->first);
+  leaf_ = guard_->As<LeafPage>();
+  page_id_ = guard_->GetPageId();
+  index_ = left->second;
 }
 
 INDEX_TEMPLATE_ARGUMENTS
@@ -23,15 +63,9 @@ auto INDEXITERATOR_TYPE::operator*() -> std::pair<const KeyType &, const ValueTy
   if(IsEnd()){
     throw std::out_of_range("Iterator out of range");
   }
-  auto page_guard = bpm_->ReadPage(page_id_);
-  // const LeafPage *leaf_page = page_guard.As<LeafPage>();
-  const B_PLUS_TREE_LEAF_PAGE_TYPE *leaf_page = page_guard.As<B_PLUS_TREE_LEAF_PAGE_TYPE>();
-  if(index_ < 0 || index_ >= leaf_page->GetSize()){
-    throw std::out_of_range("Index out of range");
-  }
   // Return references to the key and value stored in the leaf page.
   // We avoid KeyAt() here because it returns by value; we need references.
-  return {leaf_page->key_array_[index_], leaf_page->rid_array_[index_]};
+  return {leaf_->key_array_[index_], leaf_->rid_array_[index_]};
 }
 
 INDEX_TEMPLATE_ARGUMENTS
@@ -39,17 +73,21 @@ auto INDEXITERATOR_TYPE::operator++() -> INDEXITERATOR_TYPE & {
   if(IsEnd()){
     throw std::out_of_range("Incrementing past the end of the index iterator");
   }
-  auto page_guard = bpm_->ReadPage(page_id_);
-  // const LeafPage *leaf_page = page_guard.As<LeafPage>();
-  const B_PLUS_TREE_LEAF_PAGE_TYPE *leaf_page = page_guard.As<B_PLUS_TREE_LEAF_PAGE_TYPE>();
-  if(index_ < 0 || index_ > leaf_page->GetSize()){
-    throw std::out_of_range("Index out of range");
-  }
   index_++;
-  if(index_ == leaf_page->GetSize() && leaf_page->next_page_id_ != INVALID_PAGE_ID){
-    page_id_ = leaf_page->next_page_id_;
-    index_ = 0;
+  Settle();
+  return *this;
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+auto INDEXITERATOR_TYPE::operator--() -> INDEXITERATOR_TYPE & {
+  if(IsEnd()){
+    throw std::out_of_range("Decrementing an index iterator at the end");
+  }
+  if(index_ > 0) {
+    index_--;
+    return *this;
   }
+  StepBack(leaf_->KeyAt(0));
   return *this;
 }
 
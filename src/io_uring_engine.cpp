@@ -0,0 +1,279 @@
+#include "io_uring_engine.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <exception>
+#include <vector>
+
+#include "disk_manager_file.h"
+#include "disk_scheduler.h"
+
+#if __has_include(<linux/io_uring.h>)
+#define BICY_HAS_IO_URING 1
+#include <linux/io_uring.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+
+namespace bicycletub {
+
+#ifdef BICY_HAS_IO_URING
+
+namespace {
+// the kernel limits a registration to this many buffers
+constexpr size_t MAX_FIXED_BUFFERS = 1U << 14;
+
+auto IsAligned(const void *ptr) -> bool { return reinterpret_cast<uintptr_t>(ptr) % PAGE_SIZE == 0; }
+
+template <typename T>
+auto RingField(void *ring, uint32_t offset) -> T * {
+  return reinterpret_cast<T *>(static_cast<char *>(ring) + offset);
+}
+}  // namespace
+
+auto IoUringEngine::Create(DiskManagerFile *disk, unsigned queue_depth) -> std::unique_ptr<IoUringEngine> {
+  io_uring_params params{};
+  int fd = static_cast<int>(::syscall(__NR_io_uring_setup, queue_depth, &params));
+  if (fd < 0) {
+    return nullptr;
+  }
+  std::unique_ptr<IoUringEngine> engine(new IoUringEngine(disk, fd));
+  if (!engine->Setup(params)) {
+    return nullptr;
+  }
+  return engine;
+}
+
+IoUringEngine::IoUringEngine(DiskManagerFile *disk, int ring_fd)
+    : disk_(disk), ring_fd_(ring_fd), direct_io_(disk->IsDirectIO()) {}
+
+IoUringEngine::~IoUringEngine() {
+  if (sqes_ != nullptr) {
+    ::munmap(sqes_, sqes_size_);
+  }
+  if (cq_ring_ != nullptr && cq_ring_ != sq_ring_) {
+    ::munmap(cq_ring_, cq_ring_size_);
+  }
+  if (sq_ring_ != nullptr) {
+    ::munmap(sq_ring_, sq_ring_size_);
+  }
+  ::close(ring_fd_);
+}
+
+auto IoUringEngine::Setup(const io_uring_params &params) -> bool {
+  sq_entries_ = params.sq_entries;
+  sq_ring_size_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+  cq_ring_size_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+  bool single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+  if (single_mmap) {
+    sq_ring_size_ = cq_ring_size_ = std::max(sq_ring_size_, cq_ring_size_);
+  }
+  void *sq = ::mmap(nullptr, sq_ring_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd_,
+                    IORING_OFF_SQ_RING);
+  if (sq == MAP_FAILED) {
+    return false;
+  }
+  sq_ring_ = sq;
+  if (single_mmap) {
+    cq_ring_ = sq_ring_;
+  } else {
+    void *cq = ::mmap(nullptr, cq_ring_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd_,
+                      IORING_OFF_CQ_RING);
+    if (cq == MAP_FAILED) {
+      return false;
+    }
+    cq_ring_ = cq;
+  }
+  sqes_size_ = params.sq_entries * sizeof(io_uring_sqe);
+  void *sqes = ::mmap(nullptr, sqes_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd_,
+                      IORING_OFF_SQES);
+  if (sqes == MAP_FAILED) {
+    return false;
+  }
+  sqes_ = sqes;
+
+  sq_head_ = RingField<unsigned>(sq_ring_, params.sq_off.head);
+  sq_tail_ = RingField<unsigned>(sq_ring_, params.sq_off.tail);
+  sq_mask_ = *RingField<unsigned>(sq_ring_, params.sq_off.ring_mask);
+  sq_array_ = RingField<unsigned>(sq_ring_, params.sq_off.array);
+  cq_head_ = RingField<unsigned>(cq_ring_, params.cq_off.head);
+  cq_tail_ = RingField<unsigned>(cq_ring_, params.cq_off.tail);
+  cq_mask_ = *RingField<unsigned>(cq_ring_, params.cq_off.ring_mask);
+  cqes_ = RingField<io_uring_cqe>(cq_ring_, params.cq_off.cqes);
+  return true;
+}
+
+auto IoUringEngine::RegisterBuffers(std::span<char *const> buffers) -> bool {
+  if (!fixed_buffers_.empty()) {
+    ::syscall(__NR_io_uring_register, ring_fd_, IORING_UNREGISTER_BUFFERS, nullptr, 0);
+    fixed_buffers_.clear();
+  }
+  size_t count = std::min(buffers.size(), MAX_FIXED_BUFFERS);
+  if (count == 0) {
+    return true;
+  }
+  std::vector<iovec> iovs(count);
+  for (size_t i = 0; i < count; i++) {
+    iovs[i].iov_base = buffers[i];
+    iovs[i].iov_len = PAGE_SIZE;
+  }
+  if (::syscall(__NR_io_uring_register, ring_fd_, IORING_REGISTER_BUFFERS, iovs.data(),
+                static_cast<unsigned>(count)) != 0) {
+    return false;
+  }
+  for (size_t i = 0; i < count; i++) {
+    fixed_buffers_.emplace(buffers[i], static_cast<uint16_t>(i));
+  }
+  return true;
+}
+
+auto IoUringEngine::Enter(unsigned to_submit, bool wait) -> bool {
+  unsigned flags = wait ? IORING_ENTER_GETEVENTS : 0;
+  while (true) {
+    num_enters_++;
+    long ret = ::syscall(__NR_io_uring_enter, ring_fd_, to_submit, wait ? 1U : 0U, flags, nullptr, 0);
+    if (ret >= 0) {
+      return true;
+    }
+    if (errno == EINTR) {
+      continue;
+    }
+    // EAGAIN/EBUSY: completions have to be reaped first, the caller does that and comes back
+    return errno == EAGAIN || errno == EBUSY;
+  }
+}
+
+auto IoUringEngine::Reap(std::span<DiskRequest> batch) -> unsigned {
+  unsigned head = *cq_head_;
+  unsigned tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+  unsigned reaped = 0;
+  auto *cqes = static_cast<io_uring_cqe *>(cqes_);
+  while (head != tail) {
+    const io_uring_cqe &cqe = cqes[head & cq_mask_];
+    Finish(batch[cqe.user_data], cqe.res);
+    head++;
+    reaped++;
+  }
+  __atomic_store_n(cq_head_, head, __ATOMIC_RELEASE);
+  return reaped;
+}
+
+void IoUringEngine::ServeSynchronously(DiskRequest &request) {
+  bool ok = true;
+  try {
+    if (request.is_write_) {
+      disk_->WritePage(request.page_id_, request.data_);
+    } else {
+      disk_->ReadPage(request.page_id_, request.data_);
+    }
+  } catch (const std::exception &) {
+    ok = false;
+  }
+  request.callback_->Complete(ok);
+}
+
+void IoUringEngine::Finish(DiskRequest &request, int32_t result) {
+  if (result != static_cast<int32_t>(PAGE_SIZE)) {
+    // end of file, short transfer or error: the synchronous path zero-fills or reports it
+    ServeSynchronously(request);
+    return;
+  }
+  if (request.is_write_) {
+    disk_->NoteWrites(request.page_id_ + 1, 1);
+  }
+  request.callback_->Complete(true);
+}
+
+void IoUringEngine::Process(std::span<DiskRequest> batch) {
+  auto *sqes = static_cast<io_uring_sqe *>(sqes_);
+  size_t next = 0;
+  unsigned queued = 0;
+  unsigned inflight = 0;
+  while (next < batch.size() || inflight > 0) {
+    // fill the submission queue; in-flight requests never exceed its size so the CQ cannot overflow
+    unsigned tail = *sq_tail_;
+    bool blocked = false;
+    while (next < batch.size() && inflight < sq_entries_) {
+      auto &request = batch[next];
+      if (broken_ || (direct_io_ && !IsAligned(request.data_))) {
+        if (inflight > 0 && batch[next - 1].page_id_ == request.page_id_) {
+          // keep per-page order: the earlier request on this page has to land first
+          blocked = true;
+          break;
+        }
+        ServeSynchronously(request);
+        next++;
+        continue;
+      }
+      if (request.is_write_) {
+        disk_->Preallocate(request.page_id_ + 1);
+      }
+      unsigned index = tail & sq_mask_;
+      io_uring_sqe &sqe = sqes[index];
+      std::memset(&sqe, 0, sizeof(sqe));
+      auto fixed = fixed_buffers_.find(request.data_);
+      if (fixed != fixed_buffers_.end()) {
+        sqe.opcode = request.is_write_ ? IORING_OP_WRITE_FIXED : IORING_OP_READ_FIXED;
+        sqe.buf_index = fixed->second;
+        fixed_requests_++;
+      } else {
+        sqe.opcode = request.is_write_ ? IORING_OP_WRITE : IORING_OP_READ;
+      }
+      sqe.fd = disk_->GetFileDescriptor();
+      sqe.addr = reinterpret_cast<uint64_t>(request.data_);
+      sqe.len = PAGE_SIZE;
+      sqe.off = static_cast<uint64_t>(request.page_id_) * PAGE_SIZE;
+      sqe.user_data = next;
+      // the batch is sorted by page: a repeated page waits for everything before it
+      if (next > 0 && batch[next - 1].page_id_ == request.page_id_) {
+        sqe.flags = IOSQE_IO_DRAIN;
+      }
+      sq_array_[index] = index;
+      tail++;
+      queued++;
+      inflight++;
+      next++;
+    }
+    __atomic_store_n(sq_tail_, tail, __ATOMIC_RELEASE);
+
+    if (inflight == 0) {
+      continue;
+    }
+    // submit and wait in one call; only block when nothing more can be queued
+    bool wait = blocked || next == batch.size() || inflight == sq_entries_;
+    if (!broken_ && !Enter(queued, wait)) {
+      broken_ = true;
+      // the kernel did not consume these entries: take them back and serve them here
+      unsigned consumed = __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE);
+      for (unsigned pos = consumed; pos != tail; pos++) {
+        ServeSynchronously(batch[sqes[pos & sq_mask_].user_data]);
+        inflight--;
+      }
+      __atomic_store_n(sq_tail_, consumed, __ATOMIC_RELEASE);
+    }
+    queued = *sq_tail_ - __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE);
+    inflight -= Reap(batch);
+    if (broken_ && inflight > 0) {
+      // already submitted requests still complete; let the kernel run its task work
+      ::sched_yield();
+    }
+  }
+}
+
+#else
+
+auto IoUringEngine::Create(DiskManagerFile *, unsigned) -> std::unique_ptr<IoUringEngine> { return nullptr; }
+
+IoUringEngine::~IoUringEngine() = default;
+
+auto IoUringEngine::RegisterBuffers(std::span<char *const>) -> bool { return false; }
+
+void IoUringEngine::Process(std::span<DiskRequest>) {}
+
+#endif
+
+}  // namespace bicycletub
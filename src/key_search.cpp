@@ -0,0 +1,92 @@
+#include "key_search.h"
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define BICY_KEY_SEARCH_X86 1
+#include <immintrin.h>
+#endif
+
+namespace bicycletub {
+
+namespace {
+// the halving stops at this many keys; a window takes four SSE2 or two AVX2 compares
+constexpr int WINDOW = 16;
+
+// Halves [base, base + n) until at most window keys are left and returns how many. The
+// lower bound stays within [base, base + n], and base + n never moves past the array end.
+inline auto Narrow(const int32_t *&base, int n, int32_t key, int window) -> int {
+  while (n > window) {
+    int half = n / 2;
+    // a select, not a branch: which half is taken is what mispredicts in a plain search
+    base = base[half] < key ? base + half : base;
+    n -= half;
+  }
+  return n;
+}
+
+#ifdef BICY_KEY_SEARCH_X86
+// the window is sorted, so the keys below key in it are exactly the offset of the answer
+auto LowerBoundSse2(const int32_t *keys, int n, int32_t key) -> int {
+  const int32_t *base = keys;
+  n = Narrow(base, n, key, WINDOW);
+  const __m128i needle = _mm_set1_epi32(key);
+  int below = 0;
+  int i = 0;
+  for (; i + 4 <= n; i += 4) {
+    __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i *>(base + i));
+    below += __builtin_popcount(_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(needle, block))));
+  }
+  for (; i < n; i++) {
+    below += base[i] < key ? 1 : 0;
+  }
+  return static_cast<int>(base - keys) + below;
+}
+
+__attribute__((target("avx2"))) auto LowerBoundAvx2(const int32_t *keys, int n, int32_t key) -> int {
+  const int32_t *base = keys;
+  n = Narrow(base, n, key, WINDOW);
+  const __m256i needle = _mm256_set1_epi32(key);
+  int below = 0;
+  int i = 0;
+  for (; i + 8 <= n; i += 8) {
+    __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(base + i));
+    below += __builtin_popcount(_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(needle, block))));
+  }
+  for (; i < n; i++) {
+    below += base[i] < key ? 1 : 0;
+  }
+  return static_cast<int>(base - keys) + below;
+}
+
+const bool HAS_AVX2 = __builtin_cpu_supports("avx2");
+#endif
+}  // namespace
+
+auto LowerBoundInt32Portable(const int32_t *keys, int n, int32_t key) -> int {
+  if (n <= 0) {
+    return 0;
+  }
+  const int32_t *base = keys;
+  Narrow(base, n, key, 1);
+  return static_cast<int>(base - keys) + (*base < key ? 1 : 0);
+}
+
+auto LowerBoundInt32(const int32_t *keys, int n, int32_t key) -> int {
+#ifdef BICY_KEY_SEARCH_X86
+  if (HAS_AVX2) {
+    return LowerBoundAvx2(keys, n, key);
+  }
+  return LowerBoundSse2(keys, n, key);
+#else
+  return LowerBoundInt32Portable(keys, n, key);
+#endif
+}
+
+auto KeySearchIsVectorized() -> bool {
+#ifdef BICY_KEY_SEARCH_X86
+  return true;
+#else
+  return false;
+#endif
+}
+
+}  // namespace bicycletub
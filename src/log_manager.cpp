@@ -0,0 +1,310 @@
+#include "log_manager.h"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <stdexcept>
+
+#include "crc32c.h"
+#include "page_codec.h"
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace bicycletub {
+
+namespace {
+constexpr char LOG_MAGIC[8] = {'B', 'T', 'U', 'B', 'W', 'A', 'L', '1'};
+
+// First bytes of the log file. Records follow it; the first one has LSN begin_lsn_, so
+// LSNs keep growing when the log is restarted past a truncated prefix.
+struct LogFileHeader {
+  char magic_[8];
+  lsn_t begin_lsn_;
+};
+
+// The LSN is not covered: it is checked against the record's position instead, which
+// lets appenders checksum outside the latch.
+auto RecordChecksum(const LogRecordHeader &header, const char *payload, size_t size) -> uint32_t {
+  constexpr size_t covered = offsetof(LogRecordHeader, type_);
+  const auto *bytes = reinterpret_cast<const char *>(&header);
+  return Crc32c(payload, size, Crc32c(bytes + covered, sizeof(LogRecordHeader) - covered));
+}
+
+auto SyncFile(std::FILE *file) -> bool {
+  if (std::fflush(file) != 0) {
+    return false;
+  }
+#ifdef _WIN32
+  return ::_commit(::_fileno(file)) == 0;
+#else
+  return ::fdatasync(::fileno(file)) == 0;
+#endif
+}
+}  // namespace
+
+LogReader::LogReader(const std::string &path, lsn_t start_lsn) {
+  file_ = std::fopen(path.c_str(), "rb");
+  if (file_ == nullptr) {
+    return;  // no log yet
+  }
+  LogFileHeader header{};
+  size_t n = std::fread(&header, 1, sizeof(header), file_);
+  if (n == 0) {
+    return;  // created but never written
+  }
+  if (n != sizeof(header) || std::memcmp(header.magic_, LOG_MAGIC, sizeof(LOG_MAGIC)) != 0) {
+    std::fclose(file_);
+    file_ = nullptr;
+    throw std::runtime_error(path + " is not a log file");
+  }
+  begin_lsn_ = end_lsn_ = header.begin_lsn_;
+  std::error_code ec;
+  file_records_ = static_cast<lsn_t>(std::filesystem::file_size(path, ec)) - static_cast<lsn_t>(sizeof(header));
+  if (start_lsn != INVALID_LSN) {
+    if (start_lsn < begin_lsn_) {
+      std::fclose(file_);
+      file_ = nullptr;
+      throw std::runtime_error("LSN " + std::to_string(start_lsn) + " is no longer in " + path);
+    }
+    end_lsn_ = start_lsn;
+    std::fseek(file_, static_cast<long>(sizeof(header) + (start_lsn - begin_lsn_)), SEEK_SET);
+  }
+}
+
+LogReader::~LogReader() {
+  if (file_ != nullptr) {
+    std::fclose(file_);
+  }
+}
+
+auto LogReader::Next(LogRecord *record) -> bool {
+  if (file_ == nullptr) {
+    return false;
+  }
+  LogRecordHeader header;
+  if (std::fread(&header, sizeof(header), 1, file_) != 1 || header.lsn_ != end_lsn_ ||
+      header.size_ < sizeof(header)) {
+    return false;
+  }
+  size_t size = header.size_ - sizeof(header);
+  if (end_lsn_ - begin_lsn_ + static_cast<lsn_t>(header.size_) > file_records_) {
+    return false;
+  }
+  record->payload_.resize(size);
+  if ((size > 0 && std::fread(record->payload_.data(), size, 1, file_) != 1) ||
+      RecordChecksum(header, record->payload_.data(), size) != header.checksum_) {
+    return false;
+  }
+  record->lsn_ = header.lsn_;
+  record->type_ = header.type_;
+  record->page_id_ = header.page_id_;
+  end_lsn_ += header.size_;
+  return true;
+}
+
+LogManager::LogManager(std::string path, size_t buffer_size) : path_(std::move(path)), buffer_size_(buffer_size) {
+  lsn_t begin_lsn = 0;
+  {
+    LogReader reader(path_);
+    LogRecord record;
+    while (reader.Next(&record)) {
+    }
+    begin_lsn = reader.GetBeginLsn();
+    next_lsn_ = reader.GetEndLsn();
+  }
+  std::error_code ec;
+  if (std::filesystem::file_size(path_, ec) < sizeof(LogFileHeader) || ec) {
+    std::FILE *file = std::fopen(path_.c_str(), "wb");
+    LogFileHeader header{};
+    std::memcpy(header.magic_, LOG_MAGIC, sizeof(LOG_MAGIC));
+    header.begin_lsn_ = begin_lsn;
+    bool ok = file != nullptr && std::fwrite(&header, sizeof(header), 1, file) == 1 && SyncFile(file);
+    if (file == nullptr || std::fclose(file) != 0 || !ok) {
+      throw std::runtime_error("cannot create log " + path_);
+    }
+  } else {
+    // drop a torn tail, new records must directly follow the last intact one
+    std::filesystem::resize_file(path_, sizeof(LogFileHeader) + static_cast<uintmax_t>(next_lsn_ - begin_lsn));
+  }
+  file_ = std::fopen(path_.c_str(), "ab");
+  if (file_ == nullptr) {
+    throw std::runtime_error("cannot open log " + path_);
+  }
+  persistent_lsn_ = next_lsn_;
+  active_.reserve(buffer_size_);
+  flushing_.reserve(buffer_size_);
+  flusher_.emplace([this] { RunFlusher(); });
+}
+
+LogManager::~LogManager() {
+  {
+    std::scoped_lock lock(latch_);
+    stop_ = true;
+  }
+  flush_cv_.notify_one();
+  flusher_->join();
+  std::fclose(file_);
+}
+
+auto LogManager::Append(LogRecordType type, page_id_t page_id, const char *payload, size_t size) -> lsn_t {
+  LogRecordHeader header{};
+  header.size_ = static_cast<uint32_t>(sizeof(header) + size);
+  if (header.size_ > buffer_size_) {
+    throw std::invalid_argument("log record does not fit into the log buffer");
+  }
+  header.type_ = type;
+  header.page_id_ = page_id;
+  header.checksum_ = RecordChecksum(header, payload, size);
+
+  std::unique_lock lock(latch_);
+  while (active_.size() + header.size_ > buffer_size_) {
+    if (failed_) {
+      throw std::runtime_error("cannot write log " + path_);
+    }
+    // buffer full: wait for the flusher to take it
+    wanted_lsn_ = std::max(wanted_lsn_, next_lsn_ - 1);
+    flush_cv_.notify_one();
+    flushed_cv_.wait(lock);
+  }
+  header.lsn_ = next_lsn_;
+  const auto *bytes = reinterpret_cast<const char *>(&header);
+  active_.insert(active_.end(), bytes, bytes + sizeof(header));
+  active_.insert(active_.end(), payload, payload + size);
+  next_lsn_ += header.size_;
+  num_records_++;
+  return header.lsn_;
+}
+
+auto LogManager::AppendPageImage(page_id_t page_id, const char *page) -> lsn_t {
+  char encoded[PageCodec::MAX_ENCODED_SIZE];
+  size_t size = PageCodec::Compress(page, encoded);
+  return Append(LogRecordType::PAGE_IMAGE, page_id, encoded, size);
+}
+
+auto LogManager::AppendPageImages(std::span<const std::pair<page_id_t, const char *>> pages) -> lsn_t {
+  if (pages.size() == 1) {
+    return AppendPageImage(pages[0].first, pages[0].second);
+  }
+  std::vector<char> payload(pages.size() * (sizeof(MultiPageEntry) + PageCodec::MAX_ENCODED_SIZE));
+  size_t pos = 0;
+  for (const auto &[page_id, page] : pages) {
+    MultiPageEntry entry{page_id, 0};
+    entry.size_ = static_cast<uint32_t>(PageCodec::Compress(page, payload.data() + pos + sizeof(entry)));
+    std::memcpy(payload.data() + pos, &entry, sizeof(entry));
+    pos += sizeof(entry) + entry.size_;
+  }
+  return Append(LogRecordType::MULTI_PAGE_IMAGE, INVALID_PAGE_ID, payload.data(), pos);
+}
+
+auto LogManager::Commit() -> lsn_t {
+  lsn_t lsn = Append(LogRecordType::COMMIT, INVALID_PAGE_ID, nullptr, 0);
+  Flush(lsn);
+  return lsn;
+}
+
+void LogManager::Flush(lsn_t lsn) {
+  if (lsn == INVALID_LSN) {
+    return;
+  }
+  std::unique_lock lock(latch_);
+  while (persistent_lsn_ <= lsn) {
+    if (failed_) {
+      throw std::runtime_error("cannot write log " + path_);
+    }
+    wanted_lsn_ = std::max(wanted_lsn_, lsn);
+    flush_cv_.notify_one();
+    flushed_cv_.wait(lock);
+  }
+}
+
+// Everything appended while a sync runs goes out with the next one: the waiters of a
+// whole round share a single fdatasync.
+void LogManager::RunFlusher() {
+  std::unique_lock lock(latch_);
+  while (true) {
+    flush_cv_.wait(lock, [&] { return stop_ || wanted_lsn_ >= persistent_lsn_; });
+    if (active_.empty() || failed_) {
+      if (stop_) {
+        break;
+      }
+      wanted_lsn_ = INVALID_LSN;
+      flushed_cv_.notify_all();
+      continue;
+    }
+    active_.swap(flushing_);
+    lsn_t end = next_lsn_;
+    lock.unlock();
+    // appenders may fill the other buffer meanwhile
+    flushed_cv_.notify_all();
+    bool ok = std::fwrite(flushing_.data(), 1, flushing_.size(), file_) == flushing_.size() && SyncFile(file_);
+    flushing_.clear();
+    lock.lock();
+    if (ok) {
+      persistent_lsn_ = end;
+    } else {
+      // the log cannot be trusted past this point, everyone waiting has to fail
+      failed_ = true;
+    }
+    num_syncs_++;
+    flushed_cv_.notify_all();
+  }
+}
+
+auto LogManager::GetPersistentLsn() const -> lsn_t {
+  std::scoped_lock lock(latch_);
+  return persistent_lsn_;
+}
+
+auto LogManager::GetNextLsn() const -> lsn_t {
+  std::scoped_lock lock(latch_);
+  return next_lsn_;
+}
+
+auto LogManager::GetNumSyncs() const -> uint64_t {
+  std::scoped_lock lock(latch_);
+  return num_syncs_;
+}
+
+auto LogManager::GetNumRecords() const -> uint64_t {
+  std::scoped_lock lock(latch_);
+  return num_records_;
+}
+
+// Master record: the CheckpointLocation, replaced atomically so a crash leaves the old one.
+void LogManager::SetCheckpoint(lsn_t begin_lsn, lsn_t end_lsn) {
+  std::string master = GetMasterPath(path_);
+  std::string tmp = master + ".tmp";
+  CheckpointLocation location{begin_lsn, end_lsn};
+  std::FILE *file = std::fopen(tmp.c_str(), "wb");
+  bool ok = file != nullptr && std::fwrite(&location, sizeof(location), 1, file) == 1 && SyncFile(file);
+  if (file == nullptr || std::fclose(file) != 0 || !ok || std::rename(tmp.c_str(), master.c_str()) != 0) {
+    throw std::runtime_error("cannot write master record " + master);
+  }
+}
+
+auto LogManager::ReadCheckpoint(const std::string &log_path) -> std::optional<CheckpointLocation> {
+  std::FILE *file = std::fopen(GetMasterPath(log_path).c_str(), "rb");
+  if (file == nullptr) {
+    return std::nullopt;
+  }
+  CheckpointLocation location;
+  bool ok = std::fread(&location, sizeof(location), 1, file) == 1;
+  std::fclose(file);
+  if (!ok) {
+    return std::nullopt;
+  }
+  return location;
+}
+
+void LogManager::DecodePageImage(const LogRecord &record, char *page) {
+  if (record.type_ != LogRecordType::PAGE_IMAGE) {
+    throw std::invalid_argument("not a page image record");
+  }
+  PageCodec::Decompress(record.payload_.data(), record.payload_.size(), page);
+}
+
+}  // namespace bicycletub
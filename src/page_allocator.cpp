@@ -0,0 +1,125 @@
+#include "page_allocator.h"
+
+#include <algorithm>
+#include <bit>
+#include <stdexcept>
+
+namespace bicycletub {
+
+PageAllocator::PageAllocator() : root_(std::make_unique<std::atomic<ExtentBlock *>[]>(ROOT_BLOCKS)) {}
+
+PageAllocator::~PageAllocator() {
+  for (size_t b = 0; b < ROOT_BLOCKS; b++) {
+    delete root_[b].load();
+  }
+}
+
+auto PageAllocator::FindBlock(size_t extent) const -> ExtentBlock * {
+  return root_[extent / BLOCK_EXTENTS].load(std::memory_order_acquire);
+}
+
+auto PageAllocator::GetBlock(size_t extent) -> ExtentBlock & {
+  auto &slot = root_[extent / BLOCK_EXTENTS];
+  ExtentBlock *block = slot.load(std::memory_order_relaxed);
+  if (block == nullptr) {
+    block = new ExtentBlock();
+    slot.store(block, std::memory_order_release);
+  }
+  return *block;
+}
+
+auto PageAllocator::AddExtent(AllocationGroup group) -> size_t {
+  if (num_extents_ == ROOT_BLOCKS * BLOCK_EXTENTS) {
+    throw std::runtime_error("out of page ids");
+  }
+  size_t extent = num_extents_++;
+  GetBlock(extent).groups_[extent % BLOCK_EXTENTS] = group;
+  return extent;
+}
+
+auto PageAllocator::NewGroup() -> AllocationGroup {
+  std::lock_guard<std::mutex> lk(latch_);
+  current_extent_.push_back(NO_EXTENT);
+  return static_cast<AllocationGroup>(current_extent_.size() - 1);
+}
+
+auto PageAllocator::Allocate(AllocationGroup group) -> page_id_t {
+  std::lock_guard<std::mutex> lk(latch_);
+  return AllocateLocked(group);
+}
+
+auto PageAllocator::AllocateNear(page_id_t hint) -> page_id_t {
+  std::lock_guard<std::mutex> lk(latch_);
+  if (hint < 0 || static_cast<size_t>(hint) / EXTENT_SIZE >= num_extents_) {
+    return AllocateLocked(AllocationGroup::DEFAULT);
+  }
+  size_t extent = static_cast<size_t>(hint) / EXTENT_SIZE;
+  page_id_t page_id = TakeSlot(extent, static_cast<size_t>(hint) % EXTENT_SIZE + 1);
+  if (page_id == INVALID_PAGE_ID) {
+    page_id = TakeSlot(extent, 0);
+  }
+  return page_id != INVALID_PAGE_ID ? page_id : AllocateLocked(FindBlock(extent)->groups_[extent % BLOCK_EXTENTS]);
+}
+
+void PageAllocator::Adopt(page_id_t end_page_id) {
+  if (end_page_id <= 0) {
+    return;
+  }
+  std::lock_guard<std::mutex> lk(latch_);
+  auto end = static_cast<size_t>(end_page_id);
+  size_t extents = (end + EXTENT_SIZE - 1) / EXTENT_SIZE;
+  while (num_extents_ < extents) {
+    AddExtent(AllocationGroup::DEFAULT);
+  }
+  for (size_t extent = 0; extent < extents; extent++) {
+    size_t slots = std::min(EXTENT_SIZE, end - extent * EXTENT_SIZE);
+    FindBlock(extent)->used_[extent % BLOCK_EXTENTS].fetch_or(
+        slots == EXTENT_SIZE ? ~uint64_t{0} : (uint64_t{1} << slots) - 1, std::memory_order_release);
+  }
+}
+
+auto PageAllocator::IsAllocated(page_id_t page_id) const -> bool {
+  if (page_id < 0) {
+    return false;
+  }
+  size_t extent = static_cast<size_t>(page_id) / EXTENT_SIZE;
+  ExtentBlock *block = FindBlock(extent);
+  return block != nullptr &&
+         (block->used_[extent % BLOCK_EXTENTS].load(std::memory_order_acquire) >> (page_id % EXTENT_SIZE) & 1) != 0;
+}
+
+auto PageAllocator::GetNumExtents() const -> size_t {
+  std::lock_guard<std::mutex> lk(latch_);
+  return num_extents_;
+}
+
+auto PageAllocator::TakeSlot(size_t extent, size_t from) -> page_id_t {
+  if (from >= EXTENT_SIZE) {
+    return INVALID_PAGE_ID;
+  }
+  auto &used = FindBlock(extent)->used_[extent % BLOCK_EXTENTS];
+  uint64_t free = ~used.load(std::memory_order_relaxed) & (~uint64_t{0} << from);
+  if (free == 0) {
+    return INVALID_PAGE_ID;
+  }
+  int slot = std::countr_zero(free);
+  used.fetch_or(uint64_t{1} << slot, std::memory_order_release);
+  return static_cast<page_id_t>(extent * EXTENT_SIZE + static_cast<size_t>(slot));
+}
+
+auto PageAllocator::AllocateLocked(AllocationGroup group) -> page_id_t {
+  auto index = static_cast<size_t>(group);
+  if (index >= current_extent_.size()) {
+    throw std::invalid_argument("unknown allocation group");
+  }
+  size_t &current = current_extent_[index];
+  if (current != NO_EXTENT) {
+    if (page_id_t page_id = TakeSlot(current, 0); page_id != INVALID_PAGE_ID) {
+      return page_id;
+    }
+  }
+  current = AddExtent(group);
+  return TakeSlot(current, 0);
+}
+
+}  // namespace bicycletub
@@ -0,0 +1,86 @@
+#include "page_codec.h"
+
+#include <cstdint>
+#include <cstring>
+
+namespace bicycletub {
+
+namespace {
+constexpr size_t GROUP = 8;
+}  // namespace
+
+auto PageCodec::Compress(const char *page, char *out) -> size_t {
+  size_t end = PAGE_SIZE;
+  while (end >= GROUP) {
+    uint64_t word;
+    std::memcpy(&word, page + end - GROUP, GROUP);
+    if (word != 0) {
+      break;
+    }
+    end -= GROUP;
+  }
+  if (end == 0) {
+    return 0;
+  }
+  size_t size = 0;
+  for (size_t group = 0; group < end; group += GROUP) {
+    uint64_t word;
+    std::memcpy(&word, page + group, GROUP);
+    // whole-word fast paths: padding and dense data
+    if (word == 0) {
+      out[size++] = 0;
+      continue;
+    }
+    if (((word - 0x0101010101010101ULL) & ~word & 0x8080808080808080ULL) == 0) {
+      out[size++] = static_cast<char>(0xFF);
+      std::memcpy(out + size, page + group, GROUP);
+      size += GROUP;
+      continue;
+    }
+    char *mask = out + size++;
+    uint8_t bits = 0;
+    for (size_t i = 0; i < GROUP; i++) {
+      char c = page[group + i];
+      if (c != 0) {
+        bits |= static_cast<uint8_t>(1U << i);
+        out[size++] = c;
+      }
+    }
+    *mask = static_cast<char>(bits);
+  }
+  if (size >= PAGE_SIZE) {
+    std::memcpy(out, page, PAGE_SIZE);
+    return PAGE_SIZE;
+  }
+  return size;
+}
+
+void PageCodec::Decompress(const char *blob, size_t size, char *page) {
+  if (size == PAGE_SIZE) {
+    std::memcpy(page, blob, PAGE_SIZE);
+    return;
+  }
+  size_t pos = 0;
+  size_t group = 0;
+  while (pos < size) {
+    auto bits = static_cast<uint8_t>(blob[pos++]);
+    if (bits == 0) {
+      std::memset(page + group, 0, GROUP);
+      group += GROUP;
+      continue;
+    }
+    if (bits == 0xFF) {
+      std::memcpy(page + group, blob + pos, GROUP);
+      pos += GROUP;
+      group += GROUP;
+      continue;
+    }
+    for (size_t i = 0; i < GROUP; i++) {
+      page[group + i] = (bits & (1U << i)) != 0 ? blob[pos++] : 0;
+    }
+    group += GROUP;
+  }
+  std::memset(page + group, 0, PAGE_SIZE - group);
+}
+
+}  // namespace bicycletub
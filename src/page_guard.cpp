@@ -1,16 +1,24 @@
 #include "page_guard.h"
 
+#include <algorithm>
+
 namespace bicycletub {
 
+namespace {
+// innermost AtomicWriteScope open on this thread
+thread_local AtomicWriteScope *current_scope = nullptr;
+}  // namespace
+
 // ReadPageGuard Implementation
 ReadPageGuard::ReadPageGuard(page_id_t page_id, std::shared_ptr<FrameHeader> frame,
                              std::shared_ptr<ArcReplacer> replacer, std::shared_ptr<std::mutex> bpm_latch,
-                             std::shared_ptr<DiskScheduler> disk_scheduler)
+                             std::shared_ptr<DiskScheduler> disk_scheduler, LogManager *log_manager)
     : page_id_(page_id),
       frame_(std::move(frame)),
       replacer_(std::move(replacer)),
       bpm_latch_(std::move(bpm_latch)),
-      disk_scheduler_(std::move(disk_scheduler)) {
+      disk_scheduler_(std::move(disk_scheduler)),
+      log_manager_(log_manager) {
   is_valid_ = true;
   {
     std::lock_guard<std::mutex> lock(*bpm_latch_);
@@ -27,6 +35,7 @@ ReadPageGuard::ReadPageGuard(ReadPageGuard &&that) noexcept {
   replacer_ = std::move(that.replacer_);
   bpm_latch_ = std::move(that.bpm_latch_);
   disk_scheduler_ = std::move(that.disk_scheduler_);
+  log_manager_ = that.log_manager_;
   that.is_valid_ = false;
 }
 
@@ -41,20 +50,29 @@ auto ReadPageGuard::operator=(ReadPageGuard &&that) noexcept -> ReadPageGuard &
   replacer_ = std::move(that.replacer_);
   bpm_latch_ = std::move(that.bpm_latch_);
   disk_scheduler_ = std::move(that.disk_scheduler_);
+  log_manager_ = that.log_manager_;
   that.is_valid_ = false;
   return *this;
 }
 
 void ReadPageGuard::Flush() {
-  auto promise = disk_scheduler_->CreatePromise();
-  auto future = promise.get_future();
+  if (frame_->IsMapped()) {
+    // the frame shows the stored page itself and is never dirty; only a write guard unmaps it
+    return;
+  }
+  if (log_manager_ != nullptr) {
+    // WAL: the logged image has to be durable before the page is
+    log_manager_->Flush(frame_->page_lsn_);
+  }
+  // several readers may flush the same frame at once, so the completion lives on our stack
+  DiskCompletion done;
+  done.Reset();
+  // not GetDataMut(): the frame is not mapped and must not be changed under a shared latch
   auto request = DiskRequest{
-      .is_write_ = true, .data_ = frame_->GetDataMut(), .page_id_ = page_id_, .callback_ = std::move(promise)};
-  std::vector<DiskRequest> requests;
-  requests.push_back(std::move(request));
-  disk_scheduler_->Schedule(requests);
-  future.get();
-  frame_->is_dirty_ = false;
+      .is_write_ = true, .data_ = frame_->data_, .page_id_ = page_id_, .callback_ = &done};
+  disk_scheduler_->Schedule({&request, 1});
+  done.Wait();
+  frame_->MarkClean();
 }
 
 void ReadPageGuard::Drop() {
@@ -75,12 +93,13 @@ void ReadPageGuard::Drop() {
 // WritePageGuard Implementation
 WritePageGuard::WritePageGuard(page_id_t page_id, std::shared_ptr<FrameHeader> frame,
                                std::shared_ptr<ArcReplacer> replacer, std::shared_ptr<std::mutex> bpm_latch,
-                               std::shared_ptr<DiskScheduler> disk_scheduler)
+                               std::shared_ptr<DiskScheduler> disk_scheduler, LogManager *log_manager)
     : page_id_(page_id),
       frame_(std::move(frame)),
       replacer_(std::move(replacer)),
       bpm_latch_(std::move(bpm_latch)),
-      disk_scheduler_(std::move(disk_scheduler)) {
+      disk_scheduler_(std::move(disk_scheduler)),
+      log_manager_(log_manager) {
   is_valid_ = true;
   {
     std::lock_guard<std::mutex> lock(*bpm_latch_);
@@ -92,11 +111,13 @@ WritePageGuard::WritePageGuard(page_id_t page_id, std::shared_ptr<FrameHeader> f
 
 WritePageGuard::WritePageGuard(WritePageGuard &&that) noexcept {
   is_valid_ = that.is_valid_;
+  modified_ = that.modified_;
   page_id_ = that.page_id_;
   frame_ = std::move(that.frame_);
   replacer_ = std::move(that.replacer_);
   bpm_latch_ = std::move(that.bpm_latch_);
   disk_scheduler_ = std::move(that.disk_scheduler_);
+  log_manager_ = that.log_manager_;
   that.is_valid_ = false;
 }
 
@@ -106,29 +127,53 @@ auto WritePageGuard::operator=(WritePageGuard &&that) noexcept -> WritePageGuard
   }
   Drop();
   is_valid_ = that.is_valid_;
+  modified_ = that.modified_;
   page_id_ = that.page_id_;
   frame_ = std::move(that.frame_);
   replacer_ = std::move(that.replacer_);
   bpm_latch_ = std::move(that.bpm_latch_);
   disk_scheduler_ = std::move(that.disk_scheduler_);
+  log_manager_ = that.log_manager_;
   that.is_valid_ = false;
   return *this;
 }
 
 void WritePageGuard::Flush() {
-  auto promise = disk_scheduler_->CreatePromise();
-  auto future = promise.get_future();
+  if (log_manager_ != nullptr) {
+    LogChanges();
+    log_manager_->Flush(frame_->page_lsn_);
+  }
+  DiskCompletion done;
+  done.Reset();
   auto request = DiskRequest{
-      .is_write_ = true, .data_ = frame_->GetDataMut(), .page_id_ = page_id_, .callback_ = std::move(promise)};
-  std::vector<DiskRequest> requests;
-  requests.push_back(std::move(request));
-  disk_scheduler_->Schedule(requests);
-  future.get();
-  frame_->is_dirty_ = false;
+      .is_write_ = true, .data_ = frame_->GetDataMut(), .page_id_ = page_id_, .callback_ = &done};
+  disk_scheduler_->Schedule({&request, 1});
+  done.Wait();
+  frame_->MarkClean();
+}
+
+void WritePageGuard::NoteRecoveryLsn() {
+  if (frame_->rec_lsn_.load() == INVALID_LSN) {
+    // taken before the append, so a checkpoint that starts after the append sees the page dirty
+    frame_->rec_lsn_.store(log_manager_->GetNextLsn());
+  }
+}
+
+void WritePageGuard::LogChanges() {
+  if (modified_ && log_manager_ != nullptr) {
+    NoteRecoveryLsn();
+    frame_->page_lsn_ = log_manager_->AppendPageImage(page_id_, frame_->data_);
+  }
+  modified_ = false;
 }
 
 void WritePageGuard::Drop() {
   if (is_valid_) {
+    if (modified_ && AtomicWriteScope::Adopt(*this)) {
+      return;
+    }
+    // still under the exclusive latch, so the image is exactly what later readers see
+    LogChanges();
     is_valid_ = false;
     frame_->rwlatch_.unlock();
     {
@@ -141,4 +186,64 @@ void WritePageGuard::Drop() {
   }
 }
 
+
+// AtomicWriteScope Implementation
+AtomicWriteScope::AtomicWriteScope(LogManager *log_manager, const std::mutex *bpm_latch)
+    : log_manager_(log_manager), bpm_latch_(bpm_latch) {
+  if (log_manager_ != nullptr) {
+    outer_ = current_scope;
+    current_scope = this;
+    open_ = true;
+  }
+}
+
+auto AtomicWriteScope::Adopt(WritePageGuard &guard) -> bool {
+  AtomicWriteScope *scope = current_scope;
+  if (scope == nullptr || scope->bpm_latch_ != guard.bpm_latch_.get()) {
+    return false;
+  }
+  scope->guards_.push_back(std::move(guard));
+  return true;
+}
+
+auto AtomicWriteScope::Reclaim(const std::mutex *bpm_latch, page_id_t page_id) -> std::optional<WritePageGuard> {
+  for (AtomicWriteScope *scope = current_scope; scope != nullptr; scope = scope->outer_) {
+    if (scope->bpm_latch_ != bpm_latch) {
+      continue;
+    }
+    auto it = std::find_if(scope->guards_.begin(), scope->guards_.end(),
+                           [&](const WritePageGuard &guard) { return guard.page_id_ == page_id; });
+    if (it != scope->guards_.end()) {
+      WritePageGuard guard = std::move(*it);
+      scope->guards_.erase(it);
+      return guard;
+    }
+  }
+  return std::nullopt;
+}
+
+void AtomicWriteScope::Commit() {
+  if (!open_) {
+    return;
+  }
+  open_ = false;
+  // scopes close in reverse order of opening, as they live on the stack
+  current_scope = outer_;
+  std::vector<std::pair<page_id_t, const char *>> pages;
+  pages.reserve(guards_.size());
+  for (auto &guard : guards_) {
+    guard.NoteRecoveryLsn();
+    pages.emplace_back(guard.page_id_, guard.frame_->data_);
+  }
+  if (!pages.empty()) {
+    lsn_t lsn = log_manager_->AppendPageImages(pages);
+    for (auto &guard : guards_) {
+      guard.frame_->page_lsn_ = lsn;
+      guard.modified_ = false;
+    }
+  }
+  // releases latches and pins
+  guards_.clear();
+}
+
 }  // namespace bicycletub
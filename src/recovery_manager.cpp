@@ -0,0 +1,123 @@
+#include "recovery_manager.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace bicycletub {
+
+namespace {
+// calls visit(page_id) for every page a record has an image of, without decoding them
+template <class Visitor>
+void ForEachImagePageId(const LogRecord &record, Visitor &&visit) {
+  if (record.type_ == LogRecordType::PAGE_IMAGE) {
+    visit(record.page_id_);
+    return;
+  }
+  if (record.type_ != LogRecordType::MULTI_PAGE_IMAGE) {
+    return;
+  }
+  size_t pos = 0;
+  while (pos + sizeof(MultiPageEntry) <= record.payload_.size()) {
+    MultiPageEntry entry;
+    std::memcpy(&entry, record.payload_.data() + pos, sizeof(entry));
+    pos += sizeof(entry) + entry.size_;
+    visit(entry.page_id_);
+  }
+}
+}  // namespace
+
+RecoveryManager::RecoveryManager(std::string log_path, DiskManager *disk_manager)
+    : log_path_(std::move(log_path)), disk_manager_(disk_manager) {}
+
+auto RecoveryManager::Recover() -> RecoveryStats {
+  RecoveryStats stats;
+  Analysis(&stats);
+  Redo(&stats);
+  return stats;
+}
+
+void RecoveryManager::Analysis(RecoveryStats *stats) {
+  dirty_pages_.clear();
+  redo_all_ = true;
+  auto checkpoint = LogManager::ReadCheckpoint(log_path_);
+  if (!checkpoint.has_value()) {
+    stats->redo_lsn_ = LogReader(log_path_).GetBeginLsn();
+    return;
+  }
+  LogRecord record;
+  {
+    LogReader reader(log_path_, checkpoint->end_lsn_);
+    if (!reader.Next(&record) || record.type_ != LogRecordType::CHECKPOINT_END ||
+        record.payload_.size() < sizeof(lsn_t)) {
+      throw std::runtime_error("master record of " + log_path_ + " does not point to a checkpoint");
+    }
+  }
+  redo_all_ = false;
+  stats->checkpoint_lsn_ = checkpoint->begin_lsn_;
+  for (size_t pos = sizeof(lsn_t); pos + sizeof(DirtyPageEntry) <= record.payload_.size();
+       pos += sizeof(DirtyPageEntry)) {
+    DirtyPageEntry entry;
+    std::memcpy(&entry, record.payload_.data() + pos, sizeof(entry));
+    dirty_pages_.emplace(entry.page_id_, entry.rec_lsn_);
+  }
+  // pages first changed after BEGIN were not in the snapshot, or were written meanwhile
+  LogReader reader(log_path_, checkpoint->begin_lsn_);
+  while (reader.Next(&record)) {
+    ForEachImagePageId(record, [&](page_id_t page_id) { dirty_pages_.try_emplace(page_id, record.lsn_); });
+  }
+  stats->redo_lsn_ = checkpoint->begin_lsn_;
+  for (const auto &[page_id, rec_lsn] : dirty_pages_) {
+    stats->redo_lsn_ = std::min(stats->redo_lsn_, rec_lsn);
+    stats->page_id_end_ = std::max(stats->page_id_end_, page_id + 1);
+  }
+  stats->dirty_pages_ = dirty_pages_.size();
+}
+
+void RecoveryManager::Redo(RecoveryStats *stats) {
+  LogReader reader(log_path_, stats->redo_lsn_);
+  LogRecord record;
+  std::vector<char> page(PAGE_SIZE);
+  while (reader.Next(&record)) {
+    stats->records_redone_++;
+    LogManager::ForEachPageImage(record, page.data(), [&](page_id_t page_id) {
+      if (!redo_all_) {
+        auto it = dirty_pages_.find(page_id);
+        if (it == dirty_pages_.end() || record.lsn_ < it->second) {
+          return;  // this change is on disk already
+        }
+      }
+      pending_[page_id] = page;
+      stats->page_id_end_ = std::max(stats->page_id_end_, page_id + 1);
+    });
+    if (pending_.size() >= MAX_PENDING_PAGES) {
+      WritePending(stats);
+    }
+  }
+  stats->end_lsn_ = reader.GetEndLsn();
+  WritePending(stats);
+  disk_manager_->Sync();
+}
+
+void RecoveryManager::WritePending(RecoveryStats *stats) {
+  std::vector<const char *> run;
+  page_id_t first = INVALID_PAGE_ID;
+  auto flush_run = [&] {
+    if (!run.empty()) {
+      disk_manager_->WritePages(first, run.data(), run.size());
+      stats->pages_written_ += run.size();
+      run.clear();
+    }
+  };
+  for (const auto &[page_id, image] : pending_) {
+    if (run.empty() || page_id != first + static_cast<page_id_t>(run.size())) {
+      flush_run();
+      first = page_id;
+    }
+    run.push_back(image.data());
+  }
+  flush_run();
+  pending_.clear();
+}
+
+}  // namespace bicycletub
@@ -0,0 +1,168 @@
+#include "simulated_disk_manager.h"
+
+#include <algorithm>
+
+#ifdef __linux__
+#include <sys/prctl.h>
+#endif
+
+namespace bicycletub {
+
+SimulatedDiskManager::SimulatedDiskManager(DiskManager *inner, DiskProfile profile)
+    : inner_(inner),
+      profile_(profile),
+      slot_free_at_(std::max<size_t>(profile.queue_depth_, 1), Clock::now()),
+      bus_free_at_(Clock::now()),
+      wheel_(WHEEL_SLOTS),
+      epoch_(Clock::now()) {
+  timer_thread_.emplace([this] { RunTimer(); });
+}
+
+SimulatedDiskManager::~SimulatedDiskManager() {
+  {
+    std::lock_guard<std::mutex> lk(wheel_latch_);
+    stop_ = true;
+  }
+  wheel_cv_.notify_one();
+  timer_thread_->join();
+}
+
+auto SimulatedDiskManager::Reserve(page_id_t first_page_id, size_t count) -> Clock::time_point {
+  std::lock_guard<std::mutex> lk(model_latch_);
+  auto now = Clock::now();
+  bool sequential = first_page_id == next_sequential_page_;
+  next_sequential_page_ = first_page_id + static_cast<page_id_t>(count);
+  (sequential ? sequential_ios_ : random_ios_).fetch_add(1, std::memory_order_relaxed);
+
+  auto slot = std::min_element(slot_free_at_.begin(), slot_free_at_.end());
+  auto start = std::max(now, *slot);
+  auto access = sequential ? profile_.sequential_latency_ : profile_.random_latency_;
+  std::chrono::nanoseconds transfer{0};
+  if (profile_.bandwidth_bytes_per_sec_ != 0) {
+    transfer = std::chrono::nanoseconds(count * PAGE_SIZE * 1'000'000'000ULL / profile_.bandwidth_bytes_per_sec_);
+  }
+  // positioning overlaps with other I/Os, the transfer queues behind whatever is on the bus
+  auto transfer_start = std::max(start + access, bus_free_at_);
+  auto done = transfer_start + transfer;
+  bus_free_at_ = done;
+  *slot = done;
+  return done;
+}
+
+auto SimulatedDiskManager::TickOf(Clock::time_point time) const -> uint64_t {
+  return static_cast<uint64_t>(std::max<int64_t>((time - epoch_) / TICK, 0));
+}
+
+void SimulatedDiskManager::WaitUntil(Clock::time_point due) {
+  auto now = Clock::now();
+  if (due <= now) {
+    return;
+  }
+  wait_ns_.fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(due - now).count(),
+                     std::memory_order_relaxed);
+  // round up: the timer never fires early
+  uint64_t tick = TickOf(due) + 1;
+  DiskCompletion done;
+  done.Reset();
+  bool wake = false;
+  {
+    std::lock_guard<std::mutex> lk(wheel_latch_);
+    if (tick < hand_) {
+      // the hand already passed it while we were getting here
+      return;
+    }
+    wheel_[tick % WHEEL_SLOTS].push_back({tick, &done});
+    pending_++;
+    if (tick < wake_tick_) {
+      wake_tick_ = tick;
+      wake = true;
+    }
+  }
+  if (wake) {
+    wheel_cv_.notify_one();
+  }
+  done.Wait();
+}
+
+void SimulatedDiskManager::RunTimer() {
+#ifdef __linux__
+  // the one sleeping thread should wake on time, not within the default 50us slack
+  ::prctl(PR_SET_TIMERSLACK, 1UL);
+#endif
+  std::unique_lock<std::mutex> lk(wheel_latch_);
+  hand_ = TickOf(Clock::now());
+  while (!stop_) {
+    uint64_t now_tick = TickOf(Clock::now());
+    // advance the hand, at most one full turn: after that every slot has been visited
+    for (uint64_t visited = 0; hand_ <= now_tick && pending_ > 0 && visited < WHEEL_SLOTS; hand_++, visited++) {
+      auto &slot = wheel_[hand_ % WHEEL_SLOTS];
+      auto due_end = std::partition(slot.begin(), slot.end(), [&](const Timer &t) { return t.tick_ > now_tick; });
+      for (auto it = due_end; it != slot.end(); ++it) {
+        it->done_->Complete(true);
+      }
+      pending_ -= static_cast<size_t>(slot.end() - due_end);
+      slot.erase(due_end, slot.end());
+    }
+    hand_ = std::max(hand_, now_tick + 1);
+    if (pending_ == 0) {
+      wake_tick_ = UINT64_MAX;
+      wheel_cv_.wait(lk);
+      hand_ = std::max(hand_, std::min(wake_tick_, TickOf(Clock::now())));
+      continue;
+    }
+    // sleep until the next occupied slot; a timer there may belong to a later turn, in which
+    // case the pass above simply finds nothing due yet
+    uint64_t next = hand_;
+    while (wheel_[next % WHEEL_SLOTS].empty() && next < hand_ + WHEEL_SLOTS) {
+      next++;
+    }
+    wake_tick_ = next;
+    wheel_cv_.wait_until(lk, epoch_ + TICK * static_cast<int64_t>(next));
+  }
+  // wake anyone still parked so they do not outlive the thread
+  for (auto &slot : wheel_) {
+    for (auto &timer : slot) {
+      timer.done_->Complete(true);
+    }
+    slot.clear();
+  }
+}
+
+void SimulatedDiskManager::ReadPage(page_id_t page_id, char *out_buf) {
+  auto due = Reserve(page_id, 1);
+  inner_->ReadPage(page_id, out_buf);
+  WaitUntil(due);
+}
+
+void SimulatedDiskManager::WritePage(page_id_t page_id, const char *buf) {
+  auto due = Reserve(page_id, 1);
+  inner_->WritePage(page_id, buf);
+  WaitUntil(due);
+}
+
+void SimulatedDiskManager::ReadPages(page_id_t first_page_id, char *const *out_bufs, size_t count) {
+  auto due = Reserve(first_page_id, count);
+  inner_->ReadPages(first_page_id, out_bufs, count);
+  WaitUntil(due);
+}
+
+void SimulatedDiskManager::WritePages(page_id_t first_page_id, const char *const *bufs, size_t count) {
+  auto due = Reserve(first_page_id, count);
+  inner_->WritePages(first_page_id, bufs, count);
+  WaitUntil(due);
+}
+
+void SimulatedDiskManager::Sync() {
+  Clock::time_point due;
+  {
+    std::lock_guard<std::mutex> lk(model_latch_);
+    due = std::max(bus_free_at_, *std::max_element(slot_free_at_.begin(), slot_free_at_.end()));
+    due = std::max(due, Clock::now()) + profile_.sync_latency_;
+    std::fill(slot_free_at_.begin(), slot_free_at_.end(), due);
+    bus_free_at_ = due;
+  }
+  inner_->Sync();
+  WaitUntil(due);
+}
+
+}  // namespace bicycletub
@@ -0,0 +1,45 @@
+#include "size_class_allocator.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace bicycletub {
+
+auto SizeClassAllocator::ClassOf(size_t size) -> size_t {
+  if (size == 0 || size > PAGE_SIZE) {
+    throw std::invalid_argument("blob size out of range");
+  }
+  return static_cast<size_t>(std::lower_bound(CLASS_SIZES.begin(), CLASS_SIZES.end(), size) - CLASS_SIZES.begin());
+}
+
+auto SizeClassAllocator::Allocate(size_t size) -> char * {
+  size_t index = ClassOf(size);
+  size_t slot_size = CLASS_SIZES[index];
+  auto &size_class = classes_[index];
+  allocated_bytes_.fetch_add(slot_size, std::memory_order_relaxed);
+  std::lock_guard<std::mutex> lk(size_class.latch_);
+  if (size_class.free_.empty()) {
+    auto &slab = size_class.slabs_.emplace_back(std::make_unique<char[]>(SLAB_SIZE));
+    reserved_bytes_.fetch_add(SLAB_SIZE, std::memory_order_relaxed);
+    // hand out the first slot right away, the rest goes to the free list in reverse so
+    // consecutive allocations get ascending addresses
+    for (size_t offset = SLAB_SIZE / slot_size * slot_size; offset > slot_size;) {
+      offset -= slot_size;
+      size_class.free_.push_back(slab.get() + offset);
+    }
+    return slab.get();
+  }
+  char *blob = size_class.free_.back();
+  size_class.free_.pop_back();
+  return blob;
+}
+
+void SizeClassAllocator::Free(char *blob, size_t size) {
+  size_t index = ClassOf(size);
+  allocated_bytes_.fetch_sub(CLASS_SIZES[index], std::memory_order_relaxed);
+  auto &size_class = classes_[index];
+  std::lock_guard<std::mutex> lk(size_class.latch_);
+  size_class.free_.push_back(blob);
+}
+
+}  // namespace bicycletub
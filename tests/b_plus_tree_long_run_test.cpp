@@ -12,6 +12,7 @@
 #include "b_plus_tree_key.h"
 #include "buffer_pool_manager.h"
 #include "disk_manager_memory.h"
+#include "test_disk_manager.h"
 #include "types.h"
 
 using namespace bicycletub;
@@ -51,7 +52,7 @@ class BPlusTreeLongRunTest : public ::testing::Test {
     internal_max_ = GetEnvInt("BICY_STRESS_INTERNAL", 16);
     preload_ = GetEnvInt("BICY_STRESS_PRELOAD", 5000);
 
-    disk_manager = std::make_unique<DiskManagerMemory>();
+    disk_manager = MakeTestDiskManager();
     bpm = std::make_unique<BufferPoolManager>(pool_size_, disk_manager.get());
     header_page_id = bpm->NewPage();
     tree = std::make_unique<BPlusTree<IntegerKey, RID, IntegerKeyComparator>>("long_tree", header_page_id, bpm.get(), comparator, leaf_max_, internal_max_);
@@ -73,7 +74,7 @@ class BPlusTreeLongRunTest : public ::testing::Test {
   int internal_max_{};
   int preload_{};
 
-  std::unique_ptr<DiskManagerMemory> disk_manager;
+  std::unique_ptr<DiskManager> disk_manager;
   std::unique_ptr<BufferPoolManager> bpm;
   page_id_t header_page_id{INVALID_PAGE_ID};
   IntegerKeyComparator comparator{};
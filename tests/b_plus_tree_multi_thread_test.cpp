@@ -5,10 +5,13 @@
 #include <random>
 #include <set>
 #include <algorithm>
+#include <chrono>
+#include <iostream>
 #include "b_plus_tree.h"
 #include "b_plus_tree_key.h"
 #include "buffer_pool_manager.h"
 #include "disk_manager_memory.h"
+#include "test_disk_manager.h"
 #include "types.h"
 
 using namespace bicycletub;
@@ -16,7 +19,7 @@ using namespace bicycletub;
 class BPlusTreeMultiThreadTest : public ::testing::Test {
 protected:
     void SetUp() override {
-        disk_manager = std::make_unique<DiskManagerMemory>();
+        disk_manager = MakeTestDiskManager();
         bpm = std::make_unique<BufferPoolManager>(pool_size, disk_manager.get());
         header_page_id = bpm->NewPage();
         tree = std::make_unique<BPlusTree<IntegerKey, RID, IntegerKeyComparator>>("mt_tree", header_page_id, bpm.get(), comparator, 64, 64);
@@ -27,7 +30,7 @@ protected:
         disk_manager.reset();
     }
         static constexpr size_t pool_size = 64; // stress
-    std::unique_ptr<DiskManagerMemory> disk_manager;
+    std::unique_ptr<DiskManager> disk_manager;
     std::unique_ptr<BufferPoolManager> bpm;
     page_id_t header_page_id{INVALID_PAGE_ID};
     IntegerKeyComparator comparator{};
@@ -165,3 +168,160 @@ TEST_F(BPlusTreeMultiThreadTest, RandomConcurrentOps) {
                             << " hits=" << bpm->GetCacheHits()
                             << " misses=" << bpm->GetCacheMisses() << "\n";
 }
+
+// Inserts the same shuffled key set with 1..8 threads; with latch crabbing most inserts
+// only write-latch their leaf, so throughput should grow with the thread count
+// (as far as the machine has cores). Disabled by default: half a minute per backend at -O0;
+// run with --gtest_also_run_disabled_tests.
+TEST_F(BPlusTreeMultiThreadTest, DISABLED_InsertThroughputScaling) {
+    const int total = 40000;
+    std::vector<int> keys(total);
+    for(int i=0;i<total;i++) keys[i] = i;
+    std::shuffle(keys.begin(), keys.end(), std::mt19937(42));
+    for(int threads : {1, 2, 4, 8}) {
+        auto disk = MakeTestDiskManager();
+        BufferPoolManager pool(1024, disk.get());
+        page_id_t header = pool.NewPage();
+        BPlusTree<IntegerKey, RID, IntegerKeyComparator> bench_tree("scale_tree", header, &pool, comparator, 64, 64);
+        auto start = std::chrono::steady_clock::now();
+        std::vector<std::thread> workers;
+        for(int t=0;t<threads;t++) {
+            workers.emplace_back([&,t]() {
+                for(int i=t;i<total;i+=threads) {
+                    bench_tree.Insert(IntegerKey(keys[i]), RID(keys[i],0));
+                }
+            });
+        }
+        for(auto &th: workers) th.join();
+        double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::cout << "[InsertScaling] threads=" << threads
+                  << " inserts/s=" << static_cast<long>(total / secs) << "\n";
+        auto collected = CollectKeys(&bench_tree);
+        ASSERT_EQ((int)collected.size(), total);
+        ASSERT_TRUE(std::is_sorted(collected.begin(), collected.end()));
+    }
+}
+
+// Point lookups from 1..32 threads on a prebuilt tree. Readers take only shared latches,
+// the header's included, so they should not serialize on each other. Disabled by default:
+// half a minute per backend at -O0; run with --gtest_also_run_disabled_tests.
+TEST_F(BPlusTreeMultiThreadTest, DISABLED_ReadThroughputScaling) {
+    const int num_keys = 20000;
+    const int lookups = 32000;
+    auto disk = MakeTestDiskManager();
+    BufferPoolManager pool(1024, disk.get());
+    page_id_t header = pool.NewPage();
+    BPlusTree<IntegerKey, RID, IntegerKeyComparator> bench_tree("read_tree", header, &pool, comparator, 64, 64);
+    for(int i=0;i<num_keys;i++) bench_tree.Insert(IntegerKey(i), RID(i,0));
+    for(int threads : {1, 2, 4, 8, 16, 32}) {
+        std::atomic<int> found{0};
+        auto start = std::chrono::steady_clock::now();
+        std::vector<std::thread> workers;
+        for(int t=0;t<threads;t++) {
+            workers.emplace_back([&,t]() {
+                std::mt19937 rng(t);
+                std::uniform_int_distribution<int> dist(0, num_keys-1);
+                std::vector<RID> result;
+                int hits = 0;
+                for(int i=t;i<lookups;i+=threads) {
+                    result.clear();
+                    hits += bench_tree.GetValue(IntegerKey(dist(rng)), &result) ? 1 : 0;
+                }
+                found += hits;
+            });
+        }
+        for(auto &th: workers) th.join();
+        double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::cout << "[ReadScaling] threads=" << threads
+                  << " lookups/s=" << static_cast<long>(lookups / secs) << "\n";
+        ASSERT_EQ(found.load(), lookups);
+    }
+}
+
+// Iterators and ScanRange move left to right hand over hand, and back through prev_page_id_,
+// while removes merge leaves into their left siblings; nobody may deadlock and every scan
+// must stay sorted.
+TEST_F(BPlusTreeMultiThreadTest, ScansDuringMergingRemoves) {
+    const int total = 4000;
+    for(int i=0;i<total;i++) tree->Insert(IntegerKey(i), RID(i,0));
+    std::atomic<int> removers_left{4};
+    std::vector<std::thread> workers;
+    for(int t=0;t<4;t++) {
+        workers.emplace_back([&,t]() {
+            for(int i=t;i<total;i+=4) {
+                if(i % 5 != 0) tree->Remove(IntegerKey(i));
+            }
+            removers_left--;
+        });
+    }
+    for(int t=0;t<4;t++) {
+        workers.emplace_back([&,t]() {
+            while(removers_left.load() > 0) {
+                std::vector<int> keys;
+                if(t == 0) {
+                    keys = CollectKeys(tree.get());
+                } else if(t == 1) {
+                    tree->ScanRange(IntegerKey(0), IntegerKey(total),
+                        [&](std::span<const IntegerKey> batch, std::span<const RID>) {
+                            for(const auto &key : batch) keys.push_back(key.GetValue());
+                            return true;
+                        });
+                } else if(t == 2) {
+                    for(auto it = tree->RBegin(); it != tree->REnd(); --it) keys.push_back((*it).first.GetValue());
+                    std::reverse(keys.begin(), keys.end());
+                } else {
+                    std::vector<std::pair<IntegerKey, RID>> out;
+                    tree->ScanRange(IntegerKey(0), IntegerKey(total), &out, ScanOrder::DESCENDING);
+                    for(auto it = out.rbegin(); it != out.rend(); ++it) keys.push_back(it->first.GetValue());
+                }
+                // sorted without repeats: a step back never returns to an entry already seen
+                ASSERT_TRUE(std::adjacent_find(keys.begin(), keys.end(),
+                    [](int a, int b) { return a >= b; }) == keys.end());
+                // the multiples of 5 are never removed, so every scan sees all of them
+                ASSERT_EQ(std::count_if(keys.begin(), keys.end(), [](int k) { return k % 5 == 0; }), total / 5);
+            }
+        });
+    }
+    for(auto &th: workers) th.join();
+    auto keys = CollectKeys(tree.get());
+    ASSERT_EQ((int)keys.size(), total / 5);
+    for(int i=0;i<(int)keys.size();i++) ASSERT_EQ(keys[i], 5*i);
+}
+
+// Batched lookups keep a latched path across probes while inserts split leaves and inner
+// nodes under them: no deadlock, and keys present before the batch are always found.
+TEST_F(BPlusTreeMultiThreadTest, GetValuesDuringSplittingInserts) {
+    const int total = 8000;
+    for(int i=0;i<total;i+=2) tree->Insert(IntegerKey(i), RID(i,0));
+    std::atomic<int> inserters_left{4};
+    std::vector<std::thread> workers;
+    for(int t=0;t<4;t++) {
+        workers.emplace_back([&,t]() {
+            for(int i=2*t+1;i<total;i+=8) tree->Insert(IntegerKey(i), RID(i,0));
+            inserters_left--;
+        });
+    }
+    for(int t=0;t<2;t++) {
+        workers.emplace_back([&,t]() {
+            std::vector<IntegerKey> probes;
+            for(int i=0;i<total;i++) probes.emplace_back(i);
+            std::shuffle(probes.begin(), probes.end(), std::mt19937(t));
+            std::vector<std::optional<RID>> results;
+            while(inserters_left.load() > 0) {
+                tree->GetValues(probes, &results);
+                for(size_t i=0;i<probes.size();i++) {
+                    int key = probes[i].GetValue();
+                    if(key % 2 == 0) {
+                        ASSERT_TRUE(results[i].has_value()) << key;
+                    }
+                    if(results[i].has_value()) {
+                        ASSERT_EQ(results[i]->page_id, key);
+                    }
+                }
+            }
+        });
+    }
+    for(auto &th: workers) th.join();
+    auto keys = CollectKeys(tree.get());
+    ASSERT_EQ((int)keys.size(), total);
+}
@@ -3,10 +3,14 @@
 #include <thread>
 #include <set>
 #include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <random>
 #include "b_plus_tree.h"
 #include "b_plus_tree_key.h"
 #include "buffer_pool_manager.h"
 #include "disk_manager_memory.h"
+#include "test_disk_manager.h"
 #include "types.h"
 
 using namespace bicycletub;
@@ -14,7 +18,7 @@ using namespace bicycletub;
 class BPlusTreeSingleTest : public ::testing::Test {
 protected:
     void SetUp() override {
-        disk_manager = std::make_unique<DiskManagerMemory>();
+        disk_manager = MakeTestDiskManager();
         bpm = std::make_unique<BufferPoolManager>(pool_size, disk_manager.get());
         // allocate header page id (use NewPage so consistent)
         header_page_id = bpm->NewPage();
@@ -26,7 +30,7 @@ protected:
         disk_manager.reset();
     }
     static constexpr size_t pool_size = 256; // enough for tests
-    std::unique_ptr<DiskManagerMemory> disk_manager;
+    std::unique_ptr<DiskManager> disk_manager;
     std::unique_ptr<BufferPoolManager> bpm;
     page_id_t header_page_id{INVALID_PAGE_ID};
     IntegerKeyComparator comparator{};
@@ -132,3 +136,378 @@ TEST_F(BPlusTreeSingleTest, StressRandomErase) {
         EXPECT_EQ((*it).second.page_id, *remIt);
     }
 }
+
+TEST_F(BPlusTreeSingleTest, OpenAttachesWithoutReset) {
+    for(int i=0;i<300;i++) tree->Insert(IntegerKey(i), RID(i,0));
+    tree.reset();
+    using Tree = BPlusTree<IntegerKey, RID, IntegerKeyComparator>;
+    tree = std::make_unique<Tree>(Tree::Open("test_tree", header_page_id, bpm.get(), comparator));
+    EXPECT_FALSE(tree->IsEmpty());
+    for(int i=0;i<300;i++) {
+        std::vector<RID> r;
+        ASSERT_TRUE(tree->GetValue(IntegerKey(i), &r)) << i;
+        EXPECT_EQ(r[0].page_id, i);
+    }
+    // node sizes come from the header, not from the defaults
+    for(int i=300;i<1200;i++) tree->Insert(IntegerKey(i), RID(i,0));
+    page_id_t page_id = tree->GetRootPageId();
+    EXPECT_EQ(bpm->ReadPage(page_id).As<BPlusTreePage>()->GetMaxSize(), 32);
+    while(!bpm->ReadPage(page_id).As<BPlusTreePage>()->IsLeafPage()) {
+        page_id = bpm->ReadPage(page_id).As<BPlusTreeInternalPage<IntegerKey, page_id_t, IntegerKeyComparator>>()->ValueAt(0);
+    }
+    EXPECT_EQ(bpm->ReadPage(page_id).As<BPlusTreePage>()->GetMaxSize(), 32);
+    int count = 0;
+    for(auto it = tree->Begin(); it != tree->End(); ++it) count++;
+    EXPECT_EQ(count, 1200);
+}
+
+TEST_F(BPlusTreeSingleTest, OpenRejectsOtherPages) {
+    using Tree = BPlusTree<IntegerKey, RID, IntegerKeyComparator>;
+    page_id_t page_id = bpm->NewPage();
+    EXPECT_THROW(Tree::Open("nothing", page_id, bpm.get(), comparator), std::runtime_error);
+}
+
+TEST_F(BPlusTreeSingleTest, BulkLoadBuildsSearchableTree) {
+    using Tree = BPlusTree<IntegerKey, RID, IntegerKeyComparator>;
+    for(int n : {1, 17, 33, 1000, 5000}) {
+        for(double fill : {1.0, 0.7, 0.1}) {
+            page_id_t header = bpm->NewPage();
+            Tree bulk("bulk", header, bpm.get(), comparator, 32, 32);
+            std::vector<std::pair<IntegerKey, RID>> entries;
+            for(int i=0;i<n;i++) entries.emplace_back(IntegerKey(2*i), RID(2*i,0));
+            bulk.BulkLoad(entries, fill);
+            int expect = 0;
+            for(auto it = bulk.Begin(); it != bulk.End(); ++it, expect += 2) {
+                ASSERT_EQ((*it).first.GetValue(), expect) << "n=" << n << " fill=" << fill;
+            }
+            ASSERT_EQ(expect, 2*n);
+            std::vector<RID> r;
+            ASSERT_TRUE(bulk.GetValue(IntegerKey(2*(n-1)), &r));
+            EXPECT_FALSE(bulk.GetValue(IntegerKey(1), &r));
+            // the loaded tree is an ordinary tree: odd keys go in, even keys come out
+            for(int i=0;i<n;i++) ASSERT_TRUE(bulk.Insert(IntegerKey(2*i+1), RID(2*i+1,0)));
+            for(int i=0;i<n;i++) bulk.Remove(IntegerKey(2*i));
+            expect = 1;
+            for(auto it = bulk.Begin(); it != bulk.End(); ++it, expect += 2) {
+                ASSERT_EQ((*it).first.GetValue(), expect);
+            }
+            ASSERT_EQ(expect, 2*n+1);
+        }
+    }
+}
+
+TEST_F(BPlusTreeSingleTest, BulkLoadPacksLeaves) {
+    std::vector<std::pair<IntegerKey, RID>> entries;
+    for(int i=0;i<3200;i++) entries.emplace_back(IntegerKey(i), RID(i,0));
+    tree->BulkLoad(entries);
+    // full leaves: 100 of them, where inserting in order leaves every leaf half full
+    page_id_t page_id = tree->GetRootPageId();
+    while(!bpm->ReadPage(page_id).As<BPlusTreePage>()->IsLeafPage()) {
+        page_id = bpm->ReadPage(page_id).As<BPlusTreeInternalPage<IntegerKey, page_id_t, IntegerKeyComparator>>()->ValueAt(0);
+    }
+    int leaves = 0;
+    while(page_id != INVALID_PAGE_ID) {
+        auto guard = bpm->ReadPage(page_id);
+        auto leaf = guard.As<BPlusTreeLeafPage<IntegerKey, RID, IntegerKeyComparator>>();
+        EXPECT_EQ(leaf->GetSize(), 32);
+        page_id = leaf->GetNextPageId();
+        leaves++;
+    }
+    EXPECT_EQ(leaves, 100);
+}
+
+TEST_F(BPlusTreeSingleTest, BulkLoadRejectsBadInput) {
+    std::vector<std::pair<IntegerKey, RID>> unsorted{{IntegerKey(2), RID(2,0)}, {IntegerKey(1), RID(1,0)}};
+    EXPECT_THROW(tree->BulkLoad(unsorted), std::runtime_error);
+    std::vector<std::pair<IntegerKey, RID>> duplicate{{IntegerKey(1), RID(1,0)}, {IntegerKey(1), RID(1,0)}};
+    EXPECT_THROW(tree->BulkLoad(duplicate), std::runtime_error);
+    std::vector<std::pair<IntegerKey, RID>> sorted{{IntegerKey(1), RID(1,0)}, {IntegerKey(2), RID(2,0)}};
+    EXPECT_THROW(tree->BulkLoad(sorted, 0.0), std::invalid_argument);
+    EXPECT_TRUE(tree->IsEmpty());
+    tree->BulkLoad(sorted);
+    EXPECT_THROW(tree->BulkLoad(sorted), std::runtime_error);
+}
+
+// BulkLoad against one Insert per key for the same sorted input.
+TEST_F(BPlusTreeSingleTest, BulkLoadBenchmark) {
+    using Tree = BPlusTree<IntegerKey, RID, IntegerKeyComparator>;
+    const int n = 50000;
+    std::vector<std::pair<IntegerKey, RID>> entries;
+    for(int i=0;i<n;i++) entries.emplace_back(IntegerKey(i), RID(i,0));
+
+    auto start = std::chrono::steady_clock::now();
+    Tree inserted("inserted", bpm->NewPage(), bpm.get(), comparator);
+    for(const auto &[key, rid] : entries) inserted.Insert(key, rid);
+    double insert_secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    start = std::chrono::steady_clock::now();
+    Tree loaded("loaded", bpm->NewPage(), bpm.get(), comparator);
+    loaded.BulkLoad(entries);
+    double load_secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::cout << "[BulkLoad] keys=" << n
+              << " insert keys/s=" << static_cast<long>(n / insert_secs)
+              << " bulk load keys/s=" << static_cast<long>(n / load_secs)
+              << " speedup=" << insert_secs / load_secs << "x\n";
+    std::vector<RID> r;
+    EXPECT_TRUE(loaded.GetValue(IntegerKey(n-1), &r));
+}
+
+TEST_F(BPlusTreeSingleTest, BulkLoadUnsortedSortsAndLinksRuns) {
+    using Tree = BPlusTree<IntegerKey, RID, IntegerKeyComparator>;
+    std::mt19937 rng(7);
+    for(int n : {0, 1, 100, 30000}) {
+        for(size_t threads : {1, 3, 8}) {
+            // negative keys too, and keys spread over all four radix digits
+            std::vector<std::pair<IntegerKey, RID>> entries;
+            std::set<int> keys;
+            std::uniform_int_distribution<int> dist(-2000000000, 2000000000);
+            while((int)keys.size() < n) {
+                int k = dist(rng);
+                if(keys.insert(k).second) entries.emplace_back(IntegerKey(k), RID(k, 0));
+            }
+            Tree bulk("bulk", bpm->NewPage(), bpm.get(), comparator, 32, 32);
+            bulk.BulkLoadUnsorted(entries, threads);
+            auto expect = keys.begin();
+            for(auto it = bulk.Begin(); it != bulk.End(); ++it, ++expect) {
+                ASSERT_TRUE(expect != keys.end());
+                ASSERT_EQ((*it).first.GetValue(), *expect) << "n=" << n << " threads=" << threads;
+                ASSERT_EQ((*it).second.page_id, *expect);
+            }
+            ASSERT_TRUE(expect == keys.end());
+            if(n > 0) {
+                std::vector<RID> r;
+                EXPECT_TRUE(bulk.GetValue(IntegerKey(*keys.rbegin()), &r));
+                bulk.Remove(IntegerKey(*keys.begin()));
+                EXPECT_FALSE(bulk.GetValue(IntegerKey(*keys.begin()), &r));
+            }
+        }
+    }
+    std::vector<std::pair<IntegerKey, RID>> duplicate{{IntegerKey(5), RID(5,0)}, {IntegerKey(1), RID(1,0)}, {IntegerKey(5), RID(5,0)}};
+    EXPECT_THROW(tree->BulkLoadUnsorted(duplicate), std::runtime_error);
+    EXPECT_TRUE(tree->IsEmpty());
+}
+
+// Index creation from shuffled input: parallel radix sort plus leaf runs, for 1..8 threads.
+TEST_F(BPlusTreeSingleTest, BulkLoadUnsortedBenchmark) {
+    using Tree = BPlusTree<IntegerKey, RID, IntegerKeyComparator>;
+    const int n = 400000;
+    std::vector<std::pair<IntegerKey, RID>> entries;
+    for(int i=0;i<n;i++) entries.emplace_back(IntegerKey(i), RID(i,0));
+    std::shuffle(entries.begin(), entries.end(), std::mt19937(1));
+    for(size_t threads : {1, 2, 4, 8}) {
+        Tree loaded("loaded", bpm->NewPage(), bpm.get(), comparator);
+        auto start = std::chrono::steady_clock::now();
+        loaded.BulkLoadUnsorted(entries, threads);
+        double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::cout << "[BulkLoadUnsorted] keys=" << n << " threads=" << threads
+                  << " keys/s=" << static_cast<long>(n / secs) << "\n";
+        std::vector<RID> r;
+        ASSERT_TRUE(loaded.GetValue(IntegerKey(n/2), &r));
+    }
+}
+
+TEST_F(BPlusTreeSingleTest, ScanRangeReturnsLeafBatches) {
+    for(int i=0;i<2000;i++) tree->Insert(IntegerKey(2*i), RID(2*i,0));
+    std::vector<std::pair<IntegerKey, RID>> out;
+    // bounds between keys, on keys, and past both ends
+    EXPECT_EQ(tree->ScanRange(IntegerKey(101), IntegerKey(1001), &out), 450);
+    ASSERT_EQ(out.size(), 450);
+    for(size_t i=0;i<out.size();i++) {
+        ASSERT_EQ(out[i].first.GetValue(), 102 + 2*(int)i);
+        ASSERT_EQ(out[i].second.page_id, 102 + 2*(int)i);
+    }
+    out.clear();
+    EXPECT_EQ(tree->ScanRange(IntegerKey(100), IntegerKey(100), &out), 1);
+    out.clear();
+    EXPECT_EQ(tree->ScanRange(IntegerKey(-50), IntegerKey(10000), &out), 2000);
+    out.clear();
+    EXPECT_EQ(tree->ScanRange(IntegerKey(10), IntegerKey(5), &out), 0);
+    EXPECT_EQ(tree->ScanRange(IntegerKey(5000), IntegerKey(6000), &out), 0);
+
+    // every batch is one leaf's worth at most, and returning false stops the scan
+    size_t batches = 0;
+    size_t seen = tree->ScanRange(IntegerKey(0), IntegerKey(4000),
+        [&](std::span<const IntegerKey> keys, std::span<const RID> values) {
+            EXPECT_EQ(keys.size(), values.size());
+            EXPECT_LE(keys.size(), 32u);
+            return ++batches < 3;
+        });
+    EXPECT_EQ(batches, 3u);
+    EXPECT_LT(seen, 2000u);
+
+    BPlusTree<IntegerKey, RID, IntegerKeyComparator> empty("empty", bpm->NewPage(), bpm.get(), comparator);
+    EXPECT_EQ(empty.ScanRange(IntegerKey(0), IntegerKey(10), &out), 0);
+}
+
+TEST_F(BPlusTreeSingleTest, GetValuesMatchesGetValue) {
+    std::vector<std::optional<RID>> results;
+    std::vector<IntegerKey> none = {IntegerKey(1)};
+    EXPECT_EQ(tree->GetValues(none, &results), 0u);
+    ASSERT_EQ(results.size(), 1u);
+    EXPECT_FALSE(results[0].has_value());
+
+    for(int i=0;i<3000;i++) tree->Insert(IntegerKey(3*i), RID(3*i,0));
+    // unsorted, with repeats and with keys past both ends
+    std::vector<IntegerKey> probes;
+    std::mt19937 rng(3);
+    for(int i=0;i<5000;i++) probes.emplace_back(static_cast<int>(rng() % 9100) - 50);
+    probes.emplace_back(0);
+    probes.emplace_back(0);
+    size_t found = tree->GetValues(probes, &results);
+    ASSERT_EQ(results.size(), probes.size());
+    size_t expected_found = 0;
+    for(size_t i=0;i<probes.size();i++) {
+        std::vector<RID> r;
+        bool hit = tree->GetValue(probes[i], &r);
+        ASSERT_EQ(results[i].has_value(), hit) << probes[i].GetValue();
+        if(hit) {
+            EXPECT_EQ(results[i]->page_id, r[0].page_id);
+            expected_found++;
+        }
+    }
+    EXPECT_EQ(found, expected_found);
+    EXPECT_EQ(tree->GetValues(std::span<const IntegerKey>(), &results), 0u);
+    EXPECT_TRUE(results.empty());
+}
+
+// GetValues against one GetValue per key on a tree larger than the pool, probing a sorted
+// tenth of the keys so leaves are shared and the child prefetch has reads to overlap.
+TEST_F(BPlusTreeSingleTest, GetValuesBenchmark) {
+    using Tree = BPlusTree<IntegerKey, RID, IntegerKeyComparator>;
+    const int n = 100000;
+    BufferPoolManager small_bpm(64, disk_manager.get());
+    Tree probe_tree("probe", small_bpm.NewPage(), &small_bpm, comparator);
+    std::vector<std::pair<IntegerKey, RID>> entries;
+    for(int i=0;i<n;i++) entries.emplace_back(IntegerKey(i), RID(i,0));
+    probe_tree.BulkLoad(entries);
+    std::vector<IntegerKey> probes;
+    std::mt19937 rng(9);
+    for(int i=0;i<n/10;i++) probes.emplace_back(static_cast<int>(rng() % n));
+
+    uint64_t reads = small_bpm.GetDiskReads();
+    auto start = std::chrono::steady_clock::now();
+    size_t single_found = 0;
+    std::vector<RID> r;
+    for(const auto &key : probes) {
+        r.clear();
+        single_found += probe_tree.GetValue(key, &r) ? 1 : 0;
+    }
+    double single_secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    uint64_t single_reads = small_bpm.GetDiskReads() - reads;
+
+    reads = small_bpm.GetDiskReads();
+    start = std::chrono::steady_clock::now();
+    std::vector<std::optional<RID>> results;
+    size_t batch_found = probe_tree.GetValues(probes, &results);
+    double batch_secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    uint64_t batch_reads = small_bpm.GetDiskReads() - reads;
+
+    std::cout << "[GetValues] probes=" << probes.size()
+              << " GetValue lookups/s=" << static_cast<long>(probes.size() / single_secs)
+              << " GetValues lookups/s=" << static_cast<long>(probes.size() / batch_secs)
+              << " speedup=" << single_secs / batch_secs << "x"
+              << " page reads " << single_reads << " -> " << batch_reads << "\n";
+    EXPECT_EQ(single_found, probes.size());
+    EXPECT_EQ(batch_found, probes.size());
+}
+
+// prev_page_id_ must survive splits, merges and both bulk loads for reverse iteration to see
+// exactly the forward sequence backwards
+TEST_F(BPlusTreeSingleTest, ReverseIterationFollowsPrevLinks) {
+    auto collect_reverse = [](BPlusTree<IntegerKey, RID, IntegerKeyComparator> &t) {
+        std::vector<int> keys;
+        for(auto it = t.RBegin(); it != t.REnd(); --it) keys.push_back((*it).first.GetValue());
+        return keys;
+    };
+    std::vector<int> order(1000);
+    for(int i=0;i<1000;i++) order[i] = i;
+    std::shuffle(order.begin(), order.end(), std::mt19937(7));
+    for(int k: order) tree->Insert(IntegerKey(k), RID(k,0));
+    for(int i=0;i<1000;i++) if(i % 3 != 0) tree->Remove(IntegerKey(i));
+    std::vector<int> expected;
+    for(int i=999;i>=0;i--) if(i % 3 == 0) expected.push_back(i);
+    EXPECT_EQ(collect_reverse(*tree), expected);
+
+    // at the key, between keys, past either end
+    EXPECT_EQ((*tree->RBegin(IntegerKey(300))).first.GetValue(), 300);
+    EXPECT_EQ((*tree->RBegin(IntegerKey(302))).first.GetValue(), 300);
+    EXPECT_EQ((*tree->RBegin(IntegerKey(5000))).first.GetValue(), 999);
+    EXPECT_TRUE(tree->RBegin(IntegerKey(-1)) == tree->REnd());
+    // both directions on one iterator, across leaf boundaries
+    auto it = tree->Begin(IntegerKey(90));
+    for(int i=0;i<40;i++) ++it;
+    for(int i=0;i<40;i++) --it;
+    EXPECT_EQ((*it).first.GetValue(), 90);
+    auto first = tree->Begin();
+    --first;
+    EXPECT_TRUE(first.IsEnd());
+    EXPECT_THROW(--first, std::out_of_range);
+
+    std::vector<std::pair<IntegerKey, RID>> entries;
+    for(int i=0;i<5000;i++) entries.emplace_back(IntegerKey(i), RID(i,0));
+    std::shuffle(entries.begin(), entries.end(), std::mt19937(11));
+    BPlusTree<IntegerKey, RID, IntegerKeyComparator> loaded("loaded", bpm->NewPage(), bpm.get(), comparator, 32, 32);
+    loaded.BulkLoadUnsorted(entries, 4, 0.7);
+    auto keys = collect_reverse(loaded);
+    ASSERT_EQ(keys.size(), 5000u);
+    for(int i=0;i<5000;i++) ASSERT_EQ(keys[i], 4999 - i);
+}
+
+TEST_F(BPlusTreeSingleTest, DescendingScanRange) {
+    for(int i=0;i<2000;i++) tree->Insert(IntegerKey(2*i), RID(2*i,0));
+    std::vector<std::pair<IntegerKey, RID>> out;
+    EXPECT_EQ(tree->ScanRange(IntegerKey(101), IntegerKey(1001), &out, ScanOrder::DESCENDING), 450);
+    ASSERT_EQ(out.size(), 450);
+    for(size_t i=0;i<out.size();i++) ASSERT_EQ(out[i].first.GetValue(), 1000 - 2*(int)i);
+    out.clear();
+    EXPECT_EQ(tree->ScanRange(IntegerKey(-50), IntegerKey(10000), &out, ScanOrder::DESCENDING), 2000);
+    out.clear();
+    EXPECT_EQ(tree->ScanRange(IntegerKey(10), IntegerKey(5), &out, ScanOrder::DESCENDING), 0);
+
+    // top 10 keys below 3001: stop after the first batches hold enough
+    std::vector<int> top;
+    tree->ScanRange(IntegerKey(0), IntegerKey(3000),
+        [&](std::span<const IntegerKey> keys, std::span<const RID>) {
+            for(size_t i=keys.size(); i>0 && top.size()<10; i--) top.push_back(keys[i-1].GetValue());
+            return top.size() < 10;
+        }, ScanOrder::DESCENDING);
+    ASSERT_EQ(top.size(), 10u);
+    for(int i=0;i<10;i++) EXPECT_EQ(top[i], 3000 - 2*i);
+}
+
+// A full range scan through ScanRange against the per-key IndexIterator, with a pool too
+// small for the tree so the next-leaf prefetch has something to do.
+TEST_F(BPlusTreeSingleTest, ScanRangeBenchmark) {
+    using Tree = BPlusTree<IntegerKey, RID, IntegerKeyComparator>;
+    const int n = 50000;
+    BufferPoolManager small_bpm(32, disk_manager.get());
+    Tree scan_tree("scan", small_bpm.NewPage(), &small_bpm, comparator);
+    std::vector<std::pair<IntegerKey, RID>> entries;
+    for(int i=0;i<n;i++) entries.emplace_back(IntegerKey(i), RID(i,0));
+    scan_tree.BulkLoad(entries);
+
+    auto start = std::chrono::steady_clock::now();
+    long sum_iter = 0;
+    auto end = scan_tree.End();
+    for(auto it = scan_tree.Begin(); it != end; ++it) sum_iter += (*it).first.GetValue();
+    double iter_secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    uint64_t prefetches = small_bpm.GetPrefetchReads();
+    start = std::chrono::steady_clock::now();
+    long sum_scan = 0;
+    size_t count = scan_tree.ScanRange(IntegerKey(0), IntegerKey(n),
+        [&](std::span<const IntegerKey> keys, std::span<const RID>) {
+            for(const auto &key : keys) sum_scan += key.GetValue();
+            return true;
+        });
+    double scan_secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::cout << "[ScanRange] keys=" << n
+              << " iterator keys/s=" << static_cast<long>(n / iter_secs)
+              << " scan keys/s=" << static_cast<long>(n / scan_secs)
+              << " speedup=" << iter_secs / scan_secs << "x"
+              << " prefetched=" << small_bpm.GetPrefetchReads() - prefetches << "\n";
+    EXPECT_EQ(count, (size_t)n);
+    EXPECT_EQ(sum_scan, sum_iter);
+}
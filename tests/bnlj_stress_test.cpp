@@ -9,6 +9,7 @@
 #include "bnlj.h"
 #include "buffer_pool_manager.h"
 #include "disk_manager_memory.h"
+#include "test_disk_manager.h"
 #include "page.h"
 #include "types.h"
 
@@ -26,7 +27,7 @@ class BNLJStress : public ::testing::Test {
  protected:
   void SetUp() override {
     pool_ = GetEnvInt("BNLJ_POOL", 128);
-    disk_ = std::make_unique<DiskManagerMemory>();
+    disk_ = MakeTestDiskManager();
     bpm_ = std::make_unique<BufferPoolManager>(pool_, disk_.get());
   }
   void TearDown() override {
@@ -34,7 +35,7 @@ class BNLJStress : public ::testing::Test {
     disk_.reset();
   }
 
-  std::unique_ptr<DiskManagerMemory> disk_;
+  std::unique_ptr<DiskManager> disk_;
   std::unique_ptr<BufferPoolManager> bpm_;
   int pool_{};
 };
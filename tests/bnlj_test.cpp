@@ -6,6 +6,7 @@
 #include "bnlj.h"
 #include "buffer_pool_manager.h"
 #include "disk_manager_memory.h"
+#include "test_disk_manager.h"
 #include "page.h"
 #include "types.h"
 
@@ -14,7 +15,7 @@ using namespace bicycletub;
 class BNLJTest : public ::testing::Test {
  protected:
   void SetUp() override {
-    disk_ = std::make_unique<DiskManagerMemory>();
+    disk_ = MakeTestDiskManager();
     bpm_ = std::make_unique<BufferPoolManager>(pool_size, disk_.get());
   }
   void TearDown() override {
@@ -23,7 +24,7 @@ class BNLJTest : public ::testing::Test {
   }
 
   static constexpr size_t pool_size = 64; // align with our test style
-  std::unique_ptr<DiskManagerMemory> disk_;
+  std::unique_ptr<DiskManager> disk_;
   std::unique_ptr<BufferPoolManager> bpm_;
 };
 
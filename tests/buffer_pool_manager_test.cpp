@@ -30,6 +30,8 @@
 
 #include "buffer_pool_manager.h"
 #include "disk_manager_memory.h"
+#include "log_manager.h"
+#include "test_disk_manager.h"
 #include "types.h"
 
 using namespace bicycletub;
@@ -37,7 +39,7 @@ using namespace bicycletub;
 class BufferPoolManagerTest : public ::testing::Test {
 protected:
     void SetUp() override {
-        disk_manager = std::make_unique<DiskManagerMemory>();
+        disk_manager = MakeTestDiskManager();
         bpm = std::make_unique<BufferPoolManager>(pool_size, disk_manager.get());
     }
 
@@ -47,7 +49,7 @@ protected:
     }
 
     static constexpr size_t pool_size = 1000;
-    std::unique_ptr<DiskManagerMemory> disk_manager;
+    std::unique_ptr<DiskManager> disk_manager;
     std::unique_ptr<BufferPoolManager> bpm;
 };
 
@@ -132,6 +134,68 @@ TEST_F(BufferPoolManagerTest, PageEviction) {
     }
 }
 
+TEST_F(BufferPoolManagerTest, PrefetchServesLaterRead) {
+    // 小缓冲池：写满 16 页后前面的页都已被驱逐
+    BufferPoolManager small_bpm(8, disk_manager.get());
+    std::vector<page_id_t> page_ids;
+    for (int i = 0; i < 16; ++i) {
+        page_ids.push_back(small_bpm.NewPage());
+        auto write_guard = small_bpm.WritePage(page_ids.back());
+        snprintf(write_guard.GetDataMut(), PAGE_SIZE, "Prefetch page %d", i);
+    }
+    small_bpm.Prefetch(page_ids[0]);
+    EXPECT_EQ(small_bpm.GetPrefetchReads(), 1);
+    // 已在缓冲池中的页不会再预取
+    small_bpm.Prefetch(page_ids[15]);
+    EXPECT_EQ(small_bpm.GetPrefetchReads(), 1);
+    // 读取时不再同步读盘（mmap 后端下预取只是让内核预读）
+    uint64_t disk_reads = small_bpm.GetDiskReads();
+    {
+        auto read_guard = small_bpm.ReadPage(page_ids[0]);
+        EXPECT_STREQ(read_guard.GetData(), "Prefetch page 0");
+    }
+    EXPECT_EQ(small_bpm.GetDiskReads(), disk_reads);
+
+    // 预取后从未访问的页在读完成后也可以被驱逐，缓冲池不会被占满
+    for (int i = 1; i < 4; ++i) {
+        small_bpm.Prefetch(page_ids[i]);
+    }
+    for (int round = 0; round < 3; ++round) {
+        for (int i = 4; i < 16; ++i) {
+            auto read_guard = small_bpm.ReadPage(page_ids[i]);
+            char expected[32];
+            snprintf(expected, sizeof(expected), "Prefetch page %d", i);
+            EXPECT_STREQ(read_guard.GetData(), expected);
+        }
+    }
+}
+
+TEST_F(BufferPoolManagerTest, WriteBackSkipsPendingPrefetch) {
+    // 预取中的帧尚未交给置换器，刷写与检查点都必须跳过它，且不能泄漏 pin
+    TempLogPath log_path;
+    LogManager log(log_path.Path());
+    BufferPoolManager small_bpm(8, disk_manager.get(), &log);
+    std::vector<page_id_t> page_ids;
+    for (int i = 0; i < 16; ++i) {
+        page_ids.push_back(small_bpm.NewPage());
+        auto write_guard = small_bpm.WritePage(page_ids.back());
+        snprintf(write_guard.GetDataMut(), PAGE_SIZE, "Flush page %d", i);
+    }
+    small_bpm.Prefetch(page_ids[0]);
+    EXPECT_NO_THROW(small_bpm.FlushAllPages());
+    small_bpm.Prefetch(page_ids[1]);
+    EXPECT_NO_THROW(small_bpm.Checkpoint());
+    // 所有帧仍可被驱逐：完整读一遍全部页面
+    for (int round = 0; round < 2; ++round) {
+        for (int i = 0; i < 16; ++i) {
+            auto read_guard = small_bpm.ReadPage(page_ids[i]);
+            char expected[32];
+            snprintf(expected, sizeof(expected), "Flush page %d", i);
+            EXPECT_STREQ(read_guard.GetData(), expected);
+        }
+    }
+}
+
 TEST_F(BufferPoolManagerTest, FlushPage) {
     auto page_id = bpm->NewPage();
     
@@ -645,6 +709,10 @@ TEST_F(BufferPoolManagerTest, InvalidPageAccess) {
 // ======== 性能测试 ========
 
 TEST_F(BufferPoolManagerTest, PerformanceBaseline) {
+    // 计时断言只在默认后端上检查：后端变体与默认测试并行运行，耗时没有可比性
+    if (IsBackendVariant()) {
+        GTEST_SKIP() << "timing baseline runs on the default backend only";
+    }
     // 调整测试规模以适应你的实现：
     // - 由于缓冲池只有10个帧，创建太多页面会导致频繁驱逐
     // - DiskManagerMemory在页面被驱逐后重新读取时会返回全零数据
@@ -0,0 +1,249 @@
+#include <gtest/gtest.h>
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "buffer_pool_manager.h"
+#include "checksum_disk_manager.h"
+#include "crc32c.h"
+#include "disk_manager_memory.h"
+#include "disk_scheduler.h"
+#include "test_disk_manager.h"
+#include "types.h"
+#ifndef _WIN32
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+using namespace bicycletub;
+
+namespace {
+// flips one byte of a stored page behind the checksum layer's back
+void CorruptPage(DiskManager &inner, page_id_t page_id) {
+  std::array<char, PAGE_SIZE> buf{};
+  inner.ReadPage(page_id, buf.data());
+  buf[PAGE_SIZE / 3] ^= 0x10;
+  inner.WritePage(page_id, buf.data());
+}
+}  // namespace
+
+TEST(ChecksumTest, Crc32cKnownValueAndFallbackAgree) {
+  EXPECT_EQ(Crc32c("123456789", 9), 0xE3069283u);
+  EXPECT_EQ(Crc32cPortable("123456789", 9), 0xE3069283u);
+  std::mt19937 rng(11);
+  std::vector<char> data(PAGE_SIZE + 13);
+  for (auto &c : data) {
+    c = static_cast<char>(rng());
+  }
+  for (size_t len : {size_t{0}, size_t{1}, size_t{7}, size_t{8}, size_t{100}, data.size()}) {
+    EXPECT_EQ(Crc32c(data.data() + 1, len - (len > 0 ? 1 : 0)), Crc32cPortable(data.data() + 1, len - (len > 0 ? 1 : 0)));
+  }
+  // chaining equals one pass
+  EXPECT_EQ(Crc32c(data.data() + 100, 200, Crc32c(data.data(), 100)), Crc32c(data.data(), 300));
+}
+
+TEST(ChecksumTest, MismatchThrowsPageCorruptionError) {
+  DiskManagerMemory inner;
+  ChecksumDiskManager disk(&inner);
+  std::array<char, PAGE_SIZE> out{}, in{};
+  std::snprintf(out.data(), PAGE_SIZE, "checked");
+  disk.WritePage(4, out.data());
+  disk.ReadPage(4, in.data());
+  EXPECT_STREQ(in.data(), "checked");
+  // never written through the decorator: nothing to verify
+  disk.ReadPage(5, in.data());
+
+  CorruptPage(inner, 4);
+  try {
+    disk.ReadPage(4, in.data());
+    FAIL() << "corruption not detected";
+  } catch (const PageCorruptionError &e) {
+    EXPECT_EQ(e.GetPageId(), 4);
+  }
+  EXPECT_EQ(disk.GetCorruptReads(), 1u);
+
+  // rewriting the page heals it
+  disk.WritePage(4, out.data());
+  disk.ReadPage(4, in.data());
+  EXPECT_EQ(disk.GetVerifiedReads(), 3u);
+}
+
+TEST(ChecksumTest, SchedulerIsolatesCorruptPageInRun) {
+  DiskManagerMemory inner;
+  ChecksumDiskManager disk(&inner);
+  std::array<char, PAGE_SIZE> page{};
+  for (page_id_t id = 0; id < 8; id++) {
+    page[0] = static_cast<char>('a' + id);
+    disk.WritePage(id, page.data());
+  }
+  CorruptPage(inner, 5);
+
+  DiskScheduler scheduler(&disk);
+  std::vector<std::array<char, PAGE_SIZE>> bufs(8);
+  std::vector<DiskCompletion> done(8);
+  std::vector<DiskRequest> requests;
+  for (page_id_t id = 0; id < 8; id++) {
+    done[id].Reset();
+    requests.push_back({false, bufs[id].data(), id, &done[id]});
+  }
+  scheduler.Schedule(requests);
+  for (page_id_t id = 0; id < 8; id++) {
+    EXPECT_EQ(done[id].Wait(), id != 5);
+    EXPECT_EQ(done[id].IsCorrupted(), id == 5);
+    if (id != 5) {
+      EXPECT_EQ(bufs[id][0], 'a' + id);
+    }
+  }
+}
+
+TEST(ChecksumTest, BufferPoolSurfacesCorruption) {
+  DiskManagerMemory inner;
+  ChecksumDiskManager disk(&inner);
+  BufferPoolManager bpm(4, &disk);
+  const int n = 16;
+  for (int i = 0; i < n; i++) {
+    page_id_t page_id = bpm.NewPage();
+    std::snprintf(bpm.WritePage(page_id).GetDataMut(), PAGE_SIZE, "row %d", i);
+  }
+  bpm.FlushAllPages();
+  // make sure page 0 has been evicted before it is damaged
+  for (int i = n - 4; i < n; i++) {
+    bpm.ReadPage(i);
+  }
+  CorruptPage(inner, 0);
+  EXPECT_THROW(bpm.ReadPage(0), PageCorruptionError);
+  // the frame was released: the page is not served from it later, and the pool still works
+  EXPECT_THROW(bpm.WritePage(0), PageCorruptionError);
+  for (int i = 1; i < n; i++) {
+    char expected[32];
+    std::snprintf(expected, sizeof(expected), "row %d", i);
+    EXPECT_STREQ(bpm.ReadPage(i).GetData(), expected);
+  }
+}
+
+#ifndef _WIN32
+TEST(ChecksumTest, SidecarSurvivesRestart) {
+  std::string path = TempDataFilePath("crc");
+  std::string crc_path = path + ".crc";
+  std::array<char, PAGE_SIZE> page{};
+  {
+    DiskManagerFile file(path);
+    ChecksumDiskManager disk(&file, crc_path);
+    for (page_id_t id = 0; id < 10; id++) {
+      page[0] = static_cast<char>(id);
+      disk.WritePage(id, page.data());
+    }
+  }
+  {
+    DiskManagerFile file(path);
+    CorruptPage(file, 7);
+  }
+  {
+    DiskManagerFile file(path);
+    ChecksumDiskManager disk(&file, crc_path);
+    disk.ReadPage(6, page.data());
+    EXPECT_EQ(page[0], 6);
+    EXPECT_THROW(disk.ReadPage(7, page.data()), PageCorruptionError);
+  }
+  std::filesystem::remove(path);
+  std::filesystem::remove(crc_path);
+}
+
+// A child process rewrites a page and dies before the sidecar is saved again, so the saved
+// checksum of that page is stale; the reopened manager must not report it as corrupt.
+TEST(ChecksumTest, UncleanShutdownDropsStaleChecksums) {
+  std::string path = TempDataFilePath("crc");
+  std::string crc_path = path + ".crc";
+  std::array<char, PAGE_SIZE> page{};
+  {
+    DiskManagerFile file(path);
+    ChecksumDiskManager disk(&file, crc_path);
+    for (page_id_t id = 0; id < 10; id++) {
+      page[0] = static_cast<char>(id);
+      disk.WritePage(id, page.data());
+    }
+    disk.Sync();
+  }
+  pid_t pid = ::fork();
+  ASSERT_GE(pid, 0);
+  if (pid == 0) {
+    DiskManagerFile file(path);
+    ChecksumDiskManager disk(&file, crc_path);
+    page[0] = 42;
+    disk.WritePage(3, page.data());
+    ::_exit(0);  // no Sync, no destructors
+  }
+  int status = 0;
+  ASSERT_EQ(::waitpid(pid, &status, 0), pid);
+  ASSERT_TRUE(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+  {
+    DiskManagerFile file(path);
+    ChecksumDiskManager disk(&file, crc_path);
+    EXPECT_TRUE(disk.LoadedDirtySidecar());
+    disk.ReadPage(3, page.data());
+    EXPECT_EQ(page[0], 42);
+    disk.ReadPage(4, page.data());
+    EXPECT_EQ(page[0], 4);
+    EXPECT_EQ(disk.GetCorruptReads(), 0u);
+    // a page written again is checked again
+    disk.WritePage(5, page.data());
+    CorruptPage(file, 5);
+    EXPECT_THROW(disk.ReadPage(5, page.data()), PageCorruptionError);
+  }
+  {
+    DiskManagerFile file(path);
+    ChecksumDiskManager disk(&file, crc_path);
+    EXPECT_FALSE(disk.LoadedDirtySidecar());
+    EXPECT_THROW(disk.ReadPage(5, page.data()), PageCorruptionError);
+  }
+  std::filesystem::remove(path);
+  std::filesystem::remove(crc_path);
+}
+#endif
+
+// Cost of a checksum per page I/O: the bare CRC and a memory-backed read/write with and
+// without the decorator.
+TEST(ChecksumTest, OverheadPerPageBenchmark) {
+  const int pages = 1024;
+  const int rounds = 50;
+  std::vector<std::array<char, PAGE_SIZE>> images(pages);
+  std::mt19937 rng(5);
+  for (auto &image : images) {
+    for (auto &c : image) {
+      c = static_cast<char>(rng());
+    }
+  }
+  auto ns_per_page = [&](auto &&fn) {
+    auto start = std::chrono::steady_clock::now();
+    for (int r = 0; r < rounds; r++) {
+      for (int i = 0; i < pages; i++) {
+        fn(i);
+      }
+    }
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() /
+           (static_cast<double>(rounds) * pages);
+  };
+  volatile uint32_t sink = 0;
+  double hw = ns_per_page([&](int i) { sink = sink + Crc32c(images[i].data(), PAGE_SIZE); });
+  double sw = ns_per_page([&](int i) { sink = sink + Crc32cPortable(images[i].data(), PAGE_SIZE); });
+
+  std::array<char, PAGE_SIZE> buf{};
+  DiskManagerMemory plain;
+  DiskManagerMemory inner;
+  ChecksumDiskManager checked(&inner);
+  double plain_write = ns_per_page([&](int i) { plain.WritePage(i, images[i].data()); });
+  double plain_read = ns_per_page([&](int i) { plain.ReadPage(i, buf.data()); });
+  double checked_write = ns_per_page([&](int i) { checked.WritePage(i, images[i].data()); });
+  double checked_read = ns_per_page([&](int i) { checked.ReadPage(i, buf.data()); });
+  std::cout << "[crc32c] " << (Crc32cIsHardware() ? "sse4.2" : "portable") << "=" << hw << "ns/page portable=" << sw
+            << "ns/page" << std::endl;
+  std::cout << "[crc32c] memory write " << plain_write << " -> " << checked_write << "ns/page, read " << plain_read
+            << " -> " << checked_read << "ns/page" << std::endl;
+  EXPECT_EQ(checked.GetCorruptReads(), 0u);
+}
@@ -0,0 +1,230 @@
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "buffer_pool_manager.h"
+#include "disk_manager_file.h"
+#include "disk_scheduler.h"
+#include "test_disk_manager.h"
+#include "types.h"
+
+using namespace bicycletub;
+
+class DiskManagerFileTest : public ::testing::Test {
+ protected:
+  void SetUp() override { path_ = TempDataFilePath("dmf"); }
+  void TearDown() override {
+    std::error_code ec;
+    std::filesystem::remove(path_, ec);
+  }
+
+  std::string path_;
+};
+
+TEST_F(DiskManagerFileTest, RoundTripAndUnwrittenPagesAreZero) {
+  DiskManagerFile disk(path_);
+  std::array<char, PAGE_SIZE> out{}, in{};
+  std::snprintf(out.data(), PAGE_SIZE, "page five");
+  disk.WritePage(5, out.data());
+  EXPECT_EQ(disk.NumPages(), 6u);
+
+  disk.ReadPage(5, in.data());
+  EXPECT_STREQ(in.data(), "page five");
+
+  // a hole inside the file and a page past its end both read back as zeros
+  in.fill('x');
+  disk.ReadPage(2, in.data());
+  EXPECT_TRUE(std::all_of(in.begin(), in.end(), [](char c) { return c == 0; }));
+  in.fill('x');
+  disk.ReadPage(100, in.data());
+  EXPECT_TRUE(std::all_of(in.begin(), in.end(), [](char c) { return c == 0; }));
+}
+
+TEST_F(DiskManagerFileTest, VectoredRunsAndPersistence) {
+  const int n = 300;  // more than one iovec chunk
+  std::vector<std::array<char, PAGE_SIZE>> pages(n);
+  std::vector<const char *> out_ptrs;
+  for (int i = 0; i < n; i++) {
+    std::snprintf(pages[i].data(), PAGE_SIZE, "vectored %d", i);
+    out_ptrs.push_back(pages[i].data());
+  }
+  {
+    DiskManagerFile disk(path_);
+    disk.WritePages(10, out_ptrs.data(), n);
+    disk.Sync();
+  }
+  DiskManagerFile reopened(path_);
+  EXPECT_EQ(reopened.NumPages(), static_cast<size_t>(10 + n));
+  // read a run that sticks out past the end of the file
+  std::vector<std::array<char, PAGE_SIZE>> back(n + 4);
+  std::vector<char *> in_ptrs;
+  for (auto &p : back) {
+    in_ptrs.push_back(p.data());
+  }
+  reopened.ReadPages(10, in_ptrs.data(), back.size());
+  for (int i = 0; i < n; i++) {
+    char expected[32];
+    std::snprintf(expected, sizeof(expected), "vectored %d", i);
+    EXPECT_STREQ(back[i].data(), expected);
+  }
+  EXPECT_EQ(back[n + 3][0], 0);
+}
+
+TEST_F(DiskManagerFileTest, DirectIOWithUnalignedBuffers) {
+  DiskManagerFile disk(path_, /*direct_io*/ true);
+  // std::vector storage is not page aligned; offset it by one byte to be sure
+  std::vector<char> out(PAGE_SIZE + 1), in(PAGE_SIZE + 1);
+  std::snprintf(out.data() + 1, PAGE_SIZE, "direct %d", disk.IsDirectIO() ? 1 : 0);
+  disk.WritePage(3, out.data() + 1);
+  disk.ReadPage(3, in.data() + 1);
+  EXPECT_STREQ(in.data() + 1, out.data() + 1);
+}
+
+TEST_F(DiskManagerFileTest, ConcurrentSyncsShareOneFdatasync) {
+  DiskManagerFile disk(path_);
+  std::array<char, PAGE_SIZE> out{};
+  for (int i = 0; i < 8; i++) {
+    disk.WritePage(i, out.data());
+  }
+  disk.Sync();
+  disk.Sync();  // nothing new to cover
+  EXPECT_EQ(disk.GetNumSyncs(), 1u);
+
+  DiskManagerFile batched(path_, false, /*sync_batch*/ 4);
+  for (int i = 0; i < 8; i++) {
+    batched.WritePage(i, out.data());
+  }
+  EXPECT_EQ(batched.GetNumSyncs(), 2u);
+}
+
+TEST_F(DiskManagerFileTest, BufferPoolSurvivesRestart) {
+  const int n = 64;
+  {
+    DiskManagerFile disk(path_);
+    BufferPoolManager bpm(8, &disk);
+    for (int i = 0; i < n; i++) {
+      auto page_id = bpm.NewPage();
+      auto guard = bpm.WritePage(page_id);
+      std::snprintf(guard.GetDataMut(), PAGE_SIZE, "persistent %d", i);
+    }
+    bpm.FlushAllPages();
+  }
+  DiskManagerFile disk(path_);
+  EXPECT_EQ(disk.NumPages(), static_cast<size_t>(n));
+  BufferPoolManager bpm(8, &disk);
+  for (int i = 0; i < n; i++) {
+    bpm.NewPage();
+  }
+  for (int i = 0; i < n; i++) {
+    auto guard = bpm.ReadPage(i);
+    char expected[32];
+    std::snprintf(expected, sizeof(expected), "persistent %d", i);
+    EXPECT_STREQ(guard.GetData(), expected);
+  }
+}
+
+TEST_F(DiskManagerFileTest, IoUringBatchKeepsPageOrderAndZeroFills) {
+  DiskManagerFile disk(path_);
+  DiskScheduler scheduler(&disk);
+  if (!scheduler.UsesIoUring()) {
+    GTEST_SKIP() << "io_uring not available";
+  }
+  struct alignas(PAGE_SIZE) Buffer {
+    char data_[PAGE_SIZE];
+  };
+  const int n = 512;  // more than one submission queue worth
+  std::vector<Buffer> frames(n + 2);
+  std::vector<char *> ptrs;
+  for (auto &frame : frames) {
+    ptrs.push_back(frame.data_);
+  }
+  EXPECT_TRUE(scheduler.RegisterBuffers(ptrs));
+
+  std::vector<DiskCompletion> done(n + 2);
+  std::vector<DiskRequest> requests;
+  for (int i = 0; i < n; i++) {
+    std::snprintf(frames[i].data_, PAGE_SIZE, "uring %d", i);
+    requests.push_back({true, frames[i].data_, n - 1 - i, &done[i]});
+  }
+  // a write and a read of the same page in one batch, plus a read past the end of the file
+  std::snprintf(frames[n].data_, PAGE_SIZE, "stale");
+  requests.push_back({false, frames[n].data_, 0, &done[n]});
+  frames[n + 1].data_[0] = 'x';
+  requests.push_back({false, frames[n + 1].data_, n + 10, &done[n + 1]});
+  for (auto &d : done) {
+    d.Reset();
+  }
+  scheduler.Schedule(requests);
+  for (auto &d : done) {
+    EXPECT_TRUE(d.Wait());
+  }
+  char expected[32];
+  std::snprintf(expected, sizeof(expected), "uring %d", n - 1);
+  EXPECT_STREQ(frames[n].data_, expected);
+  EXPECT_EQ(frames[n + 1].data_[0], 0);
+  EXPECT_EQ(disk.NumPages(), static_cast<size_t>(n));
+
+  std::array<char, PAGE_SIZE> in{};
+  disk.ReadPage(7, in.data());
+  std::snprintf(expected, sizeof(expected), "uring %d", n - 1 - 7);
+  EXPECT_STREQ(in.data(), expected);
+}
+
+// Random page reads in batches of 64, served by io_uring and by the pread worker.
+// The file sits in the page cache here, so this measures submission overhead only.
+TEST_F(DiskManagerFileTest, IoUringVsPreadThroughput) {
+  const int num_pages = 4096;
+  const int batch_size = 64;
+  const int rounds = 200;
+  {
+    DiskManagerFile disk(path_);
+    std::array<char, PAGE_SIZE> page{};
+    for (int i = 0; i < num_pages; i++) {
+      disk.WritePage(i, page.data());
+    }
+  }
+  struct alignas(PAGE_SIZE) Buffer {
+    char data_[PAGE_SIZE];
+  };
+  std::vector<Buffer> frames(batch_size);
+  std::vector<char *> ptrs;
+  for (auto &frame : frames) {
+    ptrs.push_back(frame.data_);
+  }
+  for (bool use_io_uring : {false, true}) {
+    DiskManagerFile disk(path_);
+    DiskScheduler scheduler(&disk, use_io_uring);
+    if (use_io_uring && !scheduler.UsesIoUring()) {
+      std::cout << "[io] io_uring not available" << std::endl;
+      break;
+    }
+    scheduler.RegisterBuffers(ptrs);
+    std::mt19937 rng(7);
+    std::uniform_int_distribution<int> pick(0, num_pages - 1);
+    std::vector<DiskCompletion> done(batch_size);
+    std::vector<DiskRequest> requests(batch_size);
+    auto start = std::chrono::steady_clock::now();
+    for (int r = 0; r < rounds; r++) {
+      for (int i = 0; i < batch_size; i++) {
+        done[i].Reset();
+        requests[i] = {false, frames[i].data_, pick(rng), &done[i]};
+      }
+      scheduler.Schedule(requests);
+      for (auto &d : done) {
+        ASSERT_TRUE(d.Wait());
+      }
+    }
+    double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "[io] " << (use_io_uring ? "io_uring" : "pread") << ": "
+              << static_cast<uint64_t>(rounds * batch_size / secs) << " page reads/s" << std::endl;
+  }
+}
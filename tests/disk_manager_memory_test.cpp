@@ -0,0 +1,477 @@
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <mutex>
+#include <random>
+#include <shared_mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "b_plus_tree.h"
+#include "b_plus_tree_key.h"
+#include "buffer_pool_manager.h"
+#include "disk_manager_memory.h"
+#include "page.h"
+#include "page_codec.h"
+#include "size_class_allocator.h"
+#include "test_disk_manager.h"
+#include "types.h"
+
+using namespace bicycletub;
+
+namespace {
+// The previous DiskManagerMemory layout (one hash map behind one shared_mutex), kept as
+// the baseline for the benchmark below.
+class MapDiskManager : public DiskManager {
+ public:
+  void ReadPage(page_id_t page_id, char *out_buf) override {
+    {
+      std::shared_lock lock(latch_);
+      auto it = pages_.find(page_id);
+      if (it != pages_.end()) {
+        std::memcpy(out_buf, it->second.data(), PAGE_SIZE);
+        return;
+      }
+    }
+    std::unique_lock lock(latch_);
+    std::memcpy(out_buf, pages_[page_id].data(), PAGE_SIZE);
+  }
+  void WritePage(page_id_t page_id, const char *buf) override {
+    std::unique_lock lock(latch_);
+    std::memcpy(pages_[page_id].data(), buf, PAGE_SIZE);
+  }
+  void DeallocatePage(page_id_t page_id) override {
+    std::unique_lock lock(latch_);
+    pages_.erase(page_id);
+  }
+  auto NumPages() const -> size_t override {
+    std::shared_lock lock(latch_);
+    return pages_.size();
+  }
+
+ private:
+  std::unordered_map<page_id_t, std::array<char, PAGE_SIZE>> pages_;
+  mutable std::shared_mutex latch_;
+};
+
+// Each thread appends its own dense range of pages, then reads and rewrites it.
+auto RunWorkload(DiskManager &disk, int threads, int pages_per_thread) -> double {
+  auto start = std::chrono::steady_clock::now();
+  std::vector<std::thread> workers;
+  for (int t = 0; t < threads; t++) {
+    workers.emplace_back([&, t] {
+      std::array<char, PAGE_SIZE> buf{};
+      page_id_t first = t * pages_per_thread;
+      for (int i = 0; i < pages_per_thread; i++) {
+        buf[0] = static_cast<char>(i);
+        disk.WritePage(first + i, buf.data());
+      }
+      for (int round = 0; round < 2; round++) {
+        for (int i = 0; i < pages_per_thread; i++) {
+          disk.ReadPage(first + i, buf.data());
+          disk.WritePage(first + i, buf.data());
+        }
+      }
+    });
+  }
+  for (auto &w : workers) {
+    w.join();
+  }
+  double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  return threads * pages_per_thread * 5 / secs;
+}
+}  // namespace
+
+TEST(DiskManagerMemoryTest, DirectoryRoundTrip) {
+  DiskManagerMemory disk;
+  std::array<char, PAGE_SIZE> out{}, in{};
+  // first page, a chunk boundary, a segment boundary and a far away page
+  const page_id_t ids[] = {0, DiskManagerMemory::CHUNK_PAGES - 1, DiskManagerMemory::CHUNK_PAGES,
+                           DiskManagerMemory::CHUNK_PAGES * DiskManagerMemory::SEGMENT_CHUNKS, 1 << 30};
+  for (page_id_t id : ids) {
+    std::snprintf(out.data(), PAGE_SIZE, "page %d", id);
+    disk.WritePage(id, out.data());
+  }
+  EXPECT_EQ(disk.NumPages(), std::size(ids));
+  for (page_id_t id : ids) {
+    char expected[32];
+    std::snprintf(expected, sizeof(expected), "page %d", id);
+    disk.ReadPage(id, in.data());
+    EXPECT_STREQ(in.data(), expected);
+  }
+
+  disk.DeallocatePage(ids[1]);
+  EXPECT_EQ(disk.NumPages(), std::size(ids) - 1);
+  in.fill('x');
+  disk.ReadPage(ids[1], in.data());
+  EXPECT_TRUE(std::all_of(in.begin(), in.end(), [](char c) { return c == 0; }));
+
+  EXPECT_THROW(disk.AllocatePage(ids[0]), std::runtime_error);
+  // reallocating a deallocated slot starts from zeros
+  disk.AllocatePage(ids[1]);
+  disk.ReadPage(ids[1], in.data());
+  EXPECT_EQ(in[0], 0);
+  EXPECT_THROW(disk.ReadPage(-5, in.data()), std::runtime_error);
+}
+
+TEST(DiskManagerMemoryTest, UnwrittenPagesReadAsZerosWithoutAllocating) {
+  DiskManagerMemory disk;
+  std::array<char, PAGE_SIZE> buf{};
+  for (page_id_t id = 0; id < 4 * static_cast<page_id_t>(DiskManagerMemory::CHUNK_PAGES); id++) {
+    buf.fill('x');
+    disk.ReadPage(id, buf.data());
+    ASSERT_TRUE(std::all_of(buf.begin(), buf.end(), [](char c) { return c == 0; }));
+  }
+  std::vector<std::array<char, PAGE_SIZE>> run(8);
+  std::vector<char *> ptrs;
+  for (auto &p : run) {
+    p.fill('x');
+    ptrs.push_back(p.data());
+  }
+  disk.ReadPages(100, ptrs.data(), ptrs.size());
+  EXPECT_EQ(run[7][PAGE_SIZE - 1], 0);
+  EXPECT_EQ(disk.NumPages(), 0u);
+  EXPECT_EQ(disk.NumChunks(), 0u);
+
+  // the first write materializes storage; its neighbours still read as zeros
+  buf.fill('y');
+  disk.WritePage(3, buf.data());
+  EXPECT_EQ(disk.NumPages(), 1u);
+  EXPECT_EQ(disk.NumChunks(), 1u);
+  disk.ReadPage(4, buf.data());
+  EXPECT_EQ(buf[0], 0);
+  disk.ReadPage(3, buf.data());
+  EXPECT_EQ(buf[0], 'y');
+}
+
+TEST(DiskManagerMemoryTest, VectoredRunAcrossChunks) {
+  DiskManagerMemory disk;
+  const size_t n = DiskManagerMemory::CHUNK_PAGES + 10;
+  const page_id_t first = DiskManagerMemory::CHUNK_PAGES - 5;
+  std::vector<std::array<char, PAGE_SIZE>> pages(n);
+  std::vector<const char *> out;
+  std::vector<char *> in;
+  for (size_t i = 0; i < n; i++) {
+    std::snprintf(pages[i].data(), PAGE_SIZE, "run %zu", i);
+    out.push_back(pages[i].data());
+  }
+  disk.WritePages(first, out.data(), n);
+  std::vector<std::array<char, PAGE_SIZE>> back(n);
+  for (auto &p : back) {
+    in.push_back(p.data());
+  }
+  disk.ReadPages(first, in.data(), n);
+  for (size_t i = 0; i < n; i++) {
+    EXPECT_STREQ(back[i].data(), pages[i].data());
+  }
+}
+
+TEST(DiskManagerMemoryTest, ConcurrentWritersOnDisjointPages) {
+  DiskManagerMemory disk;
+  const int threads = 8;
+  const int per_thread = 600;
+  std::vector<std::thread> workers;
+  for (int t = 0; t < threads; t++) {
+    workers.emplace_back([&, t] {
+      std::array<char, PAGE_SIZE> buf{};
+      // interleaved ids, so all threads race on creating the same chunks
+      for (int i = 0; i < per_thread; i++) {
+        page_id_t id = i * threads + t;
+        std::snprintf(buf.data(), PAGE_SIZE, "%d", id);
+        disk.WritePage(id, buf.data());
+      }
+    });
+  }
+  for (auto &w : workers) {
+    w.join();
+  }
+  EXPECT_EQ(disk.NumPages(), static_cast<size_t>(threads * per_thread));
+  std::array<char, PAGE_SIZE> buf{};
+  for (page_id_t id = 0; id < threads * per_thread; id++) {
+    disk.ReadPage(id, buf.data());
+    ASSERT_EQ(std::atoi(buf.data()), id);
+  }
+}
+
+TEST(DiskManagerMemoryTest, StoreVsMapBenchmark) {
+  const int pages_per_thread = 4096;
+  for (int threads : {1, 4}) {
+    MapDiskManager map;
+    DiskManagerMemory store;
+    double map_rate = RunWorkload(map, threads, pages_per_thread);
+    double store_rate = RunWorkload(store, threads, pages_per_thread);
+    std::cout << "[mem] threads=" << threads << " map=" << static_cast<uint64_t>(map_rate)
+              << " ops/s store=" << static_cast<uint64_t>(store_rate) << " ops/s" << std::endl;
+  }
+}
+
+TEST(DiskManagerMemoryTest, PageCodecRoundTrip) {
+  std::array<char, PAGE_SIZE> page{}, back{};
+  std::array<char, PageCodec::MAX_ENCODED_SIZE> blob{};
+  EXPECT_EQ(PageCodec::Compress(page.data(), blob.data()), 0u);
+  back.fill('x');
+  PageCodec::Decompress(blob.data(), 0, back.data());
+  EXPECT_EQ(back, page);
+
+  // a short prefix, trailing zeros elided
+  std::snprintf(page.data(), PAGE_SIZE, "header");
+  size_t size = PageCodec::Compress(page.data(), blob.data());
+  EXPECT_LT(size, 16u);
+  PageCodec::Decompress(blob.data(), size, back.data());
+  EXPECT_EQ(back, page);
+
+  // incompressible data is stored raw
+  std::mt19937 rng(3);
+  for (auto &c : page) {
+    c = static_cast<char>(rng() | 1);
+  }
+  EXPECT_EQ(PageCodec::Compress(page.data(), blob.data()), PAGE_SIZE);
+  PageCodec::Decompress(blob.data(), PAGE_SIZE, back.data());
+  EXPECT_EQ(back, page);
+}
+
+TEST(DiskManagerMemoryTest, SizeClassAllocatorReusesSlots) {
+  SizeClassAllocator allocator;
+  char *a = allocator.Allocate(100);
+  char *b = allocator.Allocate(100);
+  EXPECT_EQ(b - a, 128);
+  EXPECT_EQ(allocator.GetAllocatedBytes(), 256u);
+  allocator.Free(a, 100);
+  EXPECT_EQ(allocator.Allocate(120), a);
+  EXPECT_EQ(allocator.GetReservedBytes(), SizeClassAllocator::SLAB_SIZE);
+  EXPECT_THROW(allocator.Allocate(PAGE_SIZE + 1), std::invalid_argument);
+}
+
+TEST(DiskManagerMemoryTest, CompressedModeRoundTrip) {
+  DiskManagerMemory disk(/*compress*/ true);
+  std::array<char, PAGE_SIZE> out{}, in{};
+  for (page_id_t id = 0; id < 600; id++) {
+    out.fill(0);
+    std::snprintf(out.data(), PAGE_SIZE, "compressed %d", id);
+    out[PAGE_SIZE / 2] = static_cast<char>(id);
+    disk.WritePage(id, out.data());
+  }
+  // overwrite with a zero page, then deallocate another one
+  out.fill(0);
+  disk.WritePage(5, out.data());
+  disk.DeallocatePage(6);
+  EXPECT_EQ(disk.NumPages(), 599u);
+  EXPECT_EQ(disk.NumChunks(), 0u);
+  EXPECT_GT(disk.GetCompressionRatio(), 8.0);
+
+  std::vector<std::array<char, PAGE_SIZE>> back(600);
+  std::vector<char *> ptrs;
+  for (auto &p : back) {
+    ptrs.push_back(p.data());
+  }
+  disk.ReadPages(0, ptrs.data(), ptrs.size());
+  EXPECT_EQ(back[5], out);
+  EXPECT_EQ(back[6], out);
+  for (page_id_t id = 7; id < 600; id++) {
+    char expected[32];
+    std::snprintf(expected, sizeof(expected), "compressed %d", id);
+    ASSERT_STREQ(back[id].data(), expected);
+    ASSERT_EQ(back[id][PAGE_SIZE / 2], static_cast<char>(id));
+  }
+  disk.ReadPage(599, in.data());
+  EXPECT_EQ(in, back[599]);
+}
+
+// Compression ratio and per-page latency on real page images: B+ tree pages with
+// sequential integer keys and SimpleRow table pages.
+TEST(DiskManagerMemoryTest, CompressionRatioAndLatency) {
+  DiskManagerMemory source;
+  page_id_t num_pages = 0;
+  {
+    BufferPoolManager bpm(64, &source);
+    page_id_t header_page_id = bpm.NewPage();
+    IntegerKeyComparator comparator;
+    BPlusTree<IntegerKey, RID, IntegerKeyComparator> tree("compress", header_page_id, &bpm, comparator);
+    for (int i = 0; i < 20000; i++) {
+      tree.Insert(IntegerKey(i), RID{i / 100, i % 100});
+    }
+    const size_t rows_per_page = PAGE_SIZE / sizeof(SimpleRow);
+    for (int p = 0; p < 100; p++) {
+      page_id_t page_id = bpm.NewPage();
+      auto guard = bpm.WritePage(page_id);
+      auto *page = guard.AsMut<SimpleRowPage>();
+      // partially filled pages, as after deletes
+      for (size_t slot = 0; slot < rows_per_page * (p % 4 + 1) / 4; slot++) {
+        page->SetRow(slot, SimpleRow{RID{page_id, static_cast<int32_t>(slot + 1)}, p * 1000 + static_cast<int>(slot), 7});
+      }
+    }
+    bpm.FlushAllPages();
+    num_pages = static_cast<page_id_t>(source.NumPages());
+  }
+  std::vector<std::array<char, PAGE_SIZE>> images(num_pages);
+  for (page_id_t id = 0; id < num_pages; id++) {
+    source.ReadPage(id, images[id].data());
+  }
+
+  const int rounds = 20;
+  double ratio = 0;
+  for (bool compress : {false, true}) {
+    DiskManagerMemory disk(compress);
+    auto start = std::chrono::steady_clock::now();
+    for (int r = 0; r < rounds; r++) {
+      for (page_id_t id = 0; id < num_pages; id++) {
+        disk.WritePage(id, images[id].data());
+      }
+    }
+    auto mid = std::chrono::steady_clock::now();
+    std::array<char, PAGE_SIZE> buf;
+    for (int r = 0; r < rounds; r++) {
+      for (page_id_t id = 0; id < num_pages; id++) {
+        disk.ReadPage(id, buf.data());
+      }
+    }
+    auto end = std::chrono::steady_clock::now();
+    ASSERT_EQ(std::memcmp(buf.data(), images[num_pages - 1].data(), PAGE_SIZE), 0);
+    double ops = static_cast<double>(rounds) * num_pages;
+    std::cout << "[compress] " << (compress ? "on " : "off") << " pages=" << num_pages
+              << " ratio=" << disk.GetCompressionRatio()
+              << " write=" << std::chrono::duration<double, std::nano>(mid - start).count() / ops << "ns/page"
+              << " read=" << std::chrono::duration<double, std::nano>(end - mid).count() / ops << "ns/page"
+              << std::endl;
+    if (compress) {
+      ratio = disk.GetCompressionRatio();
+    }
+  }
+  EXPECT_GT(ratio, 1.5);
+}
+
+#ifndef _WIN32
+namespace {
+void ExpectSameContents(DiskManagerMemory &expected, DiskManagerMemory &actual, page_id_t end) {
+  std::array<char, PAGE_SIZE> a{}, b{};
+  for (page_id_t id = 0; id < end; id++) {
+    expected.ReadPage(id, a.data());
+    actual.ReadPage(id, b.data());
+    ASSERT_EQ(std::memcmp(a.data(), b.data(), PAGE_SIZE), 0) << "page " << id;
+  }
+  EXPECT_EQ(actual.NumPages(), expected.NumPages());
+  EXPECT_EQ(actual.GetPageIdLimit(), expected.GetPageIdLimit());
+}
+}  // namespace
+
+TEST(DiskManagerMemoryTest, ImageRoundTrip) {
+  std::string path = TempDataFilePath("image");
+  DiskManagerMemory source;
+  std::array<char, PAGE_SIZE> page{};
+  // a dense run, a page far away behind empty chunks, and a deallocated page
+  for (page_id_t id = 0; id < 700; id++) {
+    std::snprintf(page.data(), PAGE_SIZE, "page %d", id);
+    page[PAGE_SIZE - 1] = static_cast<char>(id);
+    source.WritePage(id, page.data());
+  }
+  source.WritePage(5000, page.data());
+  source.DeallocatePage(300);
+  EXPECT_EQ(source.GetPageIdLimit(), 5001);
+  source.SaveImage(path);
+
+  DiskManagerMemory copied;
+  copied.LoadImage(path);
+  ExpectSameContents(source, copied, 5100);
+  DiskManagerMemory compressed(true);
+  compressed.LoadImage(path);
+  ExpectSameContents(source, compressed, 5100);
+
+  {
+    DiskManagerMemory mapped;
+    mapped.LoadImage(path, true);
+    ExpectSameContents(source, mapped, 5100);
+    // writes stay private to the process
+    std::snprintf(page.data(), PAGE_SIZE, "changed");
+    mapped.WritePage(1, page.data());
+    mapped.WritePage(6000, page.data());
+    std::array<char, PAGE_SIZE> out{};
+    mapped.ReadPage(1, out.data());
+    EXPECT_STREQ(out.data(), "changed");
+  }
+  DiskManagerMemory reloaded;
+  reloaded.LoadImage(path, true);
+  ExpectSameContents(source, reloaded, 5100);
+
+  EXPECT_THROW(reloaded.LoadImage(path), std::runtime_error);
+  std::filesystem::remove(path);
+}
+
+TEST(DiskManagerMemoryTest, LoadImageRejectsOtherFiles) {
+  std::string path = TempDataFilePath("image");
+  {
+    DiskManagerMemory empty;
+    EXPECT_THROW(empty.LoadImage(path), std::runtime_error);
+  }
+  std::FILE *file = std::fopen(path.c_str(), "wb");
+  std::fputs("not an image, just some text that is long enough for a header", file);
+  std::fclose(file);
+  DiskManagerMemory disk;
+  EXPECT_THROW(disk.LoadImage(path), std::runtime_error);
+  EXPECT_EQ(disk.NumPages(), 0u);
+  std::filesystem::remove(path);
+}
+
+// Startup cost of a populated index: rebuilding it key by key against loading its pages
+// from an image, copied and mapped.
+TEST(DiskManagerMemoryTest, ImageStartupBenchmark) {
+  std::string path = TempDataFilePath("image");
+  const int keys = 100000;
+  using Clock = std::chrono::steady_clock;
+  auto ms = [](Clock::duration d) { return std::chrono::duration<double, std::milli>(d).count(); };
+
+  DiskManagerMemory source;
+  auto start = Clock::now();
+  {
+    BufferPoolManager bpm(256, &source);
+    page_id_t header_page_id = bpm.NewPage();
+    IntegerKeyComparator comparator;
+    BPlusTree<IntegerKey, RID, IntegerKeyComparator> tree("image", header_page_id, &bpm, comparator);
+    for (int i = 0; i < keys; i++) {
+      tree.Insert(IntegerKey(i), RID{i, 0});
+    }
+    bpm.FlushAllPages();
+  }
+  double rebuild = ms(Clock::now() - start);
+
+  start = Clock::now();
+  source.SaveImage(path);
+  double save = ms(Clock::now() - start);
+  double mib = static_cast<double>(std::filesystem::file_size(path)) / (1 << 20);
+
+  DiskManagerMemory copied;
+  start = Clock::now();
+  copied.LoadImage(path);
+  double load = ms(Clock::now() - start);
+
+  DiskManagerMemory mapped;
+  start = Clock::now();
+  mapped.LoadImage(path, true);
+  double map = ms(Clock::now() - start);
+  // the buffer pool has to know the loaded pages before it serves them
+  BufferPoolManager bpm(16, &mapped);
+  start = Clock::now();
+  bpm.AdoptPages(mapped.GetPageIdLimit());
+  IntegerKeyComparator comparator;
+  auto tree = BPlusTree<IntegerKey, RID, IntegerKeyComparator>::Open("image", 0, &bpm, comparator);
+  double open = ms(Clock::now() - start);
+  for (int i = 0; i < keys; i += 997) {
+    std::vector<RID> result;
+    ASSERT_TRUE(tree.GetValue(IntegerKey(i), &result)) << i;
+    EXPECT_EQ(result[0].page_id, i);
+  }
+
+  std::cout << "[image] " << keys << " keys, " << source.NumPages() << " pages, " << mib << " MiB: rebuild=" << rebuild
+            << "ms save=" << save << "ms (" << mib / save * 1000 << " MiB/s) load=" << load << "ms ("
+            << mib / load * 1000 << " MiB/s) mmap=" << map << "ms open=" << open << "ms" << std::endl;
+  ExpectSameContents(source, copied, source.GetPageIdLimit());
+  ExpectSameContents(source, mapped, source.GetPageIdLimit());
+  EXPECT_LT(load, rebuild);
+  std::filesystem::remove(path);
+}
+#endif
@@ -0,0 +1,93 @@
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <array>
+#include <cstdio>
+#include <filesystem>
+#include <string>
+
+#include "buffer_pool_manager.h"
+#include "disk_manager_mmap.h"
+#include "test_disk_manager.h"
+#include "types.h"
+
+using namespace bicycletub;
+
+class DiskManagerMmapTest : public ::testing::Test {
+ protected:
+  void SetUp() override { path_ = TempDataFilePath("dmm"); }
+  void TearDown() override {
+    std::error_code ec;
+    std::filesystem::remove(path_, ec);
+  }
+
+  std::string path_;
+};
+
+TEST_F(DiskManagerMmapTest, RoundTripGrowthAndReopen) {
+  std::array<char, PAGE_SIZE> out{}, in{};
+  {
+    DiskManagerMmap disk(path_);
+    for (int i = 0; i < 3000; i += 7) {  // crosses several growth steps
+      std::snprintf(out.data(), PAGE_SIZE, "mapped %d", i);
+      disk.WritePage(i, out.data());
+    }
+    EXPECT_EQ(disk.NumPages(), 2997u);
+    disk.ReadPage(700, in.data());
+    EXPECT_STREQ(in.data(), "mapped 700");
+    in.fill('x');
+    disk.ReadPage(5000, in.data());
+    EXPECT_TRUE(std::all_of(in.begin(), in.end(), [](char c) { return c == 0; }));
+  }
+  // the growth slack is trimmed on close
+  EXPECT_EQ(std::filesystem::file_size(path_), 2997u * PAGE_SIZE);
+  DiskManagerMmap reopened(path_);
+  EXPECT_EQ(reopened.NumPages(), 2997u);
+  reopened.ReadPage(2996, in.data());
+  EXPECT_STREQ(in.data(), "mapped 2996");
+  reopened.Advise(0, 64, AccessHint::SEQUENTIAL);
+  EXPECT_THROW(DiskManagerMmap(path_, false, 16).WritePage(3000, out.data()), std::runtime_error);
+}
+
+TEST_F(DiskManagerMmapTest, ZeroCopyFramesCopyOnWrite) {
+  const int n = 32;
+  {
+    DiskManagerMmap disk(path_);
+    BufferPoolManager bpm(8, &disk);
+    for (int i = 0; i < n; i++) {
+      auto page_id = bpm.NewPage();
+      std::snprintf(bpm.WritePage(page_id).GetDataMut(), PAGE_SIZE, "cold %d", i);
+    }
+    bpm.FlushAllPages();
+    EXPECT_EQ(bpm.GetZeroCopyReads(), 0u);
+  }
+  DiskManagerMmap disk(path_, /*zero_copy*/ true);
+  BufferPoolManager bpm(8, &disk);
+  for (int i = 0; i < n; i++) {
+    bpm.NewPage();
+  }
+  {
+    auto guard = bpm.ReadPage(3);
+    EXPECT_EQ(guard.GetData(), disk.MappedPage(3));
+    EXPECT_STREQ(guard.GetData(), "cold 3");
+  }
+  {
+    // the write lands in the frame's private copy, the file is untouched until write-back
+    auto guard = bpm.WritePage(3);
+    std::snprintf(guard.GetDataMut(), PAGE_SIZE, "hot 3");
+    EXPECT_NE(guard.GetData(), disk.MappedPage(3));
+    EXPECT_STREQ(disk.MappedPage(3), "cold 3");
+  }
+  for (int i = 0; i < n; i++) {
+    if (i == 3) {
+      continue;
+    }
+    char expected[32];
+    std::snprintf(expected, sizeof(expected), "cold %d", i);
+    EXPECT_STREQ(bpm.ReadPage(i).GetData(), expected);
+  }
+  EXPECT_TRUE(bpm.FlushPage(3));
+  EXPECT_STREQ(disk.MappedPage(3), "hot 3");
+  EXPECT_STREQ(bpm.ReadPage(3).GetData(), "hot 3");
+  EXPECT_GE(bpm.GetZeroCopyReads(), static_cast<uint64_t>(n));
+  EXPECT_EQ(bpm.GetDiskReads(), 0u);
+}
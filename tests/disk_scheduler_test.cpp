@@ -0,0 +1,202 @@
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "disk_manager_memory.h"
+#include "test_disk_manager.h"
+#include "disk_scheduler.h"
+#include "types.h"
+
+using namespace bicycletub;
+
+class DiskSchedulerTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    disk_ = MakeTestDiskManager();
+    scheduler_ = std::make_unique<DiskScheduler>(disk_.get());
+  }
+  void TearDown() override {
+    scheduler_.reset();
+    disk_.reset();
+  }
+
+  std::unique_ptr<DiskManager> disk_;
+  std::unique_ptr<DiskScheduler> scheduler_;
+};
+
+TEST_F(DiskSchedulerTest, SingleRequestRoundTrip) {
+  std::array<char, PAGE_SIZE> out{}, in{};
+  std::snprintf(out.data(), PAGE_SIZE, "hello scheduler");
+
+  DiskCompletion done;
+  done.Reset();
+  DiskRequest write{.is_write_ = true, .data_ = out.data(), .page_id_ = 3, .callback_ = &done};
+  scheduler_->Schedule({&write, 1});
+  EXPECT_TRUE(done.Wait());
+
+  done.Reset();
+  DiskRequest read{.is_write_ = false, .data_ = in.data(), .page_id_ = 3, .callback_ = &done};
+  scheduler_->Schedule({&read, 1});
+  EXPECT_TRUE(done.Wait());
+  EXPECT_STREQ(in.data(), "hello scheduler");
+}
+
+TEST_F(DiskSchedulerTest, ShuffledBatchIsCoalesced) {
+  const int n = 64;
+  std::vector<std::array<char, PAGE_SIZE>> bufs(n);
+  std::vector<DiskCompletion> done(n);
+  std::vector<DiskRequest> requests;
+  for (int i = 0; i < n; i++) {
+    std::snprintf(bufs[i].data(), PAGE_SIZE, "page %d", i);
+    done[i].Reset();
+    requests.push_back({.is_write_ = true, .data_ = bufs[i].data(), .page_id_ = i, .callback_ = &done[i]});
+  }
+  std::shuffle(requests.begin(), requests.end(), std::mt19937(42));
+  // queued under one lock, so the idle worker drains them as a single batch
+  scheduler_->Schedule(requests);
+  for (auto &d : done) {
+    EXPECT_TRUE(d.Wait());
+  }
+  EXPECT_EQ(scheduler_->GetScheduledWrites(), static_cast<uint64_t>(n));
+  EXPECT_EQ(scheduler_->GetCoalescedRequests(), static_cast<uint64_t>(n));
+
+  std::array<char, PAGE_SIZE> in{};
+  for (int i = 0; i < n; i++) {
+    disk_->ReadPage(i, in.data());
+    char expected[32];
+    std::snprintf(expected, sizeof(expected), "page %d", i);
+    EXPECT_STREQ(in.data(), expected);
+  }
+}
+
+TEST_F(DiskSchedulerTest, SamePageKeepsSubmissionOrder) {
+  std::array<char, PAGE_SIZE> first{}, second{}, in_between{}, in_after{};
+  std::snprintf(first.data(), PAGE_SIZE, "first");
+  std::snprintf(second.data(), PAGE_SIZE, "second");
+
+  std::vector<DiskCompletion> done(4);
+  for (auto &d : done) {
+    d.Reset();
+  }
+  std::vector<DiskRequest> requests{
+      {.is_write_ = true, .data_ = first.data(), .page_id_ = 7, .callback_ = &done[0]},
+      {.is_write_ = false, .data_ = in_between.data(), .page_id_ = 7, .callback_ = &done[1]},
+      {.is_write_ = true, .data_ = second.data(), .page_id_ = 7, .callback_ = &done[2]},
+      {.is_write_ = false, .data_ = in_after.data(), .page_id_ = 7, .callback_ = &done[3]},
+  };
+  scheduler_->Schedule(requests);
+  for (auto &d : done) {
+    EXPECT_TRUE(d.Wait());
+  }
+  EXPECT_STREQ(in_between.data(), "first");
+  EXPECT_STREQ(in_after.data(), "second");
+}
+
+TEST_F(DiskSchedulerTest, BackgroundWritesStillComplete) {
+  // a steady stream of foreground reads must not starve queued write-back
+  const int n = 512;
+  std::vector<std::array<char, PAGE_SIZE>> bufs(n);
+  std::vector<DiskCompletion> done(n);
+  std::vector<DiskRequest> writes;
+  for (int i = 0; i < n; i++) {
+    std::snprintf(bufs[i].data(), PAGE_SIZE, "bg %d", i);
+    done[i].Reset();
+    writes.push_back({.is_write_ = true,
+                      .data_ = bufs[i].data(),
+                      .page_id_ = i,
+                      .callback_ = &done[i],
+                      .priority_ = DiskRequestPriority::BACKGROUND});
+  }
+  scheduler_->Schedule(writes);
+
+  std::array<char, PAGE_SIZE> in{};
+  DiskCompletion read_done;
+  for (int i = 0; !done.back().IsDone(); i++) {
+    read_done.Reset();
+    DiskRequest read{.is_write_ = false, .data_ = in.data(), .page_id_ = n + (i % 16), .callback_ = &read_done};
+    scheduler_->Schedule({&read, 1});
+    EXPECT_TRUE(read_done.Wait());
+  }
+  for (auto &d : done) {
+    EXPECT_TRUE(d.Wait());
+  }
+  disk_->ReadPage(n - 1, in.data());
+  char expected[32];
+  std::snprintf(expected, sizeof(expected), "bg %d", n - 1);
+  EXPECT_STREQ(in.data(), expected);
+}
+
+namespace {
+// Latencies (us) of single-page reads issued while another thread keeps a
+// checkpoint-sized batch of writes queued at the given priority.
+auto MissLatencyUnderCheckpoint(DiskRequestPriority writeback_priority) -> std::vector<double> {
+  const int checkpoint_pages = 4096;
+  const int reads = 2000;
+  DiskManagerMemory disk;
+  DiskScheduler scheduler(&disk);
+  std::vector<std::array<char, PAGE_SIZE>> frames(checkpoint_pages);
+  std::vector<DiskCompletion> done(checkpoint_pages);
+  std::atomic<bool> stop{false};
+
+  std::thread checkpointer([&]() {
+    std::vector<DiskRequest> writes;
+    while (!stop.load()) {
+      writes.clear();
+      for (int i = 0; i < checkpoint_pages; i++) {
+        done[i].Reset();
+        writes.push_back({.is_write_ = true,
+                          .data_ = frames[i].data(),
+                          .page_id_ = i,
+                          .callback_ = &done[i],
+                          .priority_ = writeback_priority});
+      }
+      scheduler.Schedule(writes);
+      for (auto &d : done) {
+        d.Wait();
+      }
+    }
+  });
+
+  std::mt19937 rng(7);
+  std::uniform_int_distribution<int> dist(checkpoint_pages, 2 * checkpoint_pages);
+  std::array<char, PAGE_SIZE> in{};
+  std::vector<double> latencies;
+  latencies.reserve(reads);
+  DiskCompletion read_done;
+  for (int i = 0; i < reads; i++) {
+    read_done.Reset();
+    DiskRequest read{.is_write_ = false, .data_ = in.data(), .page_id_ = dist(rng), .callback_ = &read_done};
+    auto start = std::chrono::steady_clock::now();
+    scheduler.Schedule({&read, 1});
+    read_done.Wait();
+    auto end = std::chrono::steady_clock::now();
+    latencies.push_back(std::chrono::duration<double, std::micro>(end - start).count());
+  }
+  stop.store(true);
+  checkpointer.join();
+  std::sort(latencies.begin(), latencies.end());
+  return latencies;
+}
+}  // namespace
+
+// Disabled by default: each run keeps a 4096-page checkpoint queued behind 2000 reads,
+// about a minute at -O0. Run with --gtest_also_run_disabled_tests.
+TEST_F(DiskSchedulerTest, DISABLED_MissLatencyUnderCheckpoint) {
+  auto fifo = MissLatencyUnderCheckpoint(DiskRequestPriority::FOREGROUND);
+  auto prioritized = MissLatencyUnderCheckpoint(DiskRequestPriority::BACKGROUND);
+  auto pct = [](const std::vector<double> &v, double p) { return v[static_cast<size_t>(p * (v.size() - 1))]; };
+  std::cout << "[Scheduler] miss latency under checkpoint (us)" << std::endl;
+  std::cout << "  write-back as FOREGROUND: p50=" << pct(fifo, 0.5) << " p99=" << pct(fifo, 0.99)
+            << " max=" << fifo.back() << std::endl;
+  std::cout << "  write-back as BACKGROUND: p50=" << pct(prioritized, 0.5) << " p99=" << pct(prioritized, 0.99)
+            << " max=" << prioritized.back() << std::endl;
+  EXPECT_EQ(fifo.size(), prioritized.size());
+}
@@ -0,0 +1,123 @@
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <cstdint>
+#include <iostream>
+#include <random>
+#include <vector>
+#include "b_plus_tree_internal_page.h"
+#include "b_plus_tree_key.h"
+#include "b_plus_tree_leaf_page.h"
+#include "key_search.h"
+#include "types.h"
+
+using namespace bicycletub;
+
+namespace {
+using LeafPage = BPlusTreeLeafPage<IntegerKey, RID, IntegerKeyComparator>;
+using InternalPage = BPlusTreeInternalPage<IntegerKey, page_id_t, IntegerKeyComparator>;
+// keys a full leaf holds
+constexpr int LEAF_SLOTS = sizeof(LeafPage::key_array_) / sizeof(IntegerKey);
+
+auto StdLowerBound(const std::vector<int32_t> &keys, int32_t key) -> int {
+    return static_cast<int>(std::lower_bound(keys.begin(), keys.end(), key) - keys.begin());
+}
+
+// the comparator-driven binary search the pages used for every key type
+auto ComparatorSearch(const IntegerKey *keys, int n, const IntegerKey &key, const IntegerKeyComparator &cmp) -> int {
+    int l=0, r=n;
+    while(l < r) {
+        int mid = l + (r - l) / 2;
+        int c = cmp(key, keys[mid]);
+        if(c == 0) return mid;
+        if(c < 0) r = mid; else l = mid + 1;
+    }
+    return l;
+}
+}  // namespace
+
+TEST(KeySearchTest, MatchesStdLowerBound) {
+    std::mt19937 rng(5);
+    std::vector<int> sizes;
+    for(int n=0;n<=40;n++) sizes.push_back(n);
+    sizes.push_back(LEAF_SLOTS);
+    for(int n : sizes) {
+        std::vector<int32_t> keys;
+        int32_t next = INT_MIN + 1;
+        for(int i=0;i<n;i++) {
+            keys.push_back(next);
+            next += 2 + static_cast<int32_t>(rng() % 1000);
+        }
+        std::vector<int32_t> probes = {INT_MIN, INT_MAX, 0};
+        for(int32_t k : keys) {
+            probes.push_back(k - 1);
+            probes.push_back(k);
+            probes.push_back(k + 1);
+        }
+        for(int32_t probe : probes) {
+            ASSERT_EQ(LowerBoundInt32(keys.data(), n, probe), StdLowerBound(keys, probe)) << "n=" << n;
+            ASSERT_EQ(LowerBoundInt32Portable(keys.data(), n, probe), StdLowerBound(keys, probe)) << "n=" << n;
+        }
+    }
+}
+
+// the pages pick the integer search through the comparator type; internal pages skip slot 0
+TEST(KeySearchTest, PagesUseIntegerSearch) {
+    alignas(8) static char leaf_buf[PAGE_SIZE];
+    alignas(8) static char internal_buf[PAGE_SIZE];
+    auto *leaf = reinterpret_cast<LeafPage *>(leaf_buf);
+    auto *internal = reinterpret_cast<InternalPage *>(internal_buf);
+    leaf->Init();
+    internal->Init(64);
+    IntegerKeyComparator cmp;
+    for(int i=0;i<50;i++) {
+        leaf->key_array_[i] = IntegerKey(10 * i);
+        internal->key_array_[i + 1] = IntegerKey(10 * i);
+    }
+    leaf->SetSize(50);
+    internal->SetSize(51);
+    // slot 0 of an internal page is garbage and must be ignored
+    internal->key_array_[0] = IntegerKey(INT_MAX);
+    for(int probe=-5;probe<510;probe++) {
+        int expected = ComparatorSearch(leaf->key_array_, 50, IntegerKey(probe), cmp);
+        ASSERT_EQ(leaf->KeyIndex(IntegerKey(probe), cmp), expected);
+        ASSERT_EQ(internal->KeyIndex(IntegerKey(probe), cmp), expected + 1);
+    }
+}
+
+// Per-page search cost on a full leaf with random probes: the comparator binary search,
+// the branchless scalar search and the dispatched one (vector finish where available).
+TEST(KeySearchTest, KeySearchBenchmark) {
+    const int n = LEAF_SLOTS;
+    const int searches = 1 << 20;
+    std::vector<IntegerKey> keys;
+    std::vector<int32_t> raw;
+    for(int i=0;i<n;i++) {
+        keys.emplace_back(3 * i);
+        raw.push_back(3 * i);
+    }
+    std::mt19937 rng(17);
+    std::vector<int32_t> probes(4096);
+    for(auto &p : probes) p = static_cast<int32_t>(rng() % (3 * n));
+    IntegerKeyComparator cmp;
+
+    auto time = [&](auto &&search) {
+        long sum = 0;
+        auto start = std::chrono::steady_clock::now();
+        for(int i=0;i<searches;i++) sum += search(probes[i & 4095]);
+        double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        return std::make_pair(sum, secs * 1e9 / searches);
+    };
+    auto generic = time([&](int32_t p) { return ComparatorSearch(keys.data(), n, IntegerKey(p), cmp); });
+    auto branchless = time([&](int32_t p) { return LowerBoundInt32Portable(raw.data(), n, p); });
+    auto dispatched = time([&](int32_t p) { return LowerBoundInt32(raw.data(), n, p); });
+
+    std::cout << "[KeySearch] slots=" << n
+              << " comparator ns/search=" << generic.second
+              << " branchless ns/search=" << branchless.second
+              << " " << (KeySearchIsVectorized() ? "simd" : "dispatched") << " ns/search=" << dispatched.second
+              << " speedup=" << generic.second / dispatched.second << "x\n";
+    EXPECT_EQ(branchless.first, generic.first);
+    EXPECT_EQ(dispatched.first, generic.first);
+}
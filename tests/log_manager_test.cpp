@@ -0,0 +1,219 @@
+#include <gtest/gtest.h>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "buffer_pool_manager.h"
+#include "disk_manager_memory.h"
+#include "log_manager.h"
+#include "test_disk_manager.h"
+#include "types.h"
+
+using namespace bicycletub;
+
+namespace {
+auto ReadAll(const std::string &path) -> std::vector<LogRecord> {
+  LogReader reader(path);
+  std::vector<LogRecord> records;
+  LogRecord record;
+  while (reader.Next(&record)) {
+    records.push_back(record);
+  }
+  return records;
+}
+
+// Checks the WAL rule on every page write: the durable part of the log has to hold an
+// image of the page identical to the one being written.
+class WalCheckingDiskManager : public DiskManager {
+ public:
+  WalCheckingDiskManager(DiskManager *inner, const LogManager *log) : inner_(inner), log_(log) {}
+
+  void ReadPage(page_id_t page_id, char *out_buf) override { inner_->ReadPage(page_id, out_buf); }
+  void WritePage(page_id_t page_id, const char *buf) override {
+    lsn_t durable = log_->GetPersistentLsn();
+    std::vector<char> logged;
+    LogReader reader(log_->GetPath());
+    LogRecord record;
+    while (reader.Next(&record) && record.lsn_ < durable) {
+      if (record.type_ == LogRecordType::PAGE_IMAGE && record.page_id_ == page_id) {
+        logged.resize(PAGE_SIZE);
+        LogManager::DecodePageImage(record, logged.data());
+      }
+    }
+    if (logged.empty() || std::memcmp(logged.data(), buf, PAGE_SIZE) != 0) {
+      violations_++;
+    }
+    writes_++;
+    inner_->WritePage(page_id, buf);
+  }
+  void DeallocatePage(page_id_t page_id) override { inner_->DeallocatePage(page_id); }
+  auto NumPages() const -> size_t override { return inner_->NumPages(); }
+
+  std::atomic<size_t> writes_{0};
+  std::atomic<size_t> violations_{0};
+
+ private:
+  DiskManager *inner_;
+  const LogManager *log_;
+};
+}  // namespace
+
+TEST(LogManagerTest, AppendFlushAndReadBack) {
+  TempLogPath path;
+  std::array<char, PAGE_SIZE> page{}, restored{};
+  std::snprintf(page.data() + 100, 32, "logged page");
+  lsn_t first, second, third;
+  {
+    LogManager log(path.Path());
+    first = log.Append(LogRecordType::CHECKPOINT_BEGIN, INVALID_PAGE_ID, "abc", 3);
+    second = log.AppendPageImage(7, page.data());
+    third = log.Commit();
+    EXPECT_EQ(first, 0);
+    EXPECT_EQ(second, first + static_cast<lsn_t>(sizeof(LogRecordHeader)) + 3);
+    EXPECT_LT(second, third);
+    // Commit returns once its record is durable
+    EXPECT_GT(log.GetPersistentLsn(), third);
+    EXPECT_EQ(log.GetNumRecords(), 3u);
+  }
+  auto records = ReadAll(path.Path());
+  ASSERT_EQ(records.size(), 3u);
+  EXPECT_EQ(records[0].lsn_, first);
+  EXPECT_EQ(std::string(records[0].payload_.begin(), records[0].payload_.end()), "abc");
+  EXPECT_EQ(records[1].lsn_, second);
+  EXPECT_EQ(records[1].page_id_, 7);
+  // zero suppressed, far smaller than the page
+  EXPECT_LT(records[1].payload_.size(), PAGE_SIZE / 8);
+  LogManager::DecodePageImage(records[1], restored.data());
+  EXPECT_EQ(page, restored);
+  EXPECT_EQ(records[2].type_, LogRecordType::COMMIT);
+}
+
+TEST(LogManagerTest, ReopenCutsTornTail) {
+  TempLogPath path;
+  lsn_t end;
+  {
+    LogManager log(path.Path());
+    for (int i = 0; i < 10; i++) {
+      log.Append(LogRecordType::COMMIT, i, nullptr, 0);
+    }
+    end = log.GetNextLsn();
+  }
+  // half a record, as a crash in the middle of a write leaves it
+  {
+    std::FILE *file = std::fopen(path.Path().c_str(), "ab");
+    ASSERT_NE(file, nullptr);
+    LogRecordHeader torn{};
+    torn.size_ = 4000;
+    torn.lsn_ = end;
+    std::fwrite(&torn, sizeof(torn), 1, file);
+    std::fclose(file);
+  }
+  EXPECT_EQ(ReadAll(path.Path()).size(), 10u);
+  {
+    LogManager log(path.Path());
+    EXPECT_EQ(log.GetNextLsn(), end);
+    EXPECT_EQ(log.Commit(), end);
+  }
+  auto records = ReadAll(path.Path());
+  ASSERT_EQ(records.size(), 11u);
+  EXPECT_EQ(records.back().lsn_, end);
+
+  // anything else is refused
+  {
+    std::FILE *file = std::fopen(path.Path().c_str(), "wb");
+    std::fputs("definitely not a log file", file);
+    std::fclose(file);
+  }
+  EXPECT_THROW(LogManager log(path.Path()), std::runtime_error);
+}
+
+TEST(LogManagerTest, FullBufferWaitsForFlusher) {
+  TempLogPath path;
+  std::array<char, PAGE_SIZE> page{};
+  std::mt19937 rng(3);
+  // one raw page per record fills a small buffer every few appends
+  LogManager log(path.Path(), 4 * PAGE_SIZE);
+  for (int i = 0; i < 64; i++) {
+    for (auto &c : page) {
+      c = static_cast<char>(rng());
+    }
+    log.AppendPageImage(i, page.data());
+  }
+  log.Flush(log.GetNextLsn() - 1);
+  EXPECT_EQ(ReadAll(path.Path()).size(), 64u);
+  EXPECT_GE(log.GetNumSyncs(), 16u);
+  EXPECT_THROW(log.Append(LogRecordType::PAGE_IMAGE, 0, page.data(), 4 * PAGE_SIZE), std::invalid_argument);
+}
+
+// Committers that arrive while a sync is running share the next one.
+TEST(LogManagerTest, GroupCommitSharesSyncs) {
+  TempLogPath path;
+  LogManager log(path.Path());
+  const int num_threads = 16;
+  const int commits_per_thread = 100;
+  auto start = std::chrono::steady_clock::now();
+  std::vector<std::thread> threads;
+  for (int t = 0; t < num_threads; t++) {
+    threads.emplace_back([&] {
+      for (int i = 0; i < commits_per_thread; i++) {
+        lsn_t lsn = log.Commit();
+        ASSERT_GT(log.GetPersistentLsn(), lsn);
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  const int commits = num_threads * commits_per_thread;
+  uint64_t syncs = log.GetNumSyncs();
+  std::cout << "[group_commit] " << commits << " commits from " << num_threads << " threads, " << syncs
+            << " fdatasyncs (" << static_cast<double>(commits) / static_cast<double>(syncs) << " commits/sync), "
+            << static_cast<double>(commits) / seconds << " commits/s\n";
+  EXPECT_EQ(ReadAll(path.Path()).size(), static_cast<size_t>(commits));
+  EXPECT_LT(syncs, static_cast<uint64_t>(commits) / 2);
+}
+
+TEST(LogManagerTest, BufferPoolFollowsWalRule) {
+  TempLogPath path;
+  DiskManagerMemory memory;
+  LogManager log(path.Path());
+  WalCheckingDiskManager disk(&memory, &log);
+  {
+    // a tiny pool so most writes happen on eviction
+    BufferPoolManager bpm(4, &disk, &log);
+    std::vector<page_id_t> pages;
+    for (int i = 0; i < 24; i++) {
+      pages.push_back(bpm.NewPage());
+    }
+    std::mt19937 rng(5);
+    for (int i = 0; i < 300; i++) {
+      page_id_t page_id = pages[rng() % pages.size()];
+      if (rng() % 3 == 0) {
+        auto guard = bpm.ReadPage(page_id);
+        continue;
+      }
+      auto guard = bpm.WritePage(page_id);
+      std::snprintf(guard.GetDataMut(), 64, "page %d version %d", page_id, i);
+      if (i % 50 == 0) {
+        guard.Flush();
+      }
+    }
+    bpm.FlushAllPages();
+    for (page_id_t page_id : pages) {
+      bpm.FlushPage(page_id);
+    }
+  }
+  EXPECT_GT(disk.writes_.load(), 100u);
+  EXPECT_EQ(disk.violations_.load(), 0u);
+  // no-force: pages were written on eviction, commits never had to wait for them
+  EXPECT_LT(log.GetNumSyncs(), disk.writes_.load());
+}
@@ -0,0 +1,174 @@
+#include <gtest/gtest.h>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "b_plus_tree.h"
+#include "b_plus_tree_key.h"
+#include "buffer_pool_manager.h"
+#include "page_allocator.h"
+#include "test_disk_manager.h"
+#include "types.h"
+
+using namespace bicycletub;
+
+namespace {
+using Tree = BPlusTree<IntegerKey, RID, IntegerKeyComparator>;
+using InternalPage = BPlusTreeInternalPage<IntegerKey, page_id_t, IntegerKeyComparator>;
+using LeafPage = BPlusTreeLeafPage<IntegerKey, RID, IntegerKeyComparator>;
+
+// leaf page ids in key order, following next_page_id_ from the leftmost leaf
+auto LeafChain(BufferPoolManager &bpm, Tree &tree) -> std::vector<page_id_t> {
+  page_id_t page_id = tree.GetRootPageId();
+  while (!bpm.ReadPage(page_id).As<BPlusTreePage>()->IsLeafPage()) {
+    page_id = bpm.ReadPage(page_id).As<InternalPage>()->ValueAt(0);
+  }
+  std::vector<page_id_t> chain;
+  for (; page_id != INVALID_PAGE_ID; page_id = bpm.ReadPage(page_id).As<LeafPage>()->GetNextPageId()) {
+    chain.push_back(page_id);
+  }
+  return chain;
+}
+
+// share of leaf-to-leaf steps that move to the next page on disk
+auto SequentialShare(const std::vector<page_id_t> &chain) -> double {
+  size_t sequential = 0;
+  for (size_t i = 1; i < chain.size(); i++) {
+    sequential += chain[i] == chain[i - 1] + 1 ? 1 : 0;
+  }
+  return chain.size() < 2 ? 1.0 : static_cast<double>(sequential) / static_cast<double>(chain.size() - 1);
+}
+}  // namespace
+
+TEST(PageAllocatorTest, DefaultGroupIsDense) {
+  PageAllocator allocator;
+  for (page_id_t expected = 0; expected < 200; expected++) {
+    EXPECT_EQ(allocator.Allocate(), expected);
+  }
+  EXPECT_EQ(allocator.GetNumExtents(), 4u);
+  EXPECT_TRUE(allocator.IsAllocated(199));
+  EXPECT_FALSE(allocator.IsAllocated(200));
+  EXPECT_FALSE(allocator.IsAllocated(-1));
+}
+
+TEST(PageAllocatorTest, GroupsFillTheirOwnExtents) {
+  PageAllocator allocator;
+  AllocationGroup a = allocator.NewGroup();
+  AllocationGroup b = allocator.NewGroup();
+  std::vector<page_id_t> pages_a;
+  std::vector<page_id_t> pages_b;
+  for (size_t i = 0; i < 2 * PageAllocator::EXTENT_SIZE; i++) {
+    pages_a.push_back(allocator.Allocate(a));
+    pages_b.push_back(allocator.Allocate(b));
+  }
+  // interleaved requests still come out as runs of whole extents
+  for (size_t i = 1; i < pages_a.size(); i++) {
+    if (i % PageAllocator::EXTENT_SIZE != 0) {
+      EXPECT_EQ(pages_a[i], pages_a[i - 1] + 1);
+      EXPECT_EQ(pages_b[i], pages_b[i - 1] + 1);
+    }
+  }
+  EXPECT_EQ(pages_a[0] % PageAllocator::EXTENT_SIZE, 0);
+  EXPECT_EQ(pages_b[0] % PageAllocator::EXTENT_SIZE, 0);
+  EXPECT_EQ(allocator.GetNumExtents(), 4u);
+  EXPECT_THROW(allocator.Allocate(static_cast<AllocationGroup>(9)), std::invalid_argument);
+}
+
+TEST(PageAllocatorTest, AllocateNearStaysInTheHintsExtent) {
+  PageAllocator allocator;
+  AllocationGroup group = allocator.NewGroup();
+  page_id_t first = allocator.Allocate(group);
+  page_id_t second = allocator.Allocate(group);
+  // the first free slot after the hint
+  EXPECT_EQ(allocator.AllocateNear(first), second + 1);
+  EXPECT_EQ(allocator.AllocateNear(second + 1), second + 2);
+  // the default group's extent is not touched by the group's pages
+  EXPECT_EQ(allocator.Allocate(), static_cast<page_id_t>(PageAllocator::EXTENT_SIZE));
+  // once the extent is full the group moves on to an extent of its own
+  page_id_t last = INVALID_PAGE_ID;
+  for (size_t i = 4; i < PageAllocator::EXTENT_SIZE; i++) {
+    last = allocator.AllocateNear(first);
+  }
+  EXPECT_EQ(last, first + static_cast<page_id_t>(PageAllocator::EXTENT_SIZE) - 1);
+  page_id_t spilled = allocator.AllocateNear(first);
+  EXPECT_EQ(spilled, static_cast<page_id_t>(2 * PageAllocator::EXTENT_SIZE));
+  EXPECT_EQ(allocator.Allocate(group), spilled + 1);
+  // an unknown hint lands in the default group
+  EXPECT_EQ(allocator.AllocateNear(INVALID_PAGE_ID), static_cast<page_id_t>(PageAllocator::EXTENT_SIZE) + 1);
+}
+
+// IsAllocated() reads the masks without the latch while other threads keep adding extents
+// and directory blocks; every page a thread got must read as allocated right away.
+TEST(PageAllocatorTest, IsAllocatedDuringConcurrentAllocation) {
+  PageAllocator allocator;
+  // four threads together fill two directory blocks
+  const int per_thread = static_cast<int>(PageAllocator::BLOCK_EXTENTS * PageAllocator::EXTENT_SIZE / 2);
+  std::vector<std::thread> workers;
+  for (int t = 0; t < 4; t++) {
+    workers.emplace_back([&allocator, per_thread, t]() {
+      AllocationGroup group = t == 0 ? AllocationGroup::DEFAULT : allocator.NewGroup();
+      for (int i = 0; i < per_thread; i++) {
+        page_id_t page_id = allocator.Allocate(group);
+        ASSERT_TRUE(allocator.IsAllocated(page_id)) << page_id;
+      }
+    });
+  }
+  for (auto &worker : workers) {
+    worker.join();
+  }
+  EXPECT_GE(allocator.GetNumExtents(), 2 * PageAllocator::BLOCK_EXTENTS);
+  size_t pages = allocator.GetNumExtents() * PageAllocator::EXTENT_SIZE;
+  EXPECT_FALSE(allocator.IsAllocated(static_cast<page_id_t>(pages)));
+  EXPECT_FALSE(allocator.IsAllocated(INT32_MAX));
+}
+
+TEST(PageAllocatorTest, BufferPoolRejectsUnallocatedSlots) {
+  auto disk = MakeTestDiskManager();
+  BufferPoolManager bpm(8, disk.get());
+  page_id_t page_id = bpm.NewPage();
+  page_id_t grouped = bpm.NewPage(bpm.NewAllocationGroup());
+  EXPECT_NO_THROW(bpm.WritePage(page_id));
+  EXPECT_NO_THROW(bpm.WritePage(grouped));
+  // inside a handed-out extent but never allocated
+  EXPECT_THROW(bpm.ReadPage(page_id + 1), std::runtime_error);
+  EXPECT_THROW(bpm.ReadPage(grouped + 1), std::runtime_error);
+}
+
+// Two trees filled at the same time used to interleave their leaves page by page; with
+// per-tree extents and split pages placed next to their sibling the leaf chains become
+// ascending runs again.
+TEST(PageAllocatorTest, LeafChainsOfInterleavedTreesAreSequential) {
+  auto disk = MakeTestDiskManager();
+  BufferPoolManager bpm(256, disk.get());
+  IntegerKeyComparator comparator;
+  page_id_t header_a = bpm.NewPage();
+  page_id_t header_b = bpm.NewPage();
+  Tree tree_a("a", header_a, &bpm, comparator, 32, 32);
+  Tree tree_b("b", header_b, &bpm, comparator, 32, 32);
+  const int n = 2000;
+  for (int i = 0; i < n; i++) {
+    tree_a.Insert(IntegerKey(i), RID{i, 0});
+    tree_b.Insert(IntegerKey(i), RID{i, 1});
+  }
+  std::vector<int> keys(n);
+  for (int i = 0; i < n; i++) {
+    keys[i] = n + i;
+  }
+  std::shuffle(keys.begin(), keys.end(), std::mt19937(3));
+  Tree tree_c("c", bpm.NewPage(), &bpm, comparator, 32, 32);
+  for (int key : keys) {
+    tree_c.Insert(IntegerKey(key), RID{key, 2});
+    tree_a.Insert(IntegerKey(key), RID{key, 0});
+  }
+
+  double share_a = SequentialShare(LeafChain(bpm, tree_a));
+  double share_b = SequentialShare(LeafChain(bpm, tree_b));
+  double share_c = SequentialShare(LeafChain(bpm, tree_c));
+  std::cout << "[page_allocator] sequential leaf steps: appended=" << share_b << " appended+random=" << share_a
+            << " random=" << share_c << std::endl;
+  EXPECT_GT(share_b, 0.95);
+  EXPECT_GT(share_a, 0.3);
+}
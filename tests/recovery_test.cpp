@@ -0,0 +1,171 @@
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <numeric>
+#include <random>
+#include <vector>
+
+#include "b_plus_tree.h"
+#include "b_plus_tree_key.h"
+#include "buffer_pool_manager.h"
+#include "disk_manager_memory.h"
+#include "log_manager.h"
+#include "recovery_manager.h"
+#include "test_disk_manager.h"
+#include "types.h"
+
+using namespace bicycletub;
+
+namespace {
+using Tree = BPlusTree<IntegerKey, RID, IntegerKeyComparator>;
+
+struct BuildResult {
+  page_id_t header_page_id_;
+  lsn_t first_checkpoint_lsn_{INVALID_LSN};
+  uint64_t num_records_{0};
+};
+
+// Inserts keys into a fresh tree with checkpoints every checkpoint_every inserts (0: none),
+// removes every key divisible by remove_every (0: none), then crashes: the pool is dropped
+// with its dirty pages, only what the pool wrote and the log survive.
+auto BuildAndCrash(DiskManager *disk, const std::string &log_path, const std::vector<int> &keys,
+                   size_t checkpoint_every, int remove_every, size_t pool_size = 32) -> BuildResult {
+  IntegerKeyComparator comparator{};
+  LogManager log(log_path);
+  BufferPoolManager bpm(pool_size, disk, &log);
+  BuildResult result;
+  result.header_page_id_ = bpm.NewPage();
+  Tree tree("recovery", result.header_page_id_, &bpm, comparator, 16, 16);
+  for (size_t i = 0; i < keys.size(); i++) {
+    tree.Insert(IntegerKey(keys[i]), RID(keys[i], 0));
+    if (checkpoint_every != 0 && i % checkpoint_every == checkpoint_every - 1) {
+      lsn_t lsn = bpm.Checkpoint();
+      if (result.first_checkpoint_lsn_ == INVALID_LSN) {
+        result.first_checkpoint_lsn_ = lsn;
+      }
+    }
+  }
+  if (remove_every != 0) {
+    for (int key : keys) {
+      if (key % remove_every == 0) {
+        tree.Remove(IntegerKey(key));
+      }
+    }
+  }
+  result.num_records_ = log.GetNumRecords();
+  return result;
+}
+
+// Opens the recovered tree and checks that exactly the expected keys are in it, in order.
+void ExpectTree(DiskManagerMemory *disk, const std::string &log_path, const RecoveryStats &stats,
+                page_id_t header_page_id, const std::vector<int> &expected) {
+  IntegerKeyComparator comparator{};
+  LogManager log(log_path);
+  BufferPoolManager bpm(32, disk, &log);
+  bpm.AdoptPages(std::max(stats.page_id_end_, disk->GetPageIdLimit()));
+  auto tree = Tree::Open("recovery", header_page_id, &bpm, comparator);
+  for (int key : expected) {
+    std::vector<RID> result;
+    ASSERT_TRUE(tree.GetValue(IntegerKey(key), &result)) << key;
+    EXPECT_EQ(result[0].page_id, key);
+  }
+  std::vector<int> sorted = expected;
+  std::sort(sorted.begin(), sorted.end());
+  size_t i = 0;
+  for (auto it = tree.Begin(); it != tree.End(); ++it, i++) {
+    ASSERT_LT(i, sorted.size());
+    ASSERT_EQ((*it).first.GetValue(), sorted[i]);
+  }
+  EXPECT_EQ(i, sorted.size());
+  // and it keeps working on top of the recovered state
+  tree.Insert(IntegerKey(-1), RID(-1, 0));
+  std::vector<RID> result;
+  EXPECT_TRUE(tree.GetValue(IntegerKey(-1), &result));
+}
+
+auto ShuffledKeys(int count, unsigned seed) -> std::vector<int> {
+  std::vector<int> keys(count);
+  std::iota(keys.begin(), keys.end(), 0);
+  std::shuffle(keys.begin(), keys.end(), std::mt19937(seed));
+  return keys;
+}
+}  // namespace
+
+TEST(RecoveryTest, RecoversTreeAfterCrash) {
+  DiskManagerMemory disk;
+  TempLogPath log_path;
+  auto keys = ShuffledKeys(1500, 7);
+  auto build = BuildAndCrash(&disk, log_path.Path(), keys, 400, 3);
+
+  RecoveryManager recovery(log_path.Path(), &disk);
+  auto stats = recovery.Recover();
+  EXPECT_NE(stats.checkpoint_lsn_, INVALID_LSN);
+  EXPECT_GT(stats.dirty_pages_, 0u);
+  EXPECT_GT(stats.pages_written_, 0u);
+  EXPECT_LE(stats.redo_lsn_, stats.checkpoint_lsn_);
+
+  std::vector<int> expected;
+  std::copy_if(keys.begin(), keys.end(), std::back_inserter(expected), [](int key) { return key % 3 != 0; });
+  ExpectTree(&disk, log_path.Path(), stats, build.header_page_id_, expected);
+}
+
+TEST(RecoveryTest, RecoversWithoutCheckpoint) {
+  DiskManagerMemory disk;
+  TempLogPath log_path;
+  auto keys = ShuffledKeys(1500, 8);
+  auto build = BuildAndCrash(&disk, log_path.Path(), keys, 0, 5);
+
+  RecoveryManager recovery(log_path.Path(), &disk);
+  auto stats = recovery.Recover();
+  EXPECT_EQ(stats.checkpoint_lsn_, INVALID_LSN);
+  EXPECT_EQ(stats.redo_lsn_, 0);
+  EXPECT_EQ(stats.records_redone_, build.num_records_);
+
+  std::vector<int> expected;
+  std::copy_if(keys.begin(), keys.end(), std::back_inserter(expected), [](int key) { return key % 5 != 0; });
+  ExpectTree(&disk, log_path.Path(), stats, build.header_page_id_, expected);
+  // recovering again replays the same log, plus the key inserted after the first recovery
+  expected.push_back(-1);
+  auto again = RecoveryManager(log_path.Path(), &disk).Recover();
+  EXPECT_GE(again.records_redone_, build.num_records_);
+  ExpectTree(&disk, log_path.Path(), again, build.header_page_id_, expected);
+}
+
+// Each checkpoint writes back what stayed dirty since the previous one, so redo only covers
+// the last interval no matter how big the tree or the log got.
+TEST(RecoveryTest, CheckpointsBoundRedo) {
+  DiskManagerMemory disk;
+  TempLogPath log_path;
+  auto keys = ShuffledKeys(1200, 9);
+  auto build = BuildAndCrash(&disk, log_path.Path(), keys, 400, 0);
+
+  RecoveryManager recovery(log_path.Path(), &disk);
+  auto stats = recovery.Recover();
+  EXPECT_GT(stats.redo_lsn_, build.first_checkpoint_lsn_);
+  EXPECT_LT(stats.records_redone_, build.num_records_ / 2);
+  ExpectTree(&disk, log_path.Path(), stats, build.header_page_id_, keys);
+}
+
+// Disabled by default: building the two logs takes tens of seconds at -O0. Run with
+// --gtest_also_run_disabled_tests.
+TEST(RecoveryTest, DISABLED_RecoveryThroughputBenchmark) {
+  const int num_keys = 8000;
+  auto keys = ShuffledKeys(num_keys, 10);
+  for (size_t checkpoint_every : {size_t{0}, size_t{1000}}) {
+    DiskManagerMemory disk;
+    TempLogPath log_path;
+    auto build = BuildAndCrash(&disk, log_path.Path(), keys, checkpoint_every, 0, 64);
+
+    auto start = std::chrono::steady_clock::now();
+    auto stats = RecoveryManager(log_path.Path(), &disk).Recover();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    double redo_mb = static_cast<double>(stats.end_lsn_ - stats.redo_lsn_) / (1 << 20);
+    std::cout << "[recovery] " << (checkpoint_every == 0 ? "no checkpoints" : "checkpoint every 1000 inserts")
+              << ": log " << static_cast<double>(stats.end_lsn_) / (1 << 20) << " MiB, redo " << redo_mb << " MiB ("
+              << stats.records_redone_ << " records, " << stats.pages_written_ << " page writes) in "
+              << seconds * 1000 << " ms = " << redo_mb / seconds << " MiB/s\n";
+    EXPECT_GT(stats.records_redone_, 0u);
+    ExpectTree(&disk, log_path.Path(), stats, build.header_page_id_, keys);
+  }
+}
@@ -0,0 +1,179 @@
+#include <gtest/gtest.h>
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "buffer_pool_manager.h"
+#include "disk_manager_memory.h"
+#include "simulated_disk_manager.h"
+#include "types.h"
+
+using namespace bicycletub;
+using namespace std::chrono_literals;
+
+namespace {
+template <typename Fn>
+auto Elapsed(Fn &&fn) -> std::chrono::microseconds {
+  auto start = std::chrono::steady_clock::now();
+  fn();
+  return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+}
+
+auto Profile(std::chrono::nanoseconds random, std::chrono::nanoseconds sequential, uint64_t bandwidth,
+             size_t queue_depth) -> DiskProfile {
+  return {random, sequential, bandwidth, queue_depth, 0ns};
+}
+}  // namespace
+
+TEST(SimulatedDiskManagerTest, PassesDataThrough) {
+  DiskManagerMemory inner;
+  SimulatedDiskManager disk(&inner, Profile(20us, 5us, 0, 4));
+  std::array<char, PAGE_SIZE> out{}, in{};
+  std::snprintf(out.data(), PAGE_SIZE, "simulated");
+  disk.WritePage(3, out.data());
+  disk.ReadPage(3, in.data());
+  EXPECT_STREQ(in.data(), "simulated");
+  EXPECT_EQ(disk.NumPages(), inner.NumPages());
+}
+
+TEST(SimulatedDiskManagerTest, IOsTakeTheirLatency) {
+  DiskManagerMemory inner;
+  SimulatedDiskManager disk(&inner, Profile(2ms, 2ms, 0, 1));
+  std::array<char, PAGE_SIZE> buf{};
+  auto elapsed = Elapsed([&] {
+    for (page_id_t id = 0; id < 5; id++) {
+      disk.ReadPage(id * 7, buf.data());
+    }
+  });
+  EXPECT_GE(elapsed, 10ms);
+  EXPECT_LT(elapsed, 1s);
+  EXPECT_GE(disk.GetWaitTime(), 9ms);
+}
+
+TEST(SimulatedDiskManagerTest, SequentialIsCheaperThanRandom) {
+  DiskManagerMemory inner;
+  SimulatedDiskManager disk(&inner, Profile(1ms, 50us, 0, 1));
+  std::array<char, PAGE_SIZE> buf{};
+  const int n = 40;
+  // compared on the model's waits: wall-clock time also includes scheduling delays
+  for (page_id_t id = 0; id < n; id++) {
+    disk.ReadPage(id, buf.data());
+  }
+  auto sequential = disk.GetWaitTime();
+  for (page_id_t id = 0; id < n; id++) {
+    disk.ReadPage(id * 2, buf.data());
+  }
+  auto random = disk.GetWaitTime() - sequential;
+  EXPECT_EQ(disk.GetSequentialIOs(), static_cast<uint64_t>(n - 1));
+  EXPECT_EQ(disk.GetRandomIOs(), static_cast<uint64_t>(n + 1));
+  EXPECT_GE(random, 39ms);
+  EXPECT_LT(sequential * 4, random);
+}
+
+TEST(SimulatedDiskManagerTest, QueueDepthOverlapsConcurrentIOs) {
+  const int threads = 4;
+  const int per_thread = 10;
+  auto run = [&](size_t queue_depth) {
+    DiskManagerMemory inner;
+    SimulatedDiskManager disk(&inner, Profile(2ms, 2ms, 0, queue_depth));
+    auto elapsed = Elapsed([&] {
+      std::vector<std::thread> workers;
+      for (int t = 0; t < threads; t++) {
+        workers.emplace_back([&disk, t] {
+          std::array<char, PAGE_SIZE> buf{};
+          for (int i = 0; i < per_thread; i++) {
+            disk.ReadPage(t * 1000 + i * 3, buf.data());
+          }
+        });
+      }
+      for (auto &worker : workers) {
+        worker.join();
+      }
+    });
+    return std::pair{elapsed, disk.GetWaitTime()};
+  };
+  auto [serial, serial_wait] = run(1);
+  auto [parallel, parallel_wait] = run(threads);
+  // one slot serves the 40 reads back to back
+  EXPECT_GE(serial, 80ms);
+  // with four, no read queues behind another
+  EXPECT_LT(parallel_wait * 2, serial_wait);
+}
+
+TEST(SimulatedDiskManagerTest, BandwidthLimitsLargeTransfers) {
+  DiskManagerMemory inner;
+  // 1 page per 100us
+  SimulatedDiskManager disk(&inner, Profile(0ns, 0ns, PAGE_SIZE * 10'000, 8));
+  const size_t count = 100;
+  std::vector<std::array<char, PAGE_SIZE>> pages(count);
+  std::vector<char *> bufs;
+  for (auto &page : pages) {
+    bufs.push_back(page.data());
+  }
+  auto elapsed = Elapsed([&] { disk.ReadPages(0, bufs.data(), count); });
+  EXPECT_GE(elapsed, 10ms);
+}
+
+// The buffer pool over a simulated SSD and HDD: a sequential scan against a random probe of
+// the same number of pages, and write-back of dirty pages page by page against one batched
+// FlushAllPages, which the scheduler coalesces into runs.
+TEST(SimulatedDiskManagerTest, BufferPoolBenchmark) {
+  for (auto [name, profile] : {std::pair{"ssd", DiskProfile::Ssd()}, std::pair{"hdd", DiskProfile::Hdd()}}) {
+    DiskManagerMemory inner;
+    SimulatedDiskManager disk(&inner, profile);
+    const int pages = profile.queue_depth_ > 1 ? 512 : 64;
+    BufferPoolManager bpm(pages, &disk);
+    for (int i = 0; i < pages; i++) {
+      bpm.NewPage();
+    }
+    // the assertions use the model's waits, the printed times are wall clock
+    auto flush_each = Elapsed([&] {
+      for (int i = 0; i < pages; i++) {
+        bpm.WritePage(i).GetDataMut()[0] = 1;
+        bpm.FlushPage(i);
+      }
+    });
+    auto waited = disk.GetWaitTime();
+    auto flush_each_wait = waited;
+    auto flush_all = Elapsed([&] {
+      for (int i = 0; i < pages; i++) {
+        bpm.WritePage(i).GetDataMut()[0] = 2;
+      }
+      bpm.FlushAllPages();
+    });
+    auto flush_all_wait = disk.GetWaitTime() - waited;
+
+    BufferPoolManager cold(8, &disk);
+    for (int i = 0; i < pages; i++) {
+      cold.NewPage();
+    }
+    waited = disk.GetWaitTime();
+    auto scan = Elapsed([&] {
+      for (int i = 0; i < pages; i++) {
+        cold.ReadPage(i);
+      }
+    });
+    auto scan_wait = disk.GetWaitTime() - waited;
+    std::vector<int> order(pages);
+    for (int i = 0; i < pages; i++) {
+      order[i] = i;
+    }
+    std::shuffle(order.begin(), order.end(), std::mt19937(1));
+    waited = disk.GetWaitTime();
+    auto probe = Elapsed([&] {
+      for (int i : order) {
+        cold.ReadPage(i);
+      }
+    });
+    auto probe_wait = disk.GetWaitTime() - waited;
+    std::cout << "[simulated_disk] " << name << " pages=" << pages << " flush_each=" << flush_each.count()
+              << "us flush_all=" << flush_all.count() << "us scan=" << scan.count() << "us probe=" << probe.count()
+              << "us" << std::endl;
+    EXPECT_LT(scan_wait, probe_wait);
+    EXPECT_LT(flush_all_wait, flush_each_wait);
+  }
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <atomic>
+#include <cstdlib>
+#include <filesystem>
+#include <memory>
+#include <random>
+#include <string>
+
+#include "disk_manager.h"
+#include "disk_manager_memory.h"
+#ifndef _WIN32
+#include <unistd.h>
+#include "disk_manager_file.h"
+#include "disk_manager_mmap.h"
+#endif
+
+namespace bicycletub {
+
+#ifndef _WIN32
+// Unique scratch path in the temp directory, e.g. for file backed disk managers.
+inline auto TempDataFilePath(const std::string &tag) -> std::string {
+  static std::atomic<int> counter{0};
+  auto name = "bicycletub_" + tag + "_" + std::to_string(::getpid()) + "_" + std::to_string(counter.fetch_add(1)) + ".db";
+  return (std::filesystem::temp_directory_path() / name).string();
+}
+
+// DiskManagerFile on a scratch file that is removed again on destruction.
+class TempFileDiskManager : public DiskManagerFile {
+ public:
+  explicit TempFileDiskManager(bool direct_io = false) : DiskManagerFile(TempDataFilePath("test"), direct_io) {}
+  ~TempFileDiskManager() override {
+    std::error_code ec;
+    std::filesystem::remove(GetPath(), ec);
+  }
+};
+
+// DiskManagerMmap on a scratch file that is removed again on destruction.
+class TempMmapDiskManager : public DiskManagerMmap {
+ public:
+  explicit TempMmapDiskManager(bool zero_copy = false) : DiskManagerMmap(TempDataFilePath("test"), zero_copy) {}
+  ~TempMmapDiskManager() override {
+    std::error_code ec;
+    std::filesystem::remove(GetPath(), ec);
+  }
+};
+#endif
+
+// Scratch write-ahead log path in the temp directory; the log and its master record are
+// removed again on destruction.
+class TempLogPath {
+ public:
+  TempLogPath() {
+    static std::atomic<int> counter{0};
+    auto name = "bicycletub_log_" + std::to_string(std::random_device{}()) + "_" +
+                std::to_string(counter.fetch_add(1)) + ".wal";
+    path_ = (std::filesystem::temp_directory_path() / name).string();
+  }
+  TempLogPath(const TempLogPath &) = delete;
+  auto operator=(const TempLogPath &) -> TempLogPath & = delete;
+  ~TempLogPath() {
+    std::error_code ec;
+    std::filesystem::remove(path_, ec);
+    std::filesystem::remove(path_ + ".master", ec);
+  }
+  auto Path() const -> const std::string & { return path_; }
+
+ private:
+  std::string path_;
+};
+
+// Whether BICY_DISK_BACKEND selects a non-default backend, i.e. this is one of the ctest
+// reruns of a suite. Tests that assert on timings skip themselves there: the reruns run
+// next to the default suites and their timings are not comparable.
+inline auto IsBackendVariant() -> bool { return std::getenv("BICY_DISK_BACKEND") != nullptr; }
+
+// Storage backend for fixtures: BICY_DISK_BACKEND=file (or file_direct for O_DIRECT)
+// runs a suite against a scratch DiskManagerFile, mmap (or mmap_zero_copy) against a
+// scratch DiskManagerMmap, anything else uses DiskManagerMemory.
+inline auto MakeTestDiskManager() -> std::unique_ptr<DiskManager> {
+#ifndef _WIN32
+  if (const char *backend = std::getenv("BICY_DISK_BACKEND")) {
+    std::string name(backend);
+    if (name == "file" || name == "file_direct") {
+      return std::make_unique<TempFileDiskManager>(name == "file_direct");
+    }
+    if (name == "mmap" || name == "mmap_zero_copy") {
+      return std::make_unique<TempMmapDiskManager>(name == "mmap_zero_copy");
+    }
+  }
+#endif
+  return std::make_unique<DiskManagerMemory>();
+}
+
+}  // namespace bicycletub